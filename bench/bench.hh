@@ -0,0 +1,83 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace ni
+{
+namespace bench
+{
+
+/// \return 1, 2, 4, ... up to the number of hardware threads
+inline std::vector<size_t> thread_counts()
+{
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> counts;
+  for (size_t n = 1; n < max_threads; n *= 2)
+    counts.push_back(n);
+  counts.push_back(max_threads);
+  return counts;
+}
+
+/// \brief Runs `fn(thread_index)` on `threads` threads released at the same
+///        time
+/// \return wall-clock time in seconds
+template <typename Fn>
+double run_threads(size_t threads, Fn&& fn)
+{
+  std::atomic<size_t> ready(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+
+  for (size_t i = 0; i < threads; ++i)
+  {
+    workers.emplace_back([&, i]
+                         {
+                           ready.fetch_add(1, std::memory_order_relaxed);
+                           while (!go.load(std::memory_order_acquire))
+                             ;
+                           fn(i);
+                         });
+  }
+
+  while (ready.load(std::memory_order_relaxed) != threads)
+    ;
+
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& t : workers)
+    t.join();
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double>(end - start).count();
+}
+
+inline void report(const char* name, size_t threads, size_t ops,
+                   double seconds)
+{
+  printf("%-48s threads=%-3zu %14.0f ops/s\n", name, threads, ops / seconds);
+}
+
+} // namespace bench
+} // namespace ni
@@ -0,0 +1,92 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bench.hh>
+
+#include <ni/cds/concurrent_hash_map.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t OPS_PER_THREAD = 1 << 20;
+constexpr size_t KEYS = 1 << 16;
+
+std::vector<std::string> make_keys()
+{
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < KEYS; ++i)
+    keys.push_back("key:" + std::to_string(i * 2654435761u));
+  return keys;
+}
+
+// Mixes finds with `percent_writes` percent of insert_or_assign and erase,
+// the map starts half full
+template <typename Map, typename MakeKey>
+void mixed(const char* name, unsigned percent_writes, MakeKey make_key)
+{
+  for (size_t threads : bench::thread_counts())
+  {
+    Map map;
+    for (size_t i = 0; i < KEYS; i += 2)
+      map.insert(make_key(i), i);
+
+    auto worker = [&](size_t index)
+    {
+      std::minstd_rand rng(index + 1);
+      size_t value;
+      for (size_t i = 0; i < OPS_PER_THREAD; ++i)
+      {
+        size_t r = rng();
+        const auto& key = make_key(r % KEYS);
+        if (r / KEYS % 100 >= percent_writes)
+          map.find(key, &value);
+        else if (r / KEYS % 2)
+          map.insert_or_assign(key, i);
+        else
+          map.erase(key);
+      }
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, threads * OPS_PER_THREAD, seconds);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  auto int_key = [](size_t i) { return i; };
+  mixed<ConcurrentHashMap<size_t, size_t>>("ConcurrentHashMap<size_t> 90% find",
+                                           10, int_key);
+  mixed<ConcurrentHashMap<size_t, size_t>>("ConcurrentHashMap<size_t> 10% find",
+                                           90, int_key);
+
+  const std::vector<std::string> keys = make_keys();
+  auto string_key = [&](size_t i) -> const std::string& { return keys[i]; };
+  mixed<ConcurrentHashMap<std::string, size_t>>(
+    "ConcurrentHashMap<string> 90% find", 10, string_key);
+  mixed<ConcurrentHashMap<std::string, size_t>>(
+    "ConcurrentHashMap<string> 10% find", 90, string_key);
+  return 0;
+}
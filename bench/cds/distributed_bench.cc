@@ -0,0 +1,88 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <bench.hh>
+
+#include <ni/cds/distributed/dynamic.hh>
+#include <ni/cds/distributed/static.hh>
+#include <ni/cds/ms_queue.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t PAIRS_PER_THREAD = 1 << 19;
+
+// Every thread puts and gets in turn, with one partial queue per thread
+template <typename Balancer>
+void static_distributed(const char* name)
+{
+  using Queue = DistributedInterface<MSQueue<size_t, NodePool>, Balancer>;
+
+  for (size_t threads : bench::thread_counts())
+  {
+    Queue queue(threads);
+    auto worker = [&](size_t)
+    {
+      size_t element;
+      for (size_t i = 0; i < PAIRS_PER_THREAD; ++i)
+      {
+        queue.put(i);
+        queue.get(&element);
+      }
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, 2 * threads * PAIRS_PER_THREAD, seconds);
+  }
+}
+
+void ll_dynamic_distributed(const char* name)
+{
+  using Queue = LLDynamicDistributed<MSQueue<size_t, NodePool>>;
+
+  for (size_t threads : bench::thread_counts())
+  {
+    Queue queue(threads);
+    auto worker = [&](size_t)
+    {
+      Queue::BackendPtr local_backend;
+      size_t element;
+      for (size_t i = 0; i < PAIRS_PER_THREAD; ++i)
+      {
+        queue.put(local_backend, i);
+        queue.get(local_backend, &element);
+      }
+      queue.deregister_thread(local_backend);
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, 2 * threads * PAIRS_PER_THREAD, seconds);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  static_distributed<RoundRobinBalancer>("DistributedInterface RoundRobin");
+  static_distributed<AffinityBalancer>("DistributedInterface Affinity");
+  static_distributed<RandomBalancer>("DistributedInterface Random");
+  static_distributed<DRandomBalancer<>>("DistributedInterface DRandom<2>");
+  ll_dynamic_distributed("LLDynamicDistributed<MSQueue>");
+  return 0;
+}
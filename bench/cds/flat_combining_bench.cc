@@ -0,0 +1,91 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <mutex>
+#include <queue>
+
+#include <bench.hh>
+
+#include <ni/cds/flat_combining.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t OPS_PER_THREAD = 1 << 18;
+
+using Heap = std::priority_queue<int>;
+
+void flat_combining(const char* name)
+{
+  for (size_t threads : bench::thread_counts())
+  {
+    FlatCombining<Heap> heap(threads);
+    auto worker = [&](size_t index)
+    {
+      FlatCombining<Heap>::RecordPtr record;
+      for (size_t i = 0; i < OPS_PER_THREAD; ++i)
+      {
+        int value = static_cast<int>(i * 7919 + index);
+        heap.apply(record, [value](Heap& q) { q.push(value); });
+        heap.apply(record, [](Heap& q) { q.pop(); });
+      }
+      heap.deregister_thread(record);
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, threads * OPS_PER_THREAD * 2, seconds);
+  }
+}
+
+template <typename Lock>
+void locked(const char* name)
+{
+  for (size_t threads : bench::thread_counts())
+  {
+    Heap heap;
+    Lock lock{};
+    auto worker = [&](size_t index)
+    {
+      for (size_t i = 0; i < OPS_PER_THREAD; ++i)
+      {
+        int value = static_cast<int>(i * 7919 + index);
+        {
+          std::lock_guard<Lock> guard(lock);
+          heap.push(value);
+        }
+        {
+          std::lock_guard<Lock> guard(lock);
+          heap.pop();
+        }
+      }
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, threads * OPS_PER_THREAD * 2, seconds);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  flat_combining("FlatCombining<priority_queue<int>>");
+  locked<SpinLock>("SpinLock + priority_queue<int>");
+  locked<std::mutex>("std::mutex + priority_queue<int>");
+  return 0;
+}
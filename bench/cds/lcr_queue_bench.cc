@@ -0,0 +1,58 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <bench.hh>
+
+#include <ni/cds/lcr_queue.hh>
+#include <ni/cds/ms_queue.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t OPS_PER_THREAD = 1 << 20;
+
+template <typename Queue>
+void pairs(const char* name)
+{
+  for (size_t threads : bench::thread_counts())
+  {
+    Queue queue;
+    auto worker = [&](size_t)
+    {
+      int value;
+      for (size_t i = 0; i < OPS_PER_THREAD; ++i)
+      {
+        queue.push(static_cast<int>(i));
+        queue.pop(&value);
+      }
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, threads * OPS_PER_THREAD * 2, seconds);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  pairs<MSQueue<int, NodePool>>("MSQueue<int, NodePool> push/pop");
+  pairs<LCRQueue<int>>("LCRQueue<int> push/pop");
+  return 0;
+}
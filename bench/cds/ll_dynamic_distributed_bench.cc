@@ -0,0 +1,152 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <cstdio>
+
+#include <bench.hh>
+
+#include <ni/cds/distributed/dynamic.hh>
+#include <ni/cds/ms_queue.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t TASKS_PER_THREAD = 1 << 19;
+constexpr size_t BATCH_SIZE = 32;
+
+// Counts the operations of the thieves on the backends, each of them pulls
+// cache lines of another thread's queue. The owner's own gets go through
+// `get` and are not counted.
+class CountingQueue : public MSQueue<size_t, NodePool>
+{
+public:
+  using Base = MSQueue<size_t, NodePool>;
+
+  static thread_local size_t t_remote_ops;
+
+  bool pop(Element* element, State* head_state)
+  {
+    ++t_remote_ops;
+    return Base::pop(element, head_state);
+  }
+
+  size_t get_bulk(Element* elements, size_t max)
+  {
+    ++t_remote_ops;
+    return Base::get_bulk(elements, max);
+  }
+};
+
+thread_local size_t CountingQueue::t_remote_ops = 0;
+
+// Threads with an even index produce twice their share of tasks and execute
+// every other one, threads with an odd index only steal
+template <typename VictimPolicy>
+void imbalanced(const char* name, size_t steal_batch = 1)
+{
+  using Pool = LLDynamicDistributed<CountingQueue, VictimPolicy>;
+
+  for (size_t threads : bench::thread_counts())
+  {
+    const size_t producers = (threads + 1) / 2;
+    const size_t per_producer = threads * TASKS_PER_THREAD / producers;
+    const size_t total = producers * per_producer;
+    Pool pool(threads);
+    pool.set_steal_batch(steal_batch);
+    std::atomic<size_t> done(0);
+    std::atomic<size_t> remote_ops(0);
+
+    auto worker = [&](size_t index)
+    {
+      typename Pool::BackendPtr local_backend;
+      size_t task;
+      size_t executed = 0;
+      CountingQueue::t_remote_ops = 0;
+
+      if (index % 2 == 0)
+      {
+        for (size_t i = 0; i < per_producer; ++i)
+        {
+          pool.put(local_backend, i);
+          if (i % 2 && pool.get(local_backend, &task))
+            ++executed;
+        }
+      }
+
+      while (done.load(std::memory_order_relaxed) + executed < total)
+      {
+        bool found = pool.get(local_backend, &task);
+        if (found)
+          ++executed;
+        if (executed >= BATCH_SIZE || !found)
+        {
+          done.fetch_add(executed, std::memory_order_relaxed);
+          executed = 0;
+        }
+      }
+      done.fetch_add(executed, std::memory_order_relaxed);
+      pool.deregister_thread(local_backend);
+      remote_ops.fetch_add(CountingQueue::t_remote_ops);
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, total, seconds);
+    printf("%-48s threads=%-3zu %14.3f remote ops/task\n", name, threads,
+           static_cast<double>(remote_ops.load()) / total);
+  }
+}
+
+// Every thread has registered a backend and polls the empty structure, the
+// common case of idle consumers
+void empty_poll(const char* name)
+{
+  using Pool = LLDynamicDistributed<MSQueue<size_t, NodePool>>;
+
+  for (size_t threads : bench::thread_counts())
+  {
+    Pool pool(threads);
+
+    auto worker = [&](size_t index)
+    {
+      Pool::BackendPtr local_backend;
+      size_t task;
+      pool.put(local_backend, index);
+      pool.get(local_backend, &task);
+      for (size_t i = 0; i < TASKS_PER_THREAD; ++i)
+        pool.get(local_backend, &task);
+      pool.deregister_thread(local_backend);
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, threads * TASKS_PER_THREAD, seconds);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  imbalanced<RandomVictim>("LLDynamicDistributed RandomVictim");
+  imbalanced<TwoChoicesVictim>("LLDynamicDistributed TwoChoicesVictim");
+  imbalanced<NearestVictim>("LLDynamicDistributed NearestVictim");
+  imbalanced<RandomVictim>("LLDynamicDistributed steal batch 8", 8);
+  imbalanced<RandomVictim>("LLDynamicDistributed steal batch 32", 32);
+  empty_poll("LLDynamicDistributed empty get");
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <cstdio>
+#include <thread>
+
+#include <bench.hh>
+
+#include <ni/cds/spsc_queue.hh>
+#include <ni/cds/spsc_ring_buffer.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t MESSAGES = 1 << 22;
+constexpr size_t CAPACITY = 1024;
+
+template <size_t SIZE>
+struct Message
+{
+  size_t sequence;
+  char payload[SIZE - sizeof(size_t)];
+};
+
+// Messages are stored inline
+template <size_t SIZE>
+void inline_messages()
+{
+  SPSCQueue<Message<SIZE>> queue(CAPACITY);
+
+  auto worker = [&](size_t index)
+  {
+    if (index == 0)
+    {
+      for (size_t i = 0; i < MESSAGES; ++i)
+      {
+        while (!queue.emplace())
+          std::this_thread::yield();
+      }
+    }
+    else
+    {
+      for (size_t i = 0; i < MESSAGES; ++i)
+      {
+        while (!queue.front())
+          std::this_thread::yield();
+        queue.pop();
+      }
+    }
+  };
+  double seconds = bench::run_threads(2, worker);
+
+  char name[64];
+  snprintf(name, sizeof(name), "SPSCQueue<Message<%zu>>", SIZE);
+  bench::report(name, 2, MESSAGES, seconds);
+}
+
+// Messages are allocated by the producer and passed by pointer
+template <size_t SIZE>
+void allocated_messages()
+{
+  SPSCRingBuffer<Message<SIZE>*, nullptr> ringbuf(CAPACITY);
+
+  auto worker = [&](size_t index)
+  {
+    if (index == 0)
+    {
+      for (size_t i = 0; i < MESSAGES; ++i)
+      {
+        Message<SIZE>* message = new Message<SIZE>();
+        while (!ringbuf.push(message))
+          std::this_thread::yield();
+      }
+    }
+    else
+    {
+      for (size_t i = 0; i < MESSAGES; ++i)
+      {
+        Message<SIZE>* message;
+        while ((message = ringbuf.pop()) == nullptr)
+          std::this_thread::yield();
+        delete message;
+      }
+    }
+  };
+  double seconds = bench::run_threads(2, worker);
+
+  char name[64];
+  snprintf(name, sizeof(name), "SPSCRingBuffer<Message<%zu>*>", SIZE);
+  bench::report(name, 2, MESSAGES, seconds);
+}
+
+} // namespace
+
+int main()
+{
+  inline_messages<64>();
+  allocated_messages<64>();
+  inline_messages<256>();
+  allocated_messages<256>();
+  return 0;
+}
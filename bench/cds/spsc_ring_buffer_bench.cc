@@ -0,0 +1,87 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#include <bench.hh>
+
+#include <ni/cds/spsc_ring_buffer.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t MESSAGES = 1 << 24;
+constexpr size_t CAPACITY = 1024;
+constexpr size_t MAX_BATCH_SIZE = 256;
+
+// One producer and one consumer exchanging messages `batch` at a time
+void transfer(size_t batch)
+{
+  SPSCRingBuffer<size_t, 0> ringbuf(CAPACITY);
+
+  auto worker = [&](size_t index)
+  {
+    size_t messages[MAX_BATCH_SIZE];
+    if (index == 0)
+    {
+      for (size_t i = 0; i < MESSAGES;)
+      {
+        size_t n = std::min(batch, MESSAGES - i);
+        for (size_t k = 0; k < n; ++k)
+          messages[k] = i + k + 1;
+        size_t pushed = batch == 1 ? ringbuf.push(messages[0])
+                                   : ringbuf.push_n(messages, n);
+        if (!pushed)
+          std::this_thread::yield();
+        i += pushed;
+      }
+    }
+    else
+    {
+      for (size_t i = 0; i < MESSAGES;)
+      {
+        size_t popped = 0;
+        if (batch == 1)
+          popped = (messages[0] = ringbuf.pop()) != 0;
+        else
+          popped = ringbuf.pop_n(messages, batch);
+        if (!popped)
+          std::this_thread::yield();
+        i += popped;
+      }
+    }
+  };
+  double seconds = bench::run_threads(2, worker);
+
+  char name[64];
+  snprintf(name, sizeof(name), "SPSCRingBuffer<size_t> batch=%zu", batch);
+  bench::report(name, 2, MESSAGES, seconds);
+}
+
+} // namespace
+
+int main()
+{
+  for (size_t batch = 1; batch <= MAX_BATCH_SIZE; batch *= 2)
+    transfer(batch);
+  return 0;
+}
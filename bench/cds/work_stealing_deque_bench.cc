@@ -0,0 +1,141 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <memory>
+#include <random>
+
+#include <bench.hh>
+
+#include <ni/cds/distributed/dynamic.hh>
+#include <ni/cds/ms_queue.hh>
+#include <ni/cds/work_stealing_deque.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t TASKS_PER_THREAD = 1 << 20;
+constexpr size_t BATCH_SIZE = 32;
+
+// Work pool where every task is produced by the first thread: it executes
+// every other task itself and the other threads have to steal the rest
+void work_stealing_deque(const char* name)
+{
+  for (size_t threads : bench::thread_counts())
+  {
+    const size_t total = threads * TASKS_PER_THREAD;
+    std::vector<std::unique_ptr<WorkStealingDeque<size_t>>> deques;
+    for (size_t i = 0; i < threads; ++i)
+      deques.emplace_back(new WorkStealingDeque<size_t>());
+    std::atomic<size_t> done(0);
+
+    auto worker = [&](size_t index)
+    {
+      WorkStealingDeque<size_t>& own = *deques[index];
+      std::minstd_rand rng(index);
+      size_t tasks[BATCH_SIZE];
+      size_t executed = 0;
+
+      if (index == 0)
+      {
+        for (size_t i = 0; i < total; ++i)
+        {
+          own.push(i);
+          if (i % 2 && own.pop(tasks))
+            ++executed;
+        }
+      }
+
+      while (done.load(std::memory_order_relaxed) + executed < total)
+      {
+        if (own.pop(tasks))
+        {
+          ++executed;
+          continue;
+        }
+        size_t stolen = deques[rng() % threads]->steal_half(tasks, BATCH_SIZE);
+        executed += stolen;
+        // Publish the local count when idle, otherwise threads holding the
+        // last few counts would wait for each other forever
+        if (executed >= BATCH_SIZE || !stolen)
+        {
+          done.fetch_add(executed, std::memory_order_relaxed);
+          executed = 0;
+        }
+      }
+      done.fetch_add(executed, std::memory_order_relaxed);
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, total, seconds);
+  }
+}
+
+void ll_dynamic_distributed(const char* name)
+{
+  using Pool = LLDynamicDistributed<MSQueue<size_t, NodePool>>;
+
+  for (size_t threads : bench::thread_counts())
+  {
+    const size_t total = threads * TASKS_PER_THREAD;
+    Pool pool(threads);
+    std::atomic<size_t> done(0);
+
+    auto worker = [&](size_t index)
+    {
+      Pool::BackendPtr local_backend;
+      size_t task;
+      size_t executed = 0;
+
+      if (index == 0)
+      {
+        for (size_t i = 0; i < total; ++i)
+        {
+          pool.put(local_backend, i);
+          if (i % 2 && pool.get(local_backend, &task))
+            ++executed;
+        }
+      }
+
+      while (done.load(std::memory_order_relaxed) + executed < total)
+      {
+        bool found = pool.get(local_backend, &task);
+        if (found)
+          ++executed;
+        if (executed >= BATCH_SIZE || !found)
+        {
+          done.fetch_add(executed, std::memory_order_relaxed);
+          executed = 0;
+        }
+      }
+      done.fetch_add(executed, std::memory_order_relaxed);
+      pool.deregister_thread(local_backend);
+    };
+    double seconds = bench::run_threads(threads, worker);
+    bench::report(name, threads, total, seconds);
+  }
+}
+
+} // namespace
+
+int main()
+{
+  work_stealing_deque("WorkStealingDeque steal_half");
+  ll_dynamic_distributed("LLDynamicDistributed<MSQueue>");
+  return 0;
+}
@@ -0,0 +1,81 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <string>
+
+#include <bench.hh>
+
+#include <ni/cache_locality.hh>
+#include <ni/mpl/unit.hh>
+#include <ni/tagged_ptr.hh>
+#include <ni/wide_tagged_ptr.hh>
+
+using namespace ni;
+
+namespace
+{
+constexpr size_t OPS_PER_THREAD = 1 << 22;
+
+/// Every thread increments the tag of a shared pointer with a CAS loop, once
+/// with its own pointer (uncontended) and once with a shared one
+template <typename PtrTraits>
+void cas(const char* name)
+{
+  using Ptr = typename PtrTraits::template Ptr<Unit>;
+  using AtomicPtr = typename PtrTraits::template AtomicPtr<Unit>;
+
+  struct NI_CACHELINE_ALIGNED Slot
+  {
+    AtomicPtr ptr;
+  };
+
+  for (bool shared : {false, true})
+  {
+    for (size_t threads : bench::thread_counts())
+    {
+      std::vector<Slot> slots(threads);
+      auto worker = [&](size_t index)
+      {
+        AtomicPtr& ptr = slots[shared ? 0 : index].ptr;
+        Ptr expected = ptr.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < OPS_PER_THREAD; ++i)
+        {
+          while (!ptr.compare_exchange_weak(
+            expected, Ptr(expected.value(), expected.tag() + 1),
+            std::memory_order_acq_rel, std::memory_order_relaxed))
+            ;
+        }
+      };
+      double seconds = bench::run_threads(threads, worker);
+      std::string label =
+        std::string(name) + (shared ? " CAS (shared)" : " CAS (private)");
+      bench::report(label.c_str(), threads, threads * OPS_PER_THREAD,
+                    seconds);
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  cas<TaggedPtrTraits>("TaggedPtr");
+  cas<WideTaggedPtrTraits>("WideTaggedPtr");
+  return 0;
+}
@@ -0,0 +1,143 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <cstddef>
+#include <utility>
+
+#include <ni/sync/event_count.hh>
+#include <ni/sync/sleep.hh>
+
+namespace ni
+{
+/// \brief Adds a blocking `get` to a queue implementing the `Queue` interface
+///
+/// A consumer which finds the queue empty spins for a while and then sleeps
+/// on an `EventCount` until a producer puts a new element. Producers only
+/// issue a wake-up system call when a consumer is actually sleeping, so the
+/// cost of `put` is unchanged when consumers keep up.
+///
+/// \param Q type of the underlying queue
+template <typename Q>
+class BlockingQueue
+{
+public:
+  using Element = typename Q::Element;
+
+  /// Number of failed attempts before a consumer goes to sleep
+  static constexpr uint32_t SPIN_COUNT = 128;
+
+  /// \brief Create a new blocking queue
+  /// \param args arguments forwarded to the constructor of the underlying
+  ///        queue
+  template <typename... Args>
+  explicit BlockingQueue(Args&&... args);
+
+  /// \return the underlying queue
+  Q& queue() noexcept;
+
+  /// \brief Put an element and wake up a sleeping consumer if any
+  template <typename U>
+  bool put(U&& element);
+
+  /// \brief Put a range of elements and wake up the sleeping consumers if any
+  /// \return number of elements put
+  template <typename InputIt>
+  size_t put_bulk(InputIt first, InputIt last);
+
+  /// \brief Get an element, waiting until one is available
+  void get(Element* element);
+
+  /// \brief Get an element if the queue is not empty
+  /// \return false if the queue is empty
+  bool try_get(Element* element);
+
+private:
+  Q m_queue;
+  EventCount m_not_empty;
+};
+
+template <typename Q>
+template <typename... Args>
+BlockingQueue<Q>::BlockingQueue(Args&&... args)
+  : m_queue(std::forward<Args>(args)...)
+  , m_not_empty()
+{
+}
+
+template <typename Q>
+Q& BlockingQueue<Q>::queue() noexcept
+{
+  return m_queue;
+}
+
+template <typename Q>
+template <typename U>
+bool BlockingQueue<Q>::put(U&& element)
+{
+  if (!m_queue.put(std::forward<U>(element)))
+    return false;
+  m_not_empty.notify();
+  return true;
+}
+
+template <typename Q>
+template <typename InputIt>
+size_t BlockingQueue<Q>::put_bulk(InputIt first, InputIt last)
+{
+  size_t count = m_queue.put_bulk(first, last);
+  if (count == 1)
+    m_not_empty.notify();
+  else if (count > 1)
+    m_not_empty.notify_all();
+  return count;
+}
+
+template <typename Q>
+void BlockingQueue<Q>::get(Element* element)
+{
+  Pause pause(SPIN_COUNT);
+  for (uint32_t i = 0; i < SPIN_COUNT; ++i)
+  {
+    if (m_queue.get(element))
+      return;
+    pause();
+  }
+
+  while (true)
+  {
+    EventCount::Key key = m_not_empty.prepare_wait();
+    if (m_queue.get(element))
+    {
+      m_not_empty.cancel_wait();
+      return;
+    }
+    m_not_empty.commit_wait(key);
+    if (m_queue.get(element))
+      return;
+  }
+}
+
+template <typename Q>
+bool BlockingQueue<Q>::try_get(Element* element)
+{
+  return m_queue.get(element);
+}
+
+} // namespace ni
@@ -0,0 +1,252 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <ni/cache_locality.hh>
+#include <ni/cds/queue.hh>
+
+namespace ni
+{
+/// \brief Bounded MPMC queue based on an array of sequenced cells
+///
+/// Every cell stores an element inline next to a sequence number which tells
+/// the round of the cell: a producer may fill cell `pos % size` once its
+/// sequence equals `pos`, a consumer may empty it once it equals `pos + 1`.
+/// A producer (resp. consumer) claims a position with a CAS on the enqueue
+/// (resp. dequeue) position and then publishes the cell by updating its
+/// sequence, so producers and consumers only contend among themselves.
+///
+/// All the memory is allocated by the constructor. Pushing into a full queue
+/// fails instead of allocating.
+///
+/// **Reference**
+///
+/// * D. Vyukov. Bounded MPMC queue.
+///   http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+///
+/// \param T type of the elements, nothrow move constructible
+template <typename T>
+class BoundedMPMCQueue : public Queue<BoundedMPMCQueue<T>, T>
+{
+public:
+  static_assert(std::is_nothrow_move_constructible<T>::value,
+                "Elements of BoundedMPMCQueue must be nothrow move "
+                "constructible");
+
+  using Element = T;
+
+  /// \brief Create a new queue
+  /// \param size the capacity of the queue, must be power of two (and greater
+  ///        than 1)
+  explicit BoundedMPMCQueue(size_t size);
+  BoundedMPMCQueue(const BoundedMPMCQueue&) = delete;
+  BoundedMPMCQueue& operator=(const BoundedMPMCQueue&) = delete;
+  ~BoundedMPMCQueue();
+
+  /// \return capacity of the queue
+  size_t size() const noexcept;
+
+  /// \return true if the queue is empty
+  bool empty() const noexcept;
+
+  /// \return an estimation of the number of elements, positions claimed by
+  ///         pending pushes are included
+  size_t size_approx() const noexcept;
+
+  /// \brief Push new element into the queue
+  ///
+  /// The element is constructed before a position is claimed, if its
+  /// constructor throws the queue is left unchanged.
+  ///
+  /// \param element Element to push
+  ///
+  /// \return false if the queue is full
+  template <typename U>
+  bool push(U&& element);
+
+  /// \brief Pop an element from the queue
+  ///
+  /// \param [out] element Location to store the popped element (if the queue
+  ///                      is not empty)
+  ///
+  /// \return false if the queue is empty
+  bool pop(Element* element);
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(Element), alignof(Element)>::type
+      storage;
+
+    Element* element() noexcept;
+  };
+
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_enqueue_pos;
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_dequeue_pos;
+  NI_CACHELINE_ALIGNED const size_t m_size;
+  const size_t m_mask;
+  Cell* m_cells;
+
+  NI_PADDING_AFTER(sizeof(m_size) + sizeof(m_mask) + sizeof(m_cells));
+};
+
+template <typename T>
+T* BoundedMPMCQueue<T>::Cell::element() noexcept
+{
+  return reinterpret_cast<Element*>(&storage);
+}
+
+template <typename T>
+BoundedMPMCQueue<T>::BoundedMPMCQueue(size_t size)
+  : m_enqueue_pos()
+  , m_dequeue_pos()
+  , m_size(size)
+  , m_mask(size - 1)
+  , m_cells()
+{
+  assert((size > 1) && (size & (size - 1)) == 0 &&
+         "size must be a power of two");
+
+  int rc = posix_memalign(reinterpret_cast<void**>(&m_cells),
+                          NI_CACHELINE_SIZE<size_t>, sizeof(Cell) * size);
+  if (rc)
+    throw std::system_error(rc, std::system_category(), __func__);
+
+  for (size_t i = 0; i < size; ++i)
+    new (&m_cells[i].sequence) std::atomic<size_t>(i);
+}
+
+template <typename T>
+BoundedMPMCQueue<T>::~BoundedMPMCQueue()
+{
+  size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+  size_t end = m_enqueue_pos.load(std::memory_order_relaxed);
+  for (; pos != end; ++pos)
+    m_cells[pos & m_mask].element()->~Element();
+  free(m_cells);
+}
+
+template <typename T>
+size_t BoundedMPMCQueue<T>::size() const noexcept
+{
+  return m_size;
+}
+
+template <typename T>
+bool BoundedMPMCQueue<T>::empty() const noexcept
+{
+  size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+  size_t seq = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+  return static_cast<intptr_t>(seq - (pos + 1)) < 0;
+}
+
+template <typename T>
+size_t BoundedMPMCQueue<T>::size_approx() const noexcept
+{
+  size_t dequeue_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+  size_t enqueue_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+  // The positions are not loaded atomically, the difference may be out of
+  // bounds while they move
+  intptr_t size = static_cast<intptr_t>(enqueue_pos - dequeue_pos);
+  if (size <= 0)
+    return 0;
+  return std::min(static_cast<size_t>(size), m_size);
+}
+
+template <typename T>
+template <typename U>
+bool BoundedMPMCQueue<T>::push(U&& element)
+{
+  // A claimed position has to be published, nothing may throw past the CAS
+  Element value(std::forward<U>(element));
+
+  Cell* cell;
+  size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+  while (true)
+  {
+    cell = &m_cells[pos & m_mask];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff = static_cast<intptr_t>(seq - pos);
+    if (diff == 0)
+    {
+      if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      // The cell has not been emptied since the previous round
+      return false;
+    }
+    else
+    {
+      pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  new (cell->element()) Element(std::move(value));
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+bool BoundedMPMCQueue<T>::pop(Element* element)
+{
+  Cell* cell;
+  size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+  while (true)
+  {
+    cell = &m_cells[pos & m_mask];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff = static_cast<intptr_t>(seq - (pos + 1));
+    if (diff == 0)
+    {
+      if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      // The cell has not been filled in this round
+      return false;
+    }
+    else
+    {
+      pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  *element = std::move(*cell->element());
+  cell->element()->~Element();
+  cell->sequence.store(pos + m_size, std::memory_order_release);
+  return true;
+}
+
+} // namespace ni
@@ -0,0 +1,751 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include <ni/cache_locality.hh>
+#include <ni/hash/multi_linear_hash.hh>
+#include <ni/hazard_pointers.hh>
+#include <ni/string_view.hh>
+
+namespace ni
+{
+namespace details
+{
+// Hashes strings of any length with `MultiLinearDoubleHash`, one chunk of
+// `CHUNK_SIZE` bytes at a time
+class MultiLinearStringHash
+{
+public:
+  static constexpr size_t CHUNK_SIZE = 64;
+
+  size_t operator()(string_view str) const noexcept
+  {
+    const char* data = str.data();
+    size_t len = str.size();
+    size_t hash = 0;
+    for (; len > CHUNK_SIZE; data += CHUNK_SIZE, len -= CHUNK_SIZE)
+      hash = (hash ^ m_hash(data, CHUNK_SIZE)) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ m_hash(data, len);
+  }
+
+private:
+  MultiLinearDoubleHash<CHUNK_SIZE> m_hash;
+};
+
+template <typename K>
+struct ConcurrentHashMapHash : std::hash<K>
+{
+};
+
+template <>
+struct ConcurrentHashMapHash<std::string> : MultiLinearStringHash
+{
+};
+
+template <>
+struct ConcurrentHashMapHash<string_view> : MultiLinearStringHash
+{
+};
+
+} // namespace details
+
+/// \brief Concurrent hash map with open addressing
+///
+/// Slots hold pointers to immutable entries and are probed linearly. Lookups
+/// are lock-free and never write to shared memory. Updates are lock-free
+/// CASes on a single slot: an update replaces the entry of its key, an
+/// erasure marks it as deleted (the key keeps its slot until the next
+/// resize). Replaced entries are reclaimed through `HazardPointers`.
+///
+/// When a table is three quarters full a new table is installed next to it
+/// (twice as large, unless most of the slots only hold deleted entries) and
+/// the content is migrated incrementally: every update migrates a chunk of
+/// `MIGRATION_CHUNK` slots before doing its own work. A migrated slot is
+/// frozen and its entry copied to the new table, operations that run into a
+/// frozen slot continue in the new table. Lookups are never delayed by a
+/// migration, an update only waits for one if the new table runs out of room
+/// first, and then helps finishing it.
+///
+/// The default hasher is `MultiLinearDoubleHash` for `std::string` and
+/// `string_view` keys, its random seed makes hash flooding impractical, and
+/// `std::hash` for other keys. Hash values are spread with a multiplicative
+/// hash, so weak hashers such as the identity are fine.
+///
+/// **Reference**
+///
+/// * C. Click. A Lock-Free Wait-Free Hash Table. Stanford EE380, 2007.
+/// * M. Herlihy and N. Shavit. The Art of Multiprocessor Programming,
+///   chapter 13. Morgan Kaufmann, 2008.
+///
+/// \param K type of the keys, copy constructible
+/// \param V type of the values, copy constructible
+/// \param Hash hasher returning `size_t` (or a narrower integer)
+/// \param KeyEqual equality of keys
+template <typename K, typename V,
+          typename Hash = details::ConcurrentHashMapHash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class ConcurrentHashMap
+{
+public:
+  using Key = K;
+  using Value = V;
+
+  static constexpr size_t MIN_CAPACITY = 16;
+  static constexpr size_t MIGRATION_CHUNK = 256;
+
+  /// \param capacity initial number of slots, rounded up to a power of two
+  explicit ConcurrentHashMap(size_t capacity = MIN_CAPACITY,
+                             const Hash& hash = Hash(),
+                             const KeyEqual& equal = KeyEqual());
+  ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+  ~ConcurrentHashMap();
+
+  /// \brief Look `key` up
+  /// \param [out] value copy of the value if found
+  /// \return false if `key` is not in the map
+  bool find(const Key& key, Value* value) const;
+
+  bool contains(const Key& key) const;
+
+  /// \brief Insert `key` if it is not in the map yet
+  /// \return false if `key` was already in the map
+  bool insert(const Key& key, const Value& value);
+
+  /// \brief Insert `key` or replace its value
+  /// \return true if `key` was inserted, false if its value was replaced
+  bool insert_or_assign(const Key& key, const Value& value);
+
+  /// \return false if `key` was not in the map
+  bool erase(const Key& key);
+
+  /// \return an estimation of the number of elements
+  size_t size_approx() const noexcept;
+
+  /// \return number of slots of the current table
+  size_t capacity() const noexcept;
+
+private:
+  struct Entry
+  {
+    size_t hash;
+    Key key;
+    Value value;
+  };
+
+  static_assert(alignof(Entry) >= 8, "Slots need 3 free bits");
+
+  // Bits of a slot, the rest is the address of an entry
+  static constexpr uintptr_t DELETED = 1;
+  // The slot has been migrated, or is being migrated, to the next table
+  static constexpr uintptr_t FROZEN = 2;
+  // The entry of a frozen slot has been copied to the next table
+  static constexpr uintptr_t COPIED = 4;
+  static constexpr uintptr_t FLAGS = DELETED | FROZEN | COPIED;
+
+  class Table
+  {
+  public:
+    // `inbound` is the number of slots reserved for the migration of the
+    // previous table
+    Table(size_t capacity, size_t inbound);
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+    // Destroys the remaining entries
+    ~Table();
+
+    size_t capacity() const noexcept;
+    size_t threshold() const noexcept;
+    size_t home(size_t hash) const noexcept;
+    std::atomic<uintptr_t>& slot(size_t index) noexcept;
+
+    // Reserve a slot for a new key, false if the table is too full
+    bool reserve(bool migrating_in) noexcept;
+
+    std::atomic<size_t> used;
+    NI_PADDING_AFTER(sizeof(used));
+    std::atomic<Table*> next;
+    std::atomic<size_t> claimed;
+    std::atomic<size_t> migrated;
+
+  private:
+    const size_t m_mask;
+    const unsigned m_shift;
+    const size_t m_inbound;
+    std::atomic<uintptr_t>* m_slots;
+  };
+
+  enum class Mode
+  {
+    Insert,
+    Assign,
+    Erase
+  };
+
+  enum class Outcome
+  {
+    Success,
+    Failure,
+    Moved,
+    Full
+  };
+
+  NI_CACHELINE_ALIGNED std::atomic<Table*> m_table;
+  NI_CACHELINE_ALIGNED std::atomic<ptrdiff_t> m_size;
+  NI_PADDING_AFTER(sizeof(m_size));
+  Hash m_hash;
+  KeyEqual m_equal;
+
+  static Entry* entry(uintptr_t slot) noexcept;
+  static uintptr_t protect(HazardPointers::Guard& guard,
+                           const std::atomic<uintptr_t>& slot) noexcept;
+  static void reclaim_table(void* table) noexcept;
+
+  bool matches(const Entry* entry, size_t hash, const Key& key) const;
+  bool modify(const Key& key, Mode mode, const Value* value);
+  Outcome modify_in(Table* table, size_t hash, const Key& key, Mode mode,
+                    const Value* value, std::unique_ptr<Entry>& fresh,
+                    HazardPointers::Guard& next_guard,
+                    HazardPointers::Guard& entry_guard);
+
+  // Protect the next table of `table`, null if it may have been retired
+  Table* protect_next(Table* table, HazardPointers::Guard& guard) const
+    noexcept;
+  // Move `table_guard` on to the next table, null if it may have been retired
+  Table* next_table(Table* table, HazardPointers::Guard& table_guard,
+                    HazardPointers::Guard& next_guard) const noexcept;
+
+  void start_resize(Table* table);
+  void help_migrate(Table* table, bool finish,
+                    HazardPointers::Guard& next_guard,
+                    HazardPointers::Guard& entry_guard);
+  uintptr_t migrate_slot(Table* table, Table* next, size_t index,
+                         HazardPointers::Guard& guard);
+  void insert_copy(Table* table, const Entry* source,
+                   HazardPointers::Guard& guard);
+};
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::Table(size_t capacity,
+                                                      size_t inbound)
+  : used()
+  , next()
+  , claimed()
+  , migrated()
+  , m_mask(capacity - 1)
+  , m_shift(64 - __builtin_ctzll(capacity))
+  , m_inbound(inbound)
+  , m_slots()
+{
+  assert(capacity > 1 && (capacity & (capacity - 1)) == 0 &&
+         "capacity must be a power of two");
+
+  int rc = posix_memalign(reinterpret_cast<void**>(&m_slots),
+                          NI_CACHELINE_SIZE<size_t>,
+                          sizeof(std::atomic<uintptr_t>) * capacity);
+  if (rc)
+    throw std::system_error(rc, std::system_category(), __func__);
+
+  for (size_t i = 0; i < capacity; ++i)
+    new (&m_slots[i]) std::atomic<uintptr_t>(0);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::~Table()
+{
+  for (size_t i = 0; i < capacity(); ++i)
+    delete entry(m_slots[i].load(std::memory_order_relaxed));
+  free(m_slots);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+size_t ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::capacity() const
+  noexcept
+{
+  return m_mask + 1;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+size_t ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::threshold() const
+  noexcept
+{
+  return capacity() / 4 * 3;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+size_t ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::home(size_t hash) const
+  noexcept
+{
+  return static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL >> m_shift;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+std::atomic<uintptr_t>&
+ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::slot(size_t index) noexcept
+{
+  return m_slots[index & m_mask];
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::Table::reserve(
+  bool migrating_in) noexcept
+{
+  // While the previous table is migrated, keep room for all of its entries
+  size_t limit = threshold();
+  if (migrating_in)
+    limit = limit > m_inbound ? limit - m_inbound : 0;
+
+  if (used.fetch_add(1, std::memory_order_relaxed) < limit)
+    return true;
+  used.fetch_sub(1, std::memory_order_relaxed);
+  return false;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+ConcurrentHashMap<K, V, Hash, KeyEqual>::ConcurrentHashMap(
+  size_t capacity, const Hash& hash, const KeyEqual& equal)
+  : m_table()
+  , m_size()
+  , m_hash(hash)
+  , m_equal(equal)
+{
+  size_t rounded = MIN_CAPACITY;
+  while (rounded < capacity)
+    rounded *= 2;
+  m_table.store(new Table(rounded, 0), std::memory_order_release);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+ConcurrentHashMap<K, V, Hash, KeyEqual>::~ConcurrentHashMap()
+{
+  // Older tables have been retired, only a migration in progress may leave
+  // two tables behind
+  Table* table = m_table.load(std::memory_order_relaxed);
+  delete table->next.load(std::memory_order_relaxed);
+  delete table;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::find(const Key& key,
+                                                   Value* value) const
+{
+  const size_t hash = m_hash(key);
+  HazardPointers::Guard table_guard;
+  HazardPointers::Guard next_guard;
+  HazardPointers::Guard entry_guard;
+
+  Table* table = table_guard.protect(m_table);
+  while (true)
+  {
+    bool moved = true;
+    size_t index = table->home(hash);
+    for (size_t n = 0; n < table->capacity(); ++n, ++index)
+    {
+      uintptr_t slot = protect(entry_guard, table->slot(index));
+      Entry* e = entry(slot);
+      if (!e)
+      {
+        // A frozen empty slot ends the chain of the keys which have been
+        // inserted in the next table since
+        moved = slot & FROZEN;
+        break;
+      }
+      if (!matches(e, hash, key))
+        continue;
+
+      // Until a frozen entry is copied, the next table cannot hold a more
+      // recent version of it
+      if ((slot & FROZEN) && (slot & (DELETED | COPIED)))
+        break;
+      if (slot & DELETED)
+        return false;
+      *value = e->value;
+      return true;
+    }
+
+    if (moved && table->next.load(std::memory_order_acquire))
+    {
+      table = next_table(table, table_guard, next_guard);
+      if (!table)
+        table = table_guard.protect(m_table);
+    }
+    else
+      return false;
+  }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::contains(const Key& key) const
+{
+  Value value;
+  return find(key, &value);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::insert(const Key& key,
+                                                     const Value& value)
+{
+  return modify(key, Mode::Insert, &value);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::insert_or_assign(
+  const Key& key, const Value& value)
+{
+  return modify(key, Mode::Assign, &value);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::erase(const Key& key)
+{
+  return modify(key, Mode::Erase, nullptr);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+size_t ConcurrentHashMap<K, V, Hash, KeyEqual>::size_approx() const noexcept
+{
+  ptrdiff_t size = m_size.load(std::memory_order_relaxed);
+  return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+size_t ConcurrentHashMap<K, V, Hash, KeyEqual>::capacity() const noexcept
+{
+  HazardPointers::Guard guard;
+  return guard.protect(m_table)->capacity();
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+typename ConcurrentHashMap<K, V, Hash, KeyEqual>::Entry*
+ConcurrentHashMap<K, V, Hash, KeyEqual>::entry(uintptr_t slot) noexcept
+{
+  return reinterpret_cast<Entry*>(slot & ~FLAGS);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+uintptr_t ConcurrentHashMap<K, V, Hash, KeyEqual>::protect(
+  HazardPointers::Guard& guard, const std::atomic<uintptr_t>& slot) noexcept
+{
+  uintptr_t value = slot.load(std::memory_order_relaxed);
+  while (true)
+  {
+    guard.set(entry(value));
+    uintptr_t current = slot.load(std::memory_order_acquire);
+    if (current == value)
+      return current;
+    value = current;
+  }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void ConcurrentHashMap<K, V, Hash, KeyEqual>::reclaim_table(
+  void* table) noexcept
+{
+  delete static_cast<Table*>(table);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::matches(const Entry* entry,
+                                                      size_t hash,
+                                                      const Key& key) const
+{
+  return entry->hash == hash && m_equal(entry->key, key);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+bool ConcurrentHashMap<K, V, Hash, KeyEqual>::modify(const Key& key,
+                                                     Mode mode,
+                                                     const Value* value)
+{
+  const size_t hash = m_hash(key);
+  std::unique_ptr<Entry> fresh;
+  HazardPointers::Guard table_guard;
+  HazardPointers::Guard next_guard;
+  HazardPointers::Guard entry_guard;
+
+  Table* table = table_guard.protect(m_table);
+  if (table->next.load(std::memory_order_acquire))
+    help_migrate(table, false, next_guard, entry_guard);
+
+  while (true)
+  {
+    switch (modify_in(table, hash, key, mode, value, fresh, next_guard,
+                      entry_guard))
+    {
+    case Outcome::Success:
+      return true;
+    case Outcome::Failure:
+      return false;
+    case Outcome::Moved:
+      table = next_table(table, table_guard, next_guard);
+      if (!table)
+        table = table_guard.protect(m_table);
+      break;
+    case Outcome::Full:
+    {
+      Table* current = table_guard.protect(m_table);
+      if (current == table && !current->next.load(std::memory_order_acquire))
+        start_resize(current);
+      if (current->next.load(std::memory_order_acquire))
+        help_migrate(current, true, next_guard, entry_guard);
+      table = table_guard.protect(m_table);
+      break;
+    }
+    }
+  }
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+typename ConcurrentHashMap<K, V, Hash, KeyEqual>::Outcome
+ConcurrentHashMap<K, V, Hash, KeyEqual>::modify_in(
+  Table* table, size_t hash, const Key& key, Mode mode, const Value* value,
+  std::unique_ptr<Entry>& fresh, HazardPointers::Guard& next_guard,
+  HazardPointers::Guard& guard)
+{
+  size_t index = table->home(hash);
+  for (size_t n = 0; n < table->capacity(); ++n, ++index)
+  {
+    std::atomic<uintptr_t>& slot = table->slot(index);
+    uintptr_t current = protect(guard, slot);
+    while (true)
+    {
+      if (current & FROZEN)
+      {
+        // The rest of the chain has to be migrated before the key can be
+        // updated in the next table
+        Table* next = protect_next(table, next_guard);
+        for (; next && n < table->capacity(); ++n, ++index)
+        {
+          if (!entry(migrate_slot(table, next, index, guard)))
+            break;
+        }
+        return Outcome::Moved;
+      }
+
+      Entry* e = entry(current);
+      if (e && !matches(e, hash, key))
+        break;
+
+      uintptr_t desired;
+      if (mode == Mode::Erase)
+      {
+        if (!e || (current & DELETED))
+          return Outcome::Failure;
+        desired = current | DELETED;
+      }
+      else
+      {
+        if (mode == Mode::Insert && e && !(current & DELETED))
+          return Outcome::Failure;
+        if (!e &&
+            !table->reserve(m_table.load(std::memory_order_acquire) != table))
+          return Outcome::Full;
+        if (!fresh)
+          fresh.reset(new Entry{ hash, key, *value });
+        desired = reinterpret_cast<uintptr_t>(fresh.get());
+      }
+
+      if (slot.compare_exchange_strong(current, desired,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_relaxed))
+      {
+        fresh.release();
+        if (mode == Mode::Erase)
+        {
+          m_size.fetch_sub(1, std::memory_order_relaxed);
+          return Outcome::Success;
+        }
+
+        bool inserted = !e || (current & DELETED);
+        if (e)
+          HazardPointers::retire(e);
+        if (inserted)
+          m_size.fetch_add(1, std::memory_order_relaxed);
+        return inserted ? Outcome::Success : Outcome::Failure;
+      }
+
+      if (!e)
+        table->used.fetch_sub(1, std::memory_order_relaxed);
+      current = protect(guard, slot);
+    }
+  }
+  return Outcome::Full;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+typename ConcurrentHashMap<K, V, Hash, KeyEqual>::Table*
+ConcurrentHashMap<K, V, Hash, KeyEqual>::protect_next(
+  Table* table, HazardPointers::Guard& guard) const noexcept
+{
+  Table* next = table->next.load(std::memory_order_acquire);
+  guard.set(next);
+
+  // The next table is only retired once a newer table is current
+  Table* current = m_table.load(std::memory_order_acquire);
+  return current == table || current == next ? next : nullptr;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+typename ConcurrentHashMap<K, V, Hash, KeyEqual>::Table*
+ConcurrentHashMap<K, V, Hash, KeyEqual>::next_table(
+  Table* table, HazardPointers::Guard& table_guard,
+  HazardPointers::Guard& next_guard) const noexcept
+{
+  Table* next = protect_next(table, next_guard);
+  if (!next)
+    return nullptr;
+
+  table_guard.set(next);
+  next_guard.reset();
+  return next;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void ConcurrentHashMap<K, V, Hash, KeyEqual>::start_resize(Table* table)
+{
+  // Tables mostly filled with deleted entries are only cleaned up
+  size_t capacity = table->capacity();
+  if (size_approx() >= capacity / 4)
+    capacity *= 2;
+
+  Table* next = new Table(capacity, table->threshold());
+  Table* expected = nullptr;
+  if (!table->next.compare_exchange_strong(expected, next,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire))
+    delete next;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void ConcurrentHashMap<K, V, Hash, KeyEqual>::help_migrate(
+  Table* table, bool finish, HazardPointers::Guard& next_guard,
+  HazardPointers::Guard& entry_guard)
+{
+  Table* next = protect_next(table, next_guard);
+  if (!next)
+    return;
+
+  const size_t capacity = table->capacity();
+  bool done = false;
+  do
+  {
+    size_t begin =
+      table->claimed.fetch_add(MIGRATION_CHUNK, std::memory_order_relaxed);
+    if (begin >= capacity)
+      break;
+
+    size_t end = std::min(begin + MIGRATION_CHUNK, capacity);
+    for (size_t i = begin; i < end; ++i)
+      migrate_slot(table, next, i, entry_guard);
+    done = table->migrated.fetch_add(end - begin, std::memory_order_acq_rel) +
+             (end - begin) ==
+           capacity;
+  } while (finish && !done);
+
+  if (!done)
+  {
+    if (!finish)
+      return;
+    // Every chunk has been claimed but some are still being migrated (or
+    // their migration failed with an exception), migrating a slot twice is
+    // harmless
+    for (size_t i = 0; i < capacity; ++i)
+      migrate_slot(table, next, i, entry_guard);
+  }
+
+  Table* expected = table;
+  if (m_table.compare_exchange_strong(expected, next,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_relaxed))
+    HazardPointers::retire(table, &reclaim_table);
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+uintptr_t ConcurrentHashMap<K, V, Hash, KeyEqual>::migrate_slot(
+  Table* table, Table* next, size_t index, HazardPointers::Guard& guard)
+{
+  std::atomic<uintptr_t>& slot = table->slot(index);
+  uintptr_t current = slot.load(std::memory_order_acquire);
+  while (!(current & FROZEN))
+  {
+    if (slot.compare_exchange_weak(current, current | FROZEN,
+                                   std::memory_order_acq_rel,
+                                   std::memory_order_acquire))
+    {
+      current |= FROZEN;
+      break;
+    }
+  }
+
+  // Entries of frozen slots belong to the table, hence the copy
+  const Entry* e = entry(current);
+  if (e && !(current & (DELETED | COPIED)))
+  {
+    insert_copy(next, e, guard);
+    current = slot.fetch_or(COPIED, std::memory_order_acq_rel) | COPIED;
+  }
+  return current;
+}
+
+template <typename K, typename V, typename Hash, typename KeyEqual>
+void ConcurrentHashMap<K, V, Hash, KeyEqual>::insert_copy(
+  Table* table, const Entry* source, HazardPointers::Guard& guard)
+{
+  std::unique_ptr<Entry> copy(new Entry(*source));
+  uintptr_t desired = reinterpret_cast<uintptr_t>(copy.get());
+
+  size_t index = table->home(source->hash);
+  for (size_t n = 0; n < table->capacity(); ++n, ++index)
+  {
+    std::atomic<uintptr_t>& slot = table->slot(index);
+    uintptr_t current = protect(guard, slot);
+    while (!current)
+    {
+      // Room for the copies is reserved up front
+      table->used.fetch_add(1, std::memory_order_relaxed);
+      if (slot.compare_exchange_strong(current, desired,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_relaxed))
+      {
+        copy.release();
+        return;
+      }
+      table->used.fetch_sub(1, std::memory_order_relaxed);
+      current = protect(guard, slot);
+    }
+
+    // Copied by another thread (and maybe updated since)
+    Entry* e = entry(current);
+    if (e && matches(e, source->hash, source->key))
+      return;
+  }
+  assert(false && "no room left for the migration");
+}
+
+} // namespace ni
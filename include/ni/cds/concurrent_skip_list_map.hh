@@ -0,0 +1,710 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include <ni/hazard_pointers.hh>
+#include <ni/memory/node_pool.hh>
+#include <ni/random.hh>
+#include <ni/tagged_ptr.hh>
+
+namespace ni
+{
+/// \brief Lock-free ordered map based on a skip list
+///
+/// Every node has a tower of links, a link is marked (with the low bit tag of
+/// `DoubleTagPtr`) when its node is being erased, which freezes it. An
+/// erasure marks the links of its node from the top down, and the thread
+/// which marks the bottom link is the one which erased the key. Marked nodes
+/// are unlinked by the traversals that run into them.
+///
+/// A node counts the links pointing to it plus one for its inserter, which
+/// links it level after level. It is retired to `HazardPointers` once it is
+/// unlinked from every level and its inserter is done. Traversals keep three
+/// hazard pointers, an iterator one.
+///
+/// Towers are allocated from `NodeAllocator` in 5 size classes of 1, 2, 4, 8
+/// and 16 links. The height of a node is 1 with probability 3/4, so most
+/// nodes are small.
+///
+/// **Reference**
+///
+/// * K. Fraser. Practical Lock-Freedom. PhD thesis, University of Cambridge,
+///   2004.
+/// * M. Herlihy and N. Shavit. The Art of Multiprocessor Programming,
+///   chapter 14. Morgan Kaufmann, 2008.
+///
+/// \param K type of the keys, copy constructible
+/// \param V type of the values, copy constructible
+/// \param Compare strict weak ordering of the keys
+/// \param NodeAllocator see `HeapNodeAllocator` and `NodePool`
+template <typename K, typename V, typename Compare = std::less<K>,
+          template <typename> class NodeAllocator = NodePool>
+class ConcurrentSkipListMap
+{
+  struct Node;
+  using NodePtr = DoubleTagPtr<Node, uint8_t, 8>;
+  using AtomicNodePtr = AtomicTaggedPtr<NodePtr>;
+
+public:
+  using Key = K;
+  using Value = V;
+
+  static constexpr size_t MAX_HEIGHT = 16;
+
+  /// \brief Forward iterator over the elements in key order
+  ///
+  /// An iterator protects its element with a hazard pointer, so the element
+  /// remains valid while it is erased concurrently. Incrementing an iterator
+  /// whose element has been erased continues with the next greater key.
+  class Iterator
+  {
+  public:
+    Iterator() noexcept;
+    Iterator(const Iterator& other);
+    Iterator& operator=(const Iterator& other);
+
+    const Key& key() const noexcept;
+    const Value& value() const noexcept;
+
+    Iterator& operator++();
+
+    bool operator==(const Iterator& other) const noexcept;
+    bool operator!=(const Iterator& other) const noexcept;
+
+  private:
+    friend class ConcurrentSkipListMap;
+
+    Iterator(const ConcurrentSkipListMap* map, Node* node);
+
+    const ConcurrentSkipListMap* m_map;
+    Node* m_node;
+    HazardPointers::Guard m_guard;
+  };
+
+  explicit ConcurrentSkipListMap(const Compare& compare = Compare());
+  ConcurrentSkipListMap(const ConcurrentSkipListMap&) = delete;
+  ConcurrentSkipListMap& operator=(const ConcurrentSkipListMap&) = delete;
+  ~ConcurrentSkipListMap();
+
+  /// \param [out] value copy of the value if found
+  /// \return false if `key` is not in the map
+  bool find(const Key& key, Value* value) const;
+
+  bool contains(const Key& key) const;
+
+  /// \brief Insert `key` if it is not in the map yet
+  /// \return false if `key` was already in the map
+  bool insert(const Key& key, const Value& value);
+
+  /// \return false if `key` was not in the map
+  bool erase(const Key& key);
+
+  /// \return iterator to the first element whose key is not less than `key`
+  Iterator lower_bound(const Key& key) const;
+
+  Iterator begin() const;
+  Iterator end() const;
+
+private:
+  struct Node
+  {
+    Key key;
+    Value value;
+    std::atomic<uint32_t> refs;
+    const uint32_t height;
+    // The tower, `height` links long
+    AtomicNodePtr next[1];
+
+    Node(const Key& k, const Value& v, uint32_t h);
+  };
+
+  template <size_t LINKS>
+  struct Tower
+  {
+    alignas(Node) unsigned char storage[sizeof(Node) +
+                                        (LINKS - 1) * sizeof(AtomicNodePtr)];
+  };
+
+  // Hazard pointers of a traversal, `pred` is null for the head
+  struct Finger
+  {
+    HazardPointers::Guard guards[3];
+    Node* pred;
+    Node* curr;
+  };
+
+  static constexpr uint8_t MARKED = 1;
+
+  AtomicNodePtr m_head[MAX_HEIGHT];
+  std::atomic<size_t> m_height;
+  Compare m_compare;
+
+  static uint32_t random_height() noexcept;
+  static size_t size_class(uint32_t height) noexcept;
+  static void* allocate_tower(size_t size_class);
+  static void deallocate_tower(void* ptr, size_t size_class) noexcept;
+  static Node* create_node(const Key& key, const Value& value,
+                           uint32_t height);
+  static void destroy_node(Node* node) noexcept;
+  static void reclaim_node(void* node) noexcept;
+  // Drop a reference, the last one retires the node
+  static void release(Node* node);
+  static NodePtr protect(HazardPointers::Guard& guard,
+                         const AtomicNodePtr& link) noexcept;
+
+  AtomicNodePtr& link(Node* pred, size_t level) const noexcept;
+  bool equal(const Key& a, const Key& b) const;
+
+  // Find the nodes around `key` at `level`: `pred` is the last node whose key
+  // is less than `key` (not greater than `key` if `upper`), `curr` the next
+  // one. Unlinks the marked nodes on the way.
+  void search(const Key& key, size_t level, bool upper, Finger& finger) const;
+};
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Node::Node(
+  const Key& k, const Value& v, uint32_t h)
+  : key(k)
+  , value(v)
+  , refs()
+  , height(h)
+  , next()
+{
+  for (uint32_t i = 1; i < height; ++i)
+    new (&next[i]) AtomicNodePtr();
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::
+  Iterator() noexcept
+  : m_map()
+  , m_node()
+  , m_guard()
+{
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::Iterator(
+  const ConcurrentSkipListMap* map, Node* node)
+  : m_map(map)
+  , m_node(node)
+  , m_guard()
+{
+  // The caller keeps `node` protected meanwhile
+  m_guard.set(node);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::Iterator(
+  const Iterator& other)
+  : Iterator(other.m_map, other.m_node)
+{
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator&
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::operator=(
+  const Iterator& other)
+{
+  m_map = other.m_map;
+  m_node = other.m_node;
+  m_guard.set(m_node);
+  return *this;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+const K& ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::key()
+  const noexcept
+{
+  return m_node->key;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+const V&
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::value() const
+  noexcept
+{
+  return m_node->value;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator&
+  ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::operator++()
+{
+  Finger finger;
+  Node* node = m_node;
+  while (node)
+  {
+    NodePtr next = node->next[0].load(std::memory_order_acquire);
+    if (next.tag2() == MARKED)
+    {
+      // The links of an erased node are frozen and may point to nodes which
+      // have been reclaimed, start over from the head
+      m_map->search(node->key, 0, true, finger);
+      next = NodePtr(finger.curr);
+    }
+    else
+    {
+      finger.guards[0].set(next.value());
+      if (node->next[0].load(std::memory_order_acquire) != next)
+        continue;
+    }
+
+    node = next.value();
+    m_guard.set(node);
+    // Skip the erased nodes
+    if (!node || node->next[0].load(std::memory_order_acquire).tag2() == 0)
+      break;
+  }
+  m_node = node;
+  return *this;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::
+operator==(const Iterator& other) const noexcept
+{
+  return m_node == other.m_node;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator::
+operator!=(const Iterator& other) const noexcept
+{
+  return !(*this == other);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::ConcurrentSkipListMap(
+  const Compare& compare)
+  : m_head()
+  , m_height(1)
+  , m_compare(compare)
+{
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::~ConcurrentSkipListMap()
+{
+  // Unlink the erased nodes which are still linked at some levels, so that
+  // the bottom level holds every remaining node exactly once
+  for (size_t level = MAX_HEIGHT; level-- > 0;)
+  {
+    AtomicNodePtr* prev = &m_head[level];
+    while (Node* node = prev->load(std::memory_order_relaxed).value())
+    {
+      NodePtr next = node->next[level].load(std::memory_order_relaxed);
+      if (next.tag2() == MARKED)
+      {
+        prev->store(NodePtr(next.value()), std::memory_order_relaxed);
+        release(node);
+      }
+      else
+        prev = &node->next[level];
+    }
+  }
+
+  Node* node = m_head[0].load(std::memory_order_relaxed).value();
+  while (node)
+  {
+    Node* next = node->next[0].load(std::memory_order_relaxed).value();
+    destroy_node(node);
+    node = next;
+  }
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::find(
+  const Key& key, Value* value) const
+{
+  Finger finger;
+  search(key, 0, false, finger);
+  if (!finger.curr || !equal(finger.curr->key, key))
+    return false;
+  *value = finger.curr->value;
+  return true;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::contains(
+  const Key& key) const
+{
+  Finger finger;
+  search(key, 0, false, finger);
+  return finger.curr && equal(finger.curr->key, key);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::insert(
+  const Key& key, const Value& value)
+{
+  Finger finger;
+  Node* node = nullptr;
+  while (true)
+  {
+    search(key, 0, false, finger);
+    if (finger.curr && equal(finger.curr->key, key))
+    {
+      if (node)
+        destroy_node(node);
+      return false;
+    }
+
+    if (!node)
+    {
+      node = create_node(key, value, random_height());
+      // One for the bottom level link, one for the inserter
+      node->refs.store(2, std::memory_order_relaxed);
+    }
+    node->next[0].store(NodePtr(finger.curr), std::memory_order_relaxed);
+    NodePtr expected(finger.curr);
+    if (link(finger.pred, 0).compare_exchange_strong(
+          expected, NodePtr(node), std::memory_order_release,
+          std::memory_order_relaxed))
+      break;
+  }
+
+  // Searches only start from the current height
+  size_t height = m_height.load(std::memory_order_relaxed);
+  while (height < node->height &&
+         !m_height.compare_exchange_weak(height, node->height,
+                                         std::memory_order_relaxed))
+  {
+  }
+
+  for (size_t level = 1; level < node->height; ++level)
+  {
+    while (true)
+    {
+      search(key, level, false, finger);
+
+      // Stop if the node is erased meanwhile
+      NodePtr next = node->next[level].load(std::memory_order_acquire);
+      if (next.tag2() == MARKED ||
+          !node->next[level].compare_exchange_strong(
+            next, NodePtr(finger.curr), std::memory_order_relaxed,
+            std::memory_order_relaxed))
+      {
+        level = node->height;
+        break;
+      }
+
+      node->refs.fetch_add(1, std::memory_order_relaxed);
+      NodePtr expected(finger.curr);
+      if (link(finger.pred, level)
+            .compare_exchange_strong(expected, NodePtr(node),
+                                     std::memory_order_release,
+                                     std::memory_order_relaxed))
+        break;
+      node->refs.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  // An erasure which ran before the upper levels were linked could not
+  // unlink them
+  if (node->next[0].load(std::memory_order_acquire).tag2() == MARKED)
+    search(key, 0, false, finger);
+  release(node);
+  return true;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::erase(
+  const Key& key)
+{
+  Finger finger;
+  search(key, 0, false, finger);
+  Node* node = finger.curr;
+  if (!node || !equal(node->key, key))
+    return false;
+
+  HazardPointers::Guard node_guard;
+  node_guard.set(node);
+
+  for (size_t level = node->height; level-- > 0;)
+  {
+    NodePtr next = node->next[level].load(std::memory_order_relaxed);
+    while (next.tag2() != MARKED)
+    {
+      if (node->next[level].compare_exchange_weak(
+            next, NodePtr(next.value(), 0, MARKED),
+            std::memory_order_acq_rel, std::memory_order_relaxed))
+      {
+        if (level == 0)
+        {
+          search(key, 0, false, finger);
+          return true;
+        }
+        break;
+      }
+    }
+  }
+  // Erased by another thread
+  return false;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::lower_bound(
+  const Key& key) const
+{
+  Finger finger;
+  search(key, 0, false, finger);
+  return Iterator(this, finger.curr);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::begin() const
+{
+  HazardPointers::Guard guard;
+  Node* node = protect(guard, m_head[0]).value();
+  Iterator it(this, node);
+  // Skip the erased nodes
+  if (node && node->next[0].load(std::memory_order_acquire).tag2() == MARKED)
+    ++it;
+  return it;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Iterator
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::end() const
+{
+  return Iterator(this, nullptr);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+uint32_t ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::random_height()
+  noexcept
+{
+  // Two random bits per level
+  uint32_t bits = thread_rng()() | (1u << (2 * (MAX_HEIGHT - 1)));
+  return 1 + __builtin_ctz(bits) / 2;
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+size_t ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::size_class(
+  uint32_t height) noexcept
+{
+  return height <= 1 ? 0 : 32 - __builtin_clz(height - 1);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+void* ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::allocate_tower(
+  size_t size_class)
+{
+  switch (size_class)
+  {
+  case 0:
+    return NodeAllocator<Tower<1>>::allocate();
+  case 1:
+    return NodeAllocator<Tower<2>>::allocate();
+  case 2:
+    return NodeAllocator<Tower<4>>::allocate();
+  case 3:
+    return NodeAllocator<Tower<8>>::allocate();
+  default:
+    return NodeAllocator<Tower<MAX_HEIGHT>>::allocate();
+  }
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+void ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::deallocate_tower(
+  void* ptr, size_t size_class) noexcept
+{
+  switch (size_class)
+  {
+  case 0:
+    return NodeAllocator<Tower<1>>::deallocate(static_cast<Tower<1>*>(ptr));
+  case 1:
+    return NodeAllocator<Tower<2>>::deallocate(static_cast<Tower<2>*>(ptr));
+  case 2:
+    return NodeAllocator<Tower<4>>::deallocate(static_cast<Tower<4>*>(ptr));
+  case 3:
+    return NodeAllocator<Tower<8>>::deallocate(static_cast<Tower<8>*>(ptr));
+  default:
+    return NodeAllocator<Tower<MAX_HEIGHT>>::deallocate(
+      static_cast<Tower<MAX_HEIGHT>*>(ptr));
+  }
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::Node*
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::create_node(
+  const Key& key, const Value& value, uint32_t height)
+{
+  void* ptr = allocate_tower(size_class(height));
+  try
+  {
+    return new (ptr) Node(key, value, height);
+  }
+  catch (...)
+  {
+    deallocate_tower(ptr, size_class(height));
+    throw;
+  }
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+void ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::destroy_node(
+  Node* node) noexcept
+{
+  size_t size_class = ConcurrentSkipListMap::size_class(node->height);
+  node->~Node();
+  deallocate_tower(node, size_class);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+void ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::reclaim_node(
+  void* node) noexcept
+{
+  destroy_node(static_cast<Node*>(node));
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+void ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::release(Node* node)
+{
+  if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    HazardPointers::retire(node, &reclaim_node);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::NodePtr
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::protect(
+  HazardPointers::Guard& guard, const AtomicNodePtr& link) noexcept
+{
+  NodePtr ptr = link.load(std::memory_order_relaxed);
+  while (true)
+  {
+    guard.set(ptr.value());
+    // Compares the mark as well
+    NodePtr current = link.load(std::memory_order_acquire);
+    if (current == ptr)
+      return current;
+    ptr = current;
+  }
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+typename ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::AtomicNodePtr&
+ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::link(Node* pred,
+                                                          size_t level) const
+  noexcept
+{
+  return pred ? pred->next[level]
+              : const_cast<AtomicNodePtr&>(m_head[level]);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+bool ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::equal(
+  const Key& a, const Key& b) const
+{
+  return !m_compare(a, b) && !m_compare(b, a);
+}
+
+template <typename K, typename V, typename Compare,
+          template <typename> class NodeAllocator>
+void ConcurrentSkipListMap<K, V, Compare, NodeAllocator>::search(
+  const Key& key, size_t level, bool upper, Finger& finger) const
+{
+retry:
+  // Indexes of the guards protecting pred, curr and succ
+  unsigned p = 0, c = 1, s = 2;
+  Node* pred = nullptr;
+  Node* curr = nullptr;
+  size_t top = std::max(m_height.load(std::memory_order_relaxed), level + 1);
+
+  for (size_t l = top; l-- > level;)
+  {
+    NodePtr first = protect(finger.guards[c], link(pred, l));
+    // A marked link is frozen, its node cannot serve as pred
+    if (first.tag2() == MARKED)
+      goto retry;
+
+    curr = first.value();
+    while (curr)
+    {
+      NodePtr succ = protect(finger.guards[s], curr->next[l]);
+      if (succ.tag2() == MARKED)
+      {
+        // As long as curr is linked, succ is linked too
+        NodePtr expected(curr);
+        if (!link(pred, l).compare_exchange_strong(
+              expected, NodePtr(succ.value()), std::memory_order_acq_rel,
+              std::memory_order_relaxed))
+          goto retry;
+        release(curr);
+        curr = succ.value();
+        std::swap(c, s);
+        continue;
+      }
+
+      if (upper ? m_compare(key, curr->key) : !m_compare(curr->key, key))
+        break;
+      pred = curr;
+      curr = succ.value();
+      unsigned old_p = p;
+      p = c;
+      c = s;
+      s = old_p;
+    }
+  }
+
+  finger.pred = pred;
+  finger.curr = curr;
+}
+
+} // namespace ni
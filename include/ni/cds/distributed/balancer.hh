@@ -0,0 +1,208 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include <ni/cache_locality.hh>
+#include <ni/random.hh>
+
+namespace ni
+{
+// Balancers of `DistributedInterface`. A balancer picks the partial queue an
+// element is put into and the partial queue a get tries first. It provides
+//
+//   template <typename Partials>
+//   size_t put_index(const Partials& partials);
+//   template <typename Partials>
+//   size_t get_index(const Partials& partials);
+//
+// where `partials` describes the partial queues:
+//
+// * `size()`: number of partial queues
+// * `size_approx(i)`: estimation of the number of elements of queue `i`
+
+/// \brief Visit the partial queues in turn
+///
+/// Puts and gets each go through a shared counter, which keeps the partial
+/// queues balanced at the cost of a contended `fetch_add`.
+class RoundRobinBalancer
+{
+public:
+  RoundRobinBalancer() noexcept;
+
+  template <typename Partials>
+  size_t put_index(const Partials& partials) noexcept;
+
+  template <typename Partials>
+  size_t get_index(const Partials& partials) noexcept;
+
+private:
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_put;
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_get;
+
+  NI_PADDING_AFTER(sizeof(m_get));
+};
+
+/// \brief Bind every thread to the partial queue its id hashes to
+///
+/// Without contention between threads bound to different queues, but the
+/// queues are only balanced if the threads are.
+class AffinityBalancer
+{
+public:
+  template <typename Partials>
+  size_t put_index(const Partials& partials) noexcept;
+
+  template <typename Partials>
+  size_t get_index(const Partials& partials) noexcept;
+
+private:
+  static size_t thread_hash() noexcept;
+};
+
+/// \brief Pick a partial queue uniformly at random
+class RandomBalancer
+{
+public:
+  template <typename Partials>
+  size_t put_index(const Partials& partials) noexcept;
+
+  template <typename Partials>
+  size_t get_index(const Partials& partials) noexcept;
+};
+
+/// \brief Pick the emptiest (put) or fullest (get) of `D` random partial
+///        queues
+///
+/// **Reference**
+///
+/// * M. Mitzenmacher. The Power of Two Choices in Randomized Load Balancing.
+///   IEEE Transactions on Parallel and Distributed Systems, 12(10), 2001.
+///
+/// \param D number of choices
+template <size_t D = 2>
+class DRandomBalancer
+{
+public:
+  static_assert(D > 0, "DRandomBalancer needs at least one choice");
+
+  template <typename Partials>
+  size_t put_index(const Partials& partials) noexcept;
+
+  template <typename Partials>
+  size_t get_index(const Partials& partials) noexcept;
+};
+
+inline RoundRobinBalancer::RoundRobinBalancer() noexcept
+  : m_put()
+  , m_get()
+{
+}
+
+template <typename Partials>
+size_t RoundRobinBalancer::put_index(const Partials& partials) noexcept
+{
+  return m_put.fetch_add(1, std::memory_order_relaxed) % partials.size();
+}
+
+template <typename Partials>
+size_t RoundRobinBalancer::get_index(const Partials& partials) noexcept
+{
+  return m_get.fetch_add(1, std::memory_order_relaxed) % partials.size();
+}
+
+inline size_t AffinityBalancer::thread_hash() noexcept
+{
+  static thread_local size_t hash =
+    std::hash<std::thread::id>()(std::this_thread::get_id());
+  return hash;
+}
+
+template <typename Partials>
+size_t AffinityBalancer::put_index(const Partials& partials) noexcept
+{
+  return thread_hash() % partials.size();
+}
+
+template <typename Partials>
+size_t AffinityBalancer::get_index(const Partials& partials) noexcept
+{
+  return thread_hash() % partials.size();
+}
+
+template <typename Partials>
+size_t RandomBalancer::put_index(const Partials& partials) noexcept
+{
+  return thread_rng()(static_cast<uint32_t>(partials.size()));
+}
+
+template <typename Partials>
+size_t RandomBalancer::get_index(const Partials& partials) noexcept
+{
+  return thread_rng()(static_cast<uint32_t>(partials.size()));
+}
+
+template <size_t D>
+template <typename Partials>
+size_t DRandomBalancer<D>::put_index(const Partials& partials) noexcept
+{
+  pcg32& rng = thread_rng();
+  uint32_t length = static_cast<uint32_t>(partials.size());
+  size_t best = rng(length);
+  size_t best_size = partials.size_approx(best);
+  for (size_t i = 1; i < D && best_size; ++i)
+  {
+    size_t index = rng(length);
+    size_t size = partials.size_approx(index);
+    if (size < best_size)
+    {
+      best = index;
+      best_size = size;
+    }
+  }
+  return best;
+}
+
+template <size_t D>
+template <typename Partials>
+size_t DRandomBalancer<D>::get_index(const Partials& partials) noexcept
+{
+  pcg32& rng = thread_rng();
+  uint32_t length = static_cast<uint32_t>(partials.size());
+  size_t best = rng(length);
+  size_t best_size = partials.size_approx(best);
+  for (size_t i = 1; i < D; ++i)
+  {
+    size_t index = rng(length);
+    size_t size = partials.size_approx(index);
+    if (size > best_size)
+    {
+      best = index;
+      best_size = size;
+    }
+  }
+  return best;
+}
+
+} // namespace ni
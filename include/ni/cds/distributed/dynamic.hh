@@ -18,18 +18,43 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
-#include <mutex>
+#include <atomic>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 #include <ni/cache_locality.hh>
+#include <ni/cds/distributed/size_approx.hh>
+#include <ni/cds/distributed/snzi.hh>
+#include <ni/cds/distributed/victim.hh>
+#include <ni/hazard_pointers.hh>
+#include <ni/preprocessor.hh>
 #include <ni/random.hh>
-#include <ni/sync/spinlock.hh>
-#include <ni/tagged_ptr.hh>
+#include <ni/thread_bindings.hh>
 
 namespace ni
 {
-
 /// \brief Locally linearizable dynamic distributed container
 ///
+/// Every thread puts into its own backend, registered on its first `put`, and
+/// gets from it first before stealing from the others.
+///
+/// The backends are registered in slots claimed with a CAS, so registration
+/// never blocks. The slots are allocated in buckets of doubling capacity
+/// which are never moved: the registry grows while `get` scans it. Slots of
+/// removed backends are reused by later registrations and the backends
+/// themselves are retired to `HazardPointers`.
+///
+/// Backends turning non-empty arrive at a `SNZI` and depart once found empty,
+/// so `get` reports an empty structure without scanning the backends.
+///
+/// Threads either carry a `BackendPtr` to every call and deregister it before
+/// they exit, or use the overloads without one: their backend is then bound
+/// to the thread in `ThreadBindings` and deregistered when the thread exits.
+///
 /// **Reference**
 ///
 /// * Local linearizability for Concurrent -Type Data Structures.
@@ -37,23 +62,62 @@ namespace ni
 ///   A. Sezgin, A. Sokolova, and H. Veith. CoRR, abs/1502.07118, 2015.
 ///   http://arxiv.org/abs/1502.07118
 ///
-/// \param T type of the backend
-template <typename T>
+/// * F. Ellen, Y. Lev, V. Luchangco, and M. Moir. SNZI: Scalable NonZero
+///   Indicators. PODC '07.
+///
+/// \param T type of the backend. Its ABA protection is selected by its own
+///        parameters, e.g. `MSQueue<T, NodePool, WideTaggedPtrTraits>`.
+/// \param VictimPolicy picks the backend `get` steals from first when the
+///        local one is empty, see `RandomVictim`, `TwoChoicesVictim` and
+///        `NearestVictim`
+template <typename T, typename VictimPolicy = RandomVictim>
 class LLDynamicDistributed
 {
 private:
   using Backend = T;
 
-  class NI_CACHELINE_ALIGNED Node : TaggedPtr<Backend>
+  class NI_CACHELINE_ALIGNED Node
   {
   public:
-    Node();
-    ~Node();
+    explicit Node(size_t leaves);
 
     Backend* backend() noexcept;
-    // Indicates whether the backend is currently bound to a thread.
+    // Indicates whether the backend is currently bound to a thread. Turning
+    // it off publishes the last elements put by the owner.
     bool alive() noexcept;
     void turn_off() noexcept;
+    // Where the owner thread registered the backend
+    const Locality& locality() const noexcept;
+    // Whether the backend has arrived at the non-empty indicator, and where
+    std::atomic<bool>& indicated() noexcept;
+    size_t leaf() const noexcept;
+
+  private:
+    std::unique_ptr<Backend> m_backend;
+    std::atomic<bool> m_alive;
+    Locality m_locality;
+    std::atomic<bool> m_indicated;
+    size_t m_leaf;
+  };
+
+  using Slot = std::atomic<Node*>;
+
+  // Registered backends as seen by the victim-selection policy
+  class Victims
+  {
+  public:
+    Victims(LLDynamicDistributed* registry, size_t length, Node* local);
+
+    size_t size() const noexcept;
+    size_t size_approx(size_t index) const noexcept;
+    Locality locality(size_t index) const noexcept;
+    bool local(size_t index) const noexcept;
+
+  private:
+    LLDynamicDistributed* m_registry;
+    size_t m_length;
+    Node* m_local;
+    mutable HazardPointers::Guard m_guard;
   };
 
 public:
@@ -73,186 +137,346 @@ public:
     Node* m_ptr;
   };
 
+  /// \param segment_capacity initial number of backend slots, rounded up to
+  ///        a power of two. The registry grows beyond it.
   explicit LLDynamicDistributed(size_t segment_capacity);
+  LLDynamicDistributed(const LLDynamicDistributed&) = delete;
+  LLDynamicDistributed& operator=(const LLDynamicDistributed&) = delete;
   ~LLDynamicDistributed();
 
+  /// \brief Put an element into the local backend, registering it on the
+  ///        first call of the thread
   template <typename U>
   bool put(BackendPtr& local_backend, U&& element);
 
+  /// \brief Get an element, from the local backend if possible
+  ///
+  /// Steals from the other backends if the local one is empty, see
+  /// `set_steal_batch`.
+  ///
+  /// \return false if every backend was found empty, right away if none
+  ///         of them has been non-empty since
   bool get(BackendPtr& local_backend, Element* element);
 
+  /// \brief Put a range of elements into the local backend
+  ///
+  /// \return number of elements put
+  template <typename InputIt>
+  size_t put_bulk(BackendPtr& local_backend, InputIt first, InputIt last);
+
+  /// \brief Get up to `max` elements, from the local backend if possible
+  ///
+  /// Falls back to getting a single element from any backend if the local
+  /// one is empty.
+  ///
+  /// \return number of elements stored into `elements`
+  size_t get_bulk(BackendPtr& local_backend, Element* elements, size_t max);
+
   /// \brief Every thread that used this structure has to call this before exit.
   void deregister_thread(BackendPtr& local_backend);
 
-private:
-  Node** m_segment;
-  size_t m_segment_capacity;
-  size_t m_segment_length;
-  size_t m_version;
-  SpinLock m_lock;
+  /// \brief Steal up to `max` elements at once from another backend, one
+  ///        (the default) steals a single element
+  ///
+  /// One of the stolen elements is returned, the others are moved to the
+  /// local backend of the thief, which is registered if needed. Backends
+  /// estimating their size (`size_approx`) give up half of their elements
+  /// at most, the other ones give up 2 elements at most whatever `max`. The
+  /// elements are detached with `get_bulk`, in one operation on backends
+  /// such as `MSQueue`.
+  ///
+  /// Not thread-safe, to be called before the structure is shared.
+  void set_steal_batch(size_t max) noexcept;
+
+  /// \brief Put an element into the backend bound to the calling thread,
+  ///        binding one on the first call of the thread
+  template <typename U>
+  bool put(U&& element);
+
+  bool get(Element* element);
+
+  template <typename InputIt>
+  size_t put_bulk(InputIt first, InputIt last);
+
+  size_t get_bulk(Element* elements, size_t max);
 
-  void remove_backend(size_t index);
+  /// \brief Deregister the backend bound to the calling thread before it
+  ///        exits, e.g. to reclaim it earlier. Optional.
+  void deregister_thread();
+
+private:
+  // Bucket `k` holds `m_bucket_capacity << k` slots, enough for any number
+  // of threads
+  static constexpr size_t MAX_BUCKETS = 32;
+
+  const size_t m_bucket_capacity;
+  std::atomic<Slot*> m_buckets[MAX_BUCKETS];
+  // Number of slots ever claimed, scans stop there
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_length;
+  // Bumped whenever a backend is registered or removed
+  std::atomic<size_t> m_version;
+  size_t m_steal_batch;
+
+  NI_PADDING_AFTER(sizeof(m_length) + sizeof(m_version) +
+                   sizeof(m_steal_batch));
+
+  const ThreadBindings::Key m_binding;
+  // One leaf per CPU, a backend arrives at the one of its owner
+  SNZI m_nonempty;
+
+  Slot& slot(size_t index) noexcept;
+  Slot& claim_slot(size_t index);
+  void register_thread(BackendPtr& local_backend);
+  bool remove_backend(size_t index, Node* node);
+  bool steal_batch(Backend* victim, Node* local, Element* element);
+  void mark_nonempty(Node* node);
+  void clear_nonempty(Node* node);
+  BackendPtr bound_backend() noexcept;
+  Node* bind_thread();
+  static void unbind_thread(void* registry, void* node);
 };
 
-template <typename T>
-LLDynamicDistributed<T>::Node::Node()
-  : TaggedPtr<Backend>(new Backend(), 1)
+template <typename T, typename VictimPolicy>
+LLDynamicDistributed<T, VictimPolicy>::Node::Node(size_t leaves)
+  : m_backend(new Backend())
+  , m_alive(true)
+  , m_locality(Locality::current())
+  , m_indicated(false)
+  , m_leaf(m_locality.cpu >= 0 ? m_locality.cpu % leaves : 0)
+{
+}
+
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::Backend*
+LLDynamicDistributed<T, VictimPolicy>::Node::backend() noexcept
 {
+  return m_backend.get();
 }
 
-template <typename T>
-LLDynamicDistributed<T>::Node::~Node()
+template <typename T, typename VictimPolicy>
+bool LLDynamicDistributed<T, VictimPolicy>::Node::alive() noexcept
 {
-  delete backend();
+  return m_alive.load(std::memory_order_acquire);
 }
 
-template <typename T>
-typename LLDynamicDistributed<T>::Backend*
-LLDynamicDistributed<T>::Node::backend() noexcept
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::Node::turn_off() noexcept
 {
-  return this->value();
+  m_alive.store(false, std::memory_order_release);
 }
 
-template <typename T>
-bool LLDynamicDistributed<T>::Node::alive() noexcept
+template <typename T, typename VictimPolicy>
+const Locality&
+LLDynamicDistributed<T, VictimPolicy>::Node::locality() const
+  noexcept
 {
-  return this->tag() == 1;
+  return m_locality;
 }
 
-template <typename T>
-void LLDynamicDistributed<T>::Node::turn_off() noexcept
+template <typename T, typename VictimPolicy>
+std::atomic<bool>&
+LLDynamicDistributed<T, VictimPolicy>::Node::indicated() noexcept
 {
-  this->clear_tag();
+  return m_indicated;
 }
 
-template <typename T>
-LLDynamicDistributed<T>::BackendPtr::BackendPtr() noexcept : m_ptr()
+template <typename T, typename VictimPolicy>
+size_t LLDynamicDistributed<T, VictimPolicy>::Node::leaf() const
+  noexcept
 {
+  return m_leaf;
 }
 
-template <typename T>
-typename LLDynamicDistributed<T>::Node*
-LLDynamicDistributed<T>::BackendPtr::get() noexcept
+template <typename T, typename VictimPolicy>
+LLDynamicDistributed<T, VictimPolicy>::Victims::Victims(
+  LLDynamicDistributed* registry, size_t length, Node* local)
+  : m_registry(registry)
+  , m_length(length)
+  , m_local(local)
+  , m_guard()
+{
+}
+
+template <typename T, typename VictimPolicy>
+size_t LLDynamicDistributed<T, VictimPolicy>::Victims::size() const
+  noexcept
+{
+  return m_length;
+}
+
+template <typename T, typename VictimPolicy>
+size_t LLDynamicDistributed<T, VictimPolicy>::Victims::size_approx(
+  size_t index) const noexcept
+{
+  Node* node = m_guard.protect(m_registry->slot(index));
+  if (!node)
+    return 0;
+  // Only instantiated by the policies comparing sizes, which are meaningless
+  // for backends without an estimation
+  return node->backend()->size_approx();
+}
+
+template <typename T, typename VictimPolicy>
+Locality LLDynamicDistributed<T, VictimPolicy>::Victims::locality(
+  size_t index) const noexcept
+{
+  Node* node = m_guard.protect(m_registry->slot(index));
+  if (!node)
+    return Locality{-1, -1};
+  return node->locality();
+}
+
+template <typename T, typename VictimPolicy>
+bool LLDynamicDistributed<T, VictimPolicy>::Victims::local(
+  size_t index) const noexcept
+{
+  return m_registry->slot(index).load(std::memory_order_relaxed) == m_local;
+}
+
+template <typename T, typename VictimPolicy>
+LLDynamicDistributed<T, VictimPolicy>::BackendPtr::BackendPtr()
+  noexcept
+  : m_ptr()
+{
+}
+
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::Node*
+LLDynamicDistributed<T, VictimPolicy>::BackendPtr::get() noexcept
 {
   return m_ptr;
 }
 
-template <typename T>
-typename LLDynamicDistributed<T>::Node* LLDynamicDistributed<T>::BackendPtr::
-operator->() noexcept
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::Node*
+  LLDynamicDistributed<T, VictimPolicy>::BackendPtr::operator->()
+  noexcept
 {
   return get();
 }
 
-template <typename T>
-void LLDynamicDistributed<T>::BackendPtr::operator=(Node* ptr) noexcept
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::BackendPtr::operator=(
+  Node* ptr) noexcept
 {
   m_ptr = ptr;
 }
-template <typename T>
-LLDynamicDistributed<T>::BackendPtr::operator bool() const noexcept
+template <typename T, typename VictimPolicy>
+LLDynamicDistributed<T, VictimPolicy>::BackendPtr::operator bool()
+  const noexcept
 {
   return m_ptr != nullptr;
 }
 
-template <typename T>
-LLDynamicDistributed<T>::LLDynamicDistributed(size_t segment_capacity)
-  : m_segment()
-  , m_segment_capacity(segment_capacity)
-  , m_segment_length()
+template <typename T, typename VictimPolicy>
+LLDynamicDistributed<T, VictimPolicy>::LLDynamicDistributed(
+  size_t segment_capacity)
+  : m_bucket_capacity(segment_capacity > 1
+                        ? size_t(1) << (64 - __builtin_clzll(
+                                          segment_capacity - 1))
+                        : 1)
+  , m_buckets()
+  , m_length()
   , m_version()
-  , m_lock()
+  , m_steal_batch(1)
+  , m_binding(ThreadBindings::create_key())
+  , m_nonempty(std::thread::hardware_concurrency())
 {
-  int rc = posix_memalign(reinterpret_cast<void**>(&m_segment), 64,
-                          sizeof(Node*) * segment_capacity);
-  if (rc)
-    throw std::system_error(rc, std::system_category(), __func__);
-
-  new (m_segment) Node* [segment_capacity]
-  {
-  };
 }
 
-template <typename T>
-LLDynamicDistributed<T>::~LLDynamicDistributed()
+template <typename T, typename VictimPolicy>
+LLDynamicDistributed<T, VictimPolicy>::~LLDynamicDistributed()
 {
-  while (m_segment_length > 0)
-  {
-    --m_segment_length;
-    Node* node = m_segment[m_segment_length];
-    assert(node);
-    delete node;
-  }
-  delete m_segment;
+  // Exiting threads won't deregister their backends anymore
+  ThreadBindings::delete_key(m_binding);
+
+  size_t length = m_length.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < length; ++i)
+    delete slot(i).load(std::memory_order_relaxed);
+  for (auto& bucket : m_buckets)
+    delete[] bucket.load(std::memory_order_relaxed);
 }
 
-template <typename T>
+template <typename T, typename VictimPolicy>
 template <typename U>
-bool LLDynamicDistributed<T>::put(BackendPtr& local_backend, U&& element)
+bool LLDynamicDistributed<T, VictimPolicy>::put(
+  BackendPtr& local_backend, U&& element)
 {
   if (!local_backend)
-  {
-    std::lock_guard<SpinLock> lock(m_lock);
-    if (m_segment_length >= m_segment_capacity)
-    {
-      for (size_t i = 0; i < m_segment_length; ++i)
-      {
-        if (m_segment[i]->alive() == 0 && m_segment[i]->backend()->empty())
-          remove_backend(i);
-      }
-    }
-    if (m_segment_length >= m_segment_capacity)
-      return false;
-
-    local_backend = m_segment[m_segment_length++] = new Node();
-    ++m_version;
-  }
-  return local_backend->backend()->put(std::forward<U>(element));
+    register_thread(local_backend);
+  if (!local_backend->backend()->put(std::forward<U>(element)))
+    return false;
+  mark_nonempty(local_backend.get());
+  return true;
 }
 
-template <typename T>
-bool LLDynamicDistributed<T>::get(BackendPtr& local_backend, Element* element)
+template <typename T, typename VictimPolicy>
+bool LLDynamicDistributed<T, VictimPolicy>::get(
+  BackendPtr& local_backend, Element* element)
 {
   if (local_backend && local_backend->backend()->get(element))
     return true;
+  if (!m_nonempty.query())
+    return false;
+  // Batches are moved to the local backend
+  if (!local_backend && m_steal_batch > 1)
+    register_thread(local_backend);
 
-  pcg32 rng;
-  std::uniform_int_distribution<uint64_t>
-    uniform_dist(0, std::numeric_limits<uint64_t>::max());
+  pcg32& rng = thread_rng();
+  // Scratch space for the tail states, grown to the largest segment seen
+  static thread_local std::vector<typename Backend::State> tails_states;
 
+  HazardPointers::Guard guard;
   size_t version;
 
 RETRY:
-  while (m_segment_length)
+  while (size_t length = m_length.load(std::memory_order_acquire))
   {
-    size_t start = uniform_dist(rng) % m_segment_length;
-    version = m_version;
+    version = m_version.load(std::memory_order_acquire);
+    if (tails_states.size() < length)
+      tails_states.resize(length);
 
-    typename Backend::State tails_states[m_segment_length];
+    size_t start = VictimPolicy::select(
+      Victims(this, length, local_backend.get()), rng);
 
-    for (size_t i = 0; i < m_segment_length; ++i)
+    for (size_t i = 0; i < length; ++i)
     {
-      size_t index = (start + i) % m_segment_length;
-      Node* node = m_segment[index];
+      size_t index = (start + i) % length;
+      Node* node = guard.protect(slot(index));
+      if (!node)
+        continue;
       Backend* backend = node->backend();
       if (!backend)
         continue;
-      if (backend->pop(element, &tails_states[i]))
+      if (m_steal_batch > 1 && node != local_backend.get())
+      {
+        // The state has to predate the emptiness it validates
+        tails_states[i] = backend->tail_state();
+        if (steal_batch(backend, local_backend.get(), element))
+          return true;
+      }
+      else if (backend->pop(element, &tails_states[i]))
+      {
         return true;
+      }
+      clear_nonempty(node);
       if (!node->alive())
       {
-        remove_backend(index);
+        remove_backend(index, node);
         goto RETRY;
       }
     }
 
-    if (m_version != version)
+    if (m_version.load(std::memory_order_acquire) != version)
       continue;
 
-    for (size_t i = 0; i < m_segment_length; ++i)
+    for (size_t i = 0; i < length; ++i)
     {
-      size_t index = (start + i) % m_segment_length;
-      Backend* backend = m_segment[index]->backend();
+      size_t index = (start + i) % length;
+      Node* node = guard.protect(slot(index));
+      if (!node)
+        continue;
+      Backend* backend = node->backend();
       if (!backend)
         continue;
       if (backend->tail_state() != tails_states[i])
@@ -265,41 +489,318 @@ RETRY:
   return false;
 }
 
-template <typename T>
-void LLDynamicDistributed<T>::deregister_thread(BackendPtr& local_backend)
+template <typename T, typename VictimPolicy>
+template <typename InputIt>
+size_t LLDynamicDistributed<T, VictimPolicy>::put_bulk(
+  BackendPtr& local_backend, InputIt first, InputIt last)
+{
+  if (!local_backend)
+    register_thread(local_backend);
+  size_t count = local_backend->backend()->put_bulk(first, last);
+  if (count)
+    mark_nonempty(local_backend.get());
+  return count;
+}
+
+template <typename T, typename VictimPolicy>
+size_t LLDynamicDistributed<T, VictimPolicy>::get_bulk(
+  BackendPtr& local_backend, Element* elements, size_t max)
+{
+  if (max == 0)
+    return 0;
+
+  if (local_backend)
+  {
+    size_t count = local_backend->backend()->get_bulk(elements, max);
+    if (count)
+      return count;
+  }
+  return get(local_backend, elements) ? 1 : 0;
+}
+
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::deregister_thread(
+  BackendPtr& local_backend)
 {
   if (!local_backend)
     return;
 
+  // Once turned off the backend may be removed by any thread
+  HazardPointers::Guard guard;
   Node* node = local_backend.get();
+  guard.set(node);
   local_backend = nullptr;
   node->turn_off();
   if (!node->backend()->empty())
     return;
 
-  for (size_t i = 0; i < m_segment_length; ++i)
+  size_t length = m_length.load(std::memory_order_acquire);
+  for (size_t i = 0; i < length; ++i)
   {
-    if (m_segment[i] == node)
+    if (slot(i).load(std::memory_order_relaxed) == node)
     {
-      std::lock_guard<SpinLock> lock(m_lock);
-      remove_backend(i);
+      remove_backend(i, node);
       break;
     }
   }
 }
 
-template <typename T>
-void LLDynamicDistributed<T>::remove_backend(size_t index)
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::set_steal_batch(
+  size_t max) noexcept
+{
+  assert(max > 0);
+  m_steal_batch = max;
+}
+
+template <typename T, typename VictimPolicy>
+template <typename U>
+bool LLDynamicDistributed<T, VictimPolicy>::put(U&& element)
+{
+  Node* node = static_cast<Node*>(ThreadBindings::get(m_binding));
+  if (NI_UNLIKELY(!node))
+    node = bind_thread();
+  if (!node->backend()->put(std::forward<U>(element)))
+    return false;
+  mark_nonempty(node);
+  return true;
+}
+
+template <typename T, typename VictimPolicy>
+bool LLDynamicDistributed<T, VictimPolicy>::get(Element* element)
+{
+  BackendPtr local_backend = bound_backend();
+  if (!local_backend && m_steal_batch > 1)
+    local_backend = bind_thread();
+  return get(local_backend, element);
+}
+
+template <typename T, typename VictimPolicy>
+template <typename InputIt>
+size_t LLDynamicDistributed<T, VictimPolicy>::put_bulk(InputIt first,
+                                                                  InputIt last)
+{
+  Node* node = static_cast<Node*>(ThreadBindings::get(m_binding));
+  if (NI_UNLIKELY(!node))
+    node = bind_thread();
+  size_t count = node->backend()->put_bulk(first, last);
+  if (count)
+    mark_nonempty(node);
+  return count;
+}
+
+template <typename T, typename VictimPolicy>
+size_t LLDynamicDistributed<T, VictimPolicy>::get_bulk(
+  Element* elements, size_t max)
+{
+  BackendPtr local_backend = bound_backend();
+  return get_bulk(local_backend, elements, max);
+}
+
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::deregister_thread()
+{
+  BackendPtr local_backend = bound_backend();
+  ThreadBindings::reset(m_binding);
+  deregister_thread(local_backend);
+}
+
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::Slot&
+LLDynamicDistributed<T, VictimPolicy>::slot(size_t index) noexcept
+{
+  size_t k = 63 - __builtin_clzll(index / m_bucket_capacity + 1);
+  Slot* bucket = m_buckets[k].load(std::memory_order_acquire);
+  assert(bucket);
+  return bucket[index - m_bucket_capacity * ((size_t(1) << k) - 1)];
+}
+
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::Slot&
+LLDynamicDistributed<T, VictimPolicy>::claim_slot(size_t index)
+{
+  size_t k = 63 - __builtin_clzll(index / m_bucket_capacity + 1);
+  if (k >= MAX_BUCKETS)
+    throw std::length_error("LLDynamicDistributed: too many backends");
+
+  Slot* bucket = m_buckets[k].load(std::memory_order_acquire);
+  if (!bucket)
+  {
+    // Racing threads allocate a bucket each, the first one published wins
+    Slot* fresh = new Slot[m_bucket_capacity << k]();
+    if (m_buckets[k].compare_exchange_strong(bucket, fresh,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_acquire))
+      bucket = fresh;
+    else
+      delete[] fresh;
+  }
+  return bucket[index - m_bucket_capacity * ((size_t(1) << k) - 1)];
+}
+
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::register_thread(
+  BackendPtr& local_backend)
 {
-  Node* node = m_segment[index];
-  if (!node || node->alive() || !node->backend()->empty())
+  Node* node = new Node(m_nonempty.leaves());
+  HazardPointers::Guard guard;
+
+  while (true)
+  {
+    // Reuse the slot of a removed backend, removing the dead ones on the way
+    size_t length = m_length.load(std::memory_order_acquire);
+    for (size_t i = 0; i < length; ++i)
+    {
+      Node* other = guard.protect(slot(i));
+      if (other && !remove_backend(i, other))
+        continue;
+      Node* expected = nullptr;
+      if (slot(i).compare_exchange_strong(expected, node,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed))
+      {
+        local_backend = node;
+        m_version.fetch_add(1, std::memory_order_release);
+        return;
+      }
+    }
+
+    // Append a slot. Whoever claims it, the length is moved past it so the
+    // next attempt tries the following one.
+    Node* expected = nullptr;
+    bool claimed = claim_slot(length).compare_exchange_strong(
+      expected, node, std::memory_order_release, std::memory_order_relaxed);
+    m_length.compare_exchange_strong(length, length + 1,
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_relaxed);
+    if (claimed)
+    {
+      local_backend = node;
+      m_version.fetch_add(1, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+template <typename T, typename VictimPolicy>
+bool LLDynamicDistributed<T, VictimPolicy>::steal_batch(
+  Backend* victim, Node* local, Element* element)
+{
+  static thread_local std::vector<Element> stolen;
+
+  size_t max = details::backend_steal_count(*victim, m_steal_batch, 0);
+  if (stolen.size() < max)
+    stolen.resize(max);
+  size_t count = victim->get_bulk(stolen.data(), max);
+  if (!count)
+    return false;
+
+  *element = std::move(stolen[0]);
+  // Default constructed backends are unbounded, they take the whole batch
+  if (count > 1)
+  {
+    local->backend()->put_bulk(std::make_move_iterator(stolen.begin() + 1),
+                               std::make_move_iterator(stolen.begin() + count));
+    mark_nonempty(local);
+  }
+  return true;
+}
+
+// Arrives at the indicator unless the backend is already indicated. Called
+// after putting, the fence orders the put before the check so either a
+// concurrent `clear_nonempty` sees the element or this sees its clearing.
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::mark_nonempty(
+  Node* node)
+{
+  std::atomic<bool>& indicated = node->indicated();
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (indicated.load(std::memory_order_relaxed))
     return;
 
-  delete node;
-  --m_segment_length;
-  m_segment[index] = m_segment[m_segment_length];
-  m_segment[m_segment_length] = nullptr;
-  ++m_version;
+  // Arrive first, a set flag can be cleared and departed from at any time
+  m_nonempty.arrive(node->leaf());
+  bool expected = false;
+  if (!indicated.compare_exchange_strong(expected, true))
+    m_nonempty.depart(node->leaf());
+}
+
+// Departs from the indicator if the backend is indicated but found empty,
+// `node` is protected by the caller
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::clear_nonempty(
+  Node* node)
+{
+  std::atomic<bool>& indicated = node->indicated();
+  Backend* backend = node->backend();
+  while (true)
+  {
+    bool expected = true;
+    if (!indicated.load(std::memory_order_relaxed) ||
+        !indicated.compare_exchange_strong(expected, false))
+      return;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (backend->empty())
+      break;
+
+    // Still non-empty, keep the arrival unless it has been replaced
+    expected = false;
+    if (!indicated.compare_exchange_strong(expected, true))
+      break;
+    // Dead backends are never put into again: one emptied meanwhile would
+    // otherwise stay indicated after its removal
+    if (node->alive() || !backend->empty())
+      return;
+  }
+  m_nonempty.depart(node->leaf());
+}
+
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::BackendPtr
+LLDynamicDistributed<T, VictimPolicy>::bound_backend() noexcept
+{
+  BackendPtr local_backend;
+  local_backend = static_cast<Node*>(ThreadBindings::get(m_binding));
+  return local_backend;
+}
+
+template <typename T, typename VictimPolicy>
+typename LLDynamicDistributed<T, VictimPolicy>::Node*
+LLDynamicDistributed<T, VictimPolicy>::bind_thread()
+{
+  BackendPtr local_backend;
+  register_thread(local_backend);
+  ThreadBindings::set(m_binding, local_backend.get(), &unbind_thread, this);
+  return local_backend.get();
+}
+
+template <typename T, typename VictimPolicy>
+void LLDynamicDistributed<T, VictimPolicy>::unbind_thread(
+  void* registry, void* node)
+{
+  BackendPtr local_backend;
+  local_backend = static_cast<Node*>(node);
+  static_cast<LLDynamicDistributed*>(registry)->deregister_thread(
+    local_backend);
+}
+
+// `node` is the backend in slot `index`, protected by the caller
+template <typename T, typename VictimPolicy>
+bool LLDynamicDistributed<T, VictimPolicy>::remove_backend(
+  size_t index, Node* node)
+{
+  if (node->alive() || !node->backend()->empty())
+    return false;
+  if (!slot(index).compare_exchange_strong(node, nullptr,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed))
+    return false;
+
+  m_version.fetch_add(1, std::memory_order_release);
+  if (node->indicated().exchange(false))
+    m_nonempty.depart(node->leaf());
+  HazardPointers::retire(node);
+  return true;
 }
 
 } // namespace ni
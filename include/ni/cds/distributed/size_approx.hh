@@ -0,0 +1,63 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <cstddef>
+
+namespace ni
+{
+namespace details
+{
+// Estimation of the number of elements of a backend of the distributed
+// containers, call with 0 as second argument
+template <typename Backend>
+auto backend_size_approx(Backend& backend, int)
+  -> decltype(backend.size_approx())
+{
+  return backend.size_approx();
+}
+
+// Backends without an estimation are either empty or not
+template <typename Backend>
+size_t backend_size_approx(Backend& backend, long)
+{
+  return backend.empty() ? 0 : 1;
+}
+
+// Number of elements to steal at once from a backend, half of them up to
+// `max` if it can estimate its size, at most 2 otherwise. Call with 0 as last
+// argument.
+template <typename Backend>
+auto backend_steal_count(Backend& backend, size_t max, int)
+  -> decltype(backend.size_approx(), size_t())
+{
+  size_t half = (backend.size_approx() + 1) / 2;
+  return std::max<size_t>(1, std::min(half, max));
+}
+
+template <typename Backend>
+size_t backend_steal_count(Backend& backend, size_t max, long)
+{
+  // Taking `max` could drain a backend holding a few elements only
+  return std::min<size_t>(max, 2);
+}
+
+} // namespace details
+} // namespace ni
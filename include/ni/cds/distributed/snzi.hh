@@ -0,0 +1,240 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <ni/cache_locality.hh>
+
+namespace ni
+{
+/// \brief Scalable non-zero indicator
+///
+/// Counts arrivals minus departures without a shared counter: threads arrive
+/// and depart at the leaves of a binary tree and a node only propagates to
+/// its parent when its own surplus moves between zero and non-zero. `query`
+/// reads a single flag which is written on the transitions of the whole
+/// tree only, so polling it from any number of threads stays in cache while
+/// the surplus stays non-zero (or zero).
+///
+/// A thread may only depart from the leaf it arrived at, and not more times
+/// than it arrived.
+///
+/// **Reference**
+///
+/// * F. Ellen, Y. Lev, V. Luchangco, and M. Moir. SNZI: Scalable NonZero
+///   Indicators. PODC '07.
+class SNZI
+{
+public:
+  /// \param leaves number of leaves, rounded up to a power of two
+  explicit SNZI(size_t leaves);
+  SNZI(const SNZI&) = delete;
+  SNZI& operator=(const SNZI&) = delete;
+
+  /// \return number of leaves
+  size_t leaves() const noexcept;
+
+  void arrive(size_t leaf) noexcept;
+  void depart(size_t leaf) noexcept;
+
+  /// \return whether there are more arrivals than departures
+  bool query() const noexcept;
+
+private:
+  // Hierarchical nodes hold twice their surplus in the low half, one stands
+  // for the intermediate state of the first arrival, and a version in the
+  // high half. The root holds its surplus, an announce bit and a version.
+  struct NI_CACHELINE_ALIGNED Cell
+  {
+    std::atomic<uint64_t> word;
+  };
+
+  static constexpr uint64_t HALF = 1;
+  static constexpr uint64_t ONE = 2;
+  static constexpr uint64_t COUNT_MASK = 0xffffffff;
+  static constexpr uint64_t ANNOUNCE = uint64_t(1) << 32;
+  static constexpr uint64_t ROOT_VERSION = uint64_t(1) << 33;
+  static constexpr uint64_t VERSION = uint64_t(1) << 32;
+
+  const size_t m_leaves;
+  // Heap layout, the root first and the leaves last
+  std::unique_ptr<Cell[]> m_cells;
+  // The indicator itself in bit 0, and a version bumped on every write to
+  // emulate LL/SC
+  NI_CACHELINE_ALIGNED std::atomic<uint64_t> m_indicator;
+
+  NI_PADDING_AFTER(sizeof(m_indicator));
+
+  void arrive_node(size_t index) noexcept;
+  void depart_node(size_t index) noexcept;
+  void arrive_root() noexcept;
+  void depart_root() noexcept;
+};
+
+inline SNZI::SNZI(size_t leaves)
+  : m_leaves(leaves > 1 ? size_t(1) << (64 - __builtin_clzll(leaves - 1)) : 1)
+  , m_cells(new Cell[2 * m_leaves - 1]())
+  , m_indicator()
+{
+}
+
+inline size_t SNZI::leaves() const noexcept
+{
+  return m_leaves;
+}
+
+inline void SNZI::arrive(size_t leaf) noexcept
+{
+  assert(leaf < m_leaves);
+  arrive_node(m_leaves - 1 + leaf);
+}
+
+inline void SNZI::depart(size_t leaf) noexcept
+{
+  assert(leaf < m_leaves);
+  depart_node(m_leaves - 1 + leaf);
+}
+
+inline bool SNZI::query() const noexcept
+{
+  return m_indicator.load(std::memory_order_acquire) & 1;
+}
+
+inline void SNZI::arrive_node(size_t index) noexcept
+{
+  if (index == 0)
+    return arrive_root();
+
+  std::atomic<uint64_t>& word = m_cells[index].word;
+  size_t parent = (index - 1) / 2;
+  size_t undo = 0;
+  bool done = false;
+  while (!done)
+  {
+    uint64_t x = word.load(std::memory_order_acquire);
+    uint64_t count = x & COUNT_MASK;
+    if (count >= ONE &&
+        word.compare_exchange_strong(x, x + ONE, std::memory_order_acq_rel,
+                                     std::memory_order_relaxed))
+      done = true;
+    if (count == 0)
+    {
+      // First arrival, it completes once the parent has been arrived at
+      uint64_t half = (x & ~COUNT_MASK) + VERSION + HALF;
+      if (word.compare_exchange_strong(x, half, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed))
+      {
+        done = true;
+        x = half;
+        count = HALF;
+      }
+    }
+    if (count == HALF)
+    {
+      // Helpers complete the first arrival too, all but one of them undo
+      // their arrival at the parent
+      arrive_node(parent);
+      if (!word.compare_exchange_strong(x, x - HALF + ONE,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_relaxed))
+        ++undo;
+    }
+  }
+  for (; undo; --undo)
+    depart_node(parent);
+}
+
+inline void SNZI::depart_node(size_t index) noexcept
+{
+  if (index == 0)
+    return depart_root();
+
+  std::atomic<uint64_t>& word = m_cells[index].word;
+  uint64_t x = word.load(std::memory_order_acquire);
+  do
+  {
+    assert((x & COUNT_MASK) >= ONE);
+  } while (!word.compare_exchange_weak(x, x - ONE, std::memory_order_acq_rel,
+                                       std::memory_order_acquire));
+  if ((x & COUNT_MASK) == ONE)
+    depart_node((index - 1) / 2);
+}
+
+inline void SNZI::arrive_root() noexcept
+{
+  std::atomic<uint64_t>& word = m_cells[0].word;
+  uint64_t x = word.load(std::memory_order_acquire);
+  uint64_t next;
+  do
+  {
+    if ((x & COUNT_MASK) == 0)
+      next = (x & ~(COUNT_MASK | ANNOUNCE)) + ROOT_VERSION + ANNOUNCE + 1;
+    else
+      next = x + 1;
+  } while (!word.compare_exchange_weak(x, next, std::memory_order_acq_rel,
+                                       std::memory_order_acquire));
+
+  if (next & ANNOUNCE)
+  {
+    uint64_t i = m_indicator.load(std::memory_order_relaxed);
+    while (!m_indicator.compare_exchange_weak(
+      i, (i + 2) | 1, std::memory_order_acq_rel,
+      std::memory_order_relaxed))
+      ;
+    word.compare_exchange_strong(next, next & ~ANNOUNCE,
+                                 std::memory_order_acq_rel,
+                                 std::memory_order_relaxed);
+  }
+}
+
+inline void SNZI::depart_root() noexcept
+{
+  std::atomic<uint64_t>& word = m_cells[0].word;
+  uint64_t x = word.load(std::memory_order_acquire);
+  do
+  {
+    assert((x & COUNT_MASK) >= 1);
+  } while (!word.compare_exchange_weak(x, (x & ~ANNOUNCE) - 1,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire));
+  if ((x & COUNT_MASK) > 1)
+    return;
+
+  // Last departure, clear the indicator unless the root has been arrived at
+  // again since: its version has changed then
+  uint64_t version = x & ~(COUNT_MASK | ANNOUNCE);
+  uint64_t i = m_indicator.load(std::memory_order_acquire);
+  while (true)
+  {
+    uint64_t current = word.load(std::memory_order_acquire);
+    if ((current & ~(COUNT_MASK | ANNOUNCE)) != version)
+      return;
+    if (m_indicator.compare_exchange_weak(i, (i & ~uint64_t(1)) + 2,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire))
+      return;
+  }
+}
+
+} // namespace ni
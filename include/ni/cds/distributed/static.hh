@@ -18,13 +18,36 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <cassert>
 #include <memory>
+#include <utility>
+#include <vector>
+
+#include <ni/cds/distributed/balancer.hh>
+#include <ni/cds/distributed/size_approx.hh>
 
 namespace ni
 {
 
-/// \brief Common interface for distributed data structures
-template <typename T, typename B>
+/// \brief Distributed queue over a fixed number of partial queues
+///
+/// Elements are spread over the partial queues created at construction, none
+/// of them is owned by a thread. The balancer picks the partial queue each
+/// `put` goes to and the one each `get` tries first, `get` then tries the
+/// others in turn. The order of the elements is only preserved within a
+/// partial queue.
+///
+/// **Reference**
+///
+/// * A. Haas, M. Lippautz, T.A. Henzinger, H. Payer, A. Sokolova,
+///   C.M. Kirsch, and A. Sezgin. Distributed Queues in Shared Memory:
+///   Multicore Performance and Scalability through Quantitative Relaxation.
+///   CF '13.
+///
+/// \param T type of the partial queues, `MSQueue` or any other `Queue`
+/// \param B balancer, see `RoundRobinBalancer`, `AffinityBalancer`,
+///        `RandomBalancer` and `DRandomBalancer`
+template <typename T, typename B = RandomBalancer>
 class DistributedInterface
 {
 public:
@@ -33,31 +56,115 @@ public:
   using Balancer = B;
   using BalancerPtr = std::unique_ptr<Balancer>;
 
-  DistributedInterface(BalancerPtr&& balancer);
+  /// \brief Create `partials` default constructed partial queues
+  explicit DistributedInterface(size_t partials);
+
+  /// \param partials number of partial queues, greater than 0
+  /// \param balancer balancer of the operations
+  /// \param args arguments of the constructor of every partial queue
+  template <typename... Args>
+  DistributedInterface(size_t partials, BalancerPtr&& balancer,
+                       Args&&... args);
+
+  DistributedInterface(const DistributedInterface&) = delete;
+  DistributedInterface& operator=(const DistributedInterface&) = delete;
 
+  /// \return number of partial queues
+  size_t partials() const noexcept;
+
+  /// \return false if the chosen partial queue rejected the element (e.g. it
+  ///         is bounded and full)
   template <typename U>
-  void put(U&& element);
-  void get(Element* element);
+  bool put(U&& element);
+
+  /// \return false if every partial queue was found empty while scanning
+  ///         them
+  bool get(Element* element);
 
 private:
+  // Partial queues as seen by the balancer
+  class Partials
+  {
+  public:
+    explicit Partials(const std::vector<std::unique_ptr<Backend>>& backends);
+
+    size_t size() const noexcept;
+    size_t size_approx(size_t index) const noexcept;
+
+  private:
+    const std::vector<std::unique_ptr<Backend>>& m_backends;
+  };
+
+  std::vector<std::unique_ptr<Backend>> m_backends;
   BalancerPtr m_balancer;
 };
 
 template <typename T, typename B>
-DistributedInterface<T, B>::DistributedInterface(BalancerPtr&& balancer)
-  : m_balancer(std::move(balancer))
+DistributedInterface<T, B>::Partials::Partials(
+  const std::vector<std::unique_ptr<Backend>>& backends)
+  : m_backends(backends)
+{
+}
+
+template <typename T, typename B>
+size_t DistributedInterface<T, B>::Partials::size() const noexcept
+{
+  return m_backends.size();
+}
+
+template <typename T, typename B>
+size_t DistributedInterface<T, B>::Partials::size_approx(size_t index) const
+  noexcept
+{
+  return details::backend_size_approx(*m_backends[index], 0);
+}
+
+template <typename T, typename B>
+DistributedInterface<T, B>::DistributedInterface(size_t partials)
+  : DistributedInterface(partials, BalancerPtr(new Balancer()))
+{
+}
+
+template <typename T, typename B>
+template <typename... Args>
+DistributedInterface<T, B>::DistributedInterface(size_t partials,
+                                                 BalancerPtr&& balancer,
+                                                 Args&&... args)
+  : m_backends()
+  , m_balancer(std::move(balancer))
+{
+  assert(partials > 0 && "at least one partial queue is needed");
+
+  m_backends.reserve(partials);
+  for (size_t i = 0; i < partials; ++i)
+    m_backends.emplace_back(new Backend(args...));
+}
+
+template <typename T, typename B>
+size_t DistributedInterface<T, B>::partials() const noexcept
 {
+  return m_backends.size();
 }
 
 template <typename T, typename B>
 template <typename U>
-void DistributedInterface<T, B>::put(U&& element)
+bool DistributedInterface<T, B>::put(U&& element)
 {
+  size_t index = m_balancer->put_index(Partials(m_backends));
+  return m_backends[index]->put(std::forward<U>(element));
 }
 
 template <typename T, typename B>
-void DistributedInterface<T, B>::get(Element* element)
+bool DistributedInterface<T, B>::get(Element* element)
 {
+  const size_t length = m_backends.size();
+  size_t start = m_balancer->get_index(Partials(m_backends));
+  for (size_t i = 0; i < length; ++i)
+  {
+    if (m_backends[(start + i) % length]->get(element))
+      return true;
+  }
+  return false;
 }
 
 } // namespace ni
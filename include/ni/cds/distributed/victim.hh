@@ -0,0 +1,167 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <ni/random.hh>
+
+namespace ni
+{
+/// \brief CPU and NUMA node a thread runs on
+struct Locality
+{
+  int cpu;
+  int node;
+
+  /// \return locality of the calling thread, members are -1 if unknown
+  ///
+  /// The CPU is read through the vDSO, the node is cached per thread and
+  /// only looked up again when the thread has moved to another CPU.
+  static Locality current() noexcept;
+
+  /// \return 0 on the same CPU, 1 on the same NUMA node, 2 otherwise
+  unsigned distance(const Locality& other) const noexcept;
+};
+
+inline Locality Locality::current() noexcept
+{
+  static thread_local Locality t_cached{-1, -1};
+
+  int cpu = sched_getcpu();
+  if (cpu < 0)
+    return Locality{-1, -1};
+  if (cpu != t_cached.cpu)
+  {
+    unsigned new_cpu;
+    unsigned node;
+    if (syscall(SYS_getcpu, &new_cpu, &node, nullptr) != 0)
+      return Locality{cpu, -1};
+    t_cached = Locality{static_cast<int>(new_cpu), static_cast<int>(node)};
+  }
+  return t_cached;
+}
+
+inline unsigned Locality::distance(const Locality& other) const noexcept
+{
+  if (cpu >= 0 && cpu == other.cpu)
+    return 0;
+  if (node >= 0 && node == other.node)
+    return 1;
+  return 2;
+}
+
+// Victim-selection policies of `LLDynamicDistributed::get`. The policy picks
+// the backend to steal from first, the others are then scanned round-robin
+// from there so an empty structure is still detected.
+//
+// A policy provides
+//
+//   template <typename Victims>
+//   static size_t select(const Victims& victims, pcg32& rng);
+//
+// where `victims` describes the registered backends:
+//
+// * `size()`: number of backends
+// * `size_approx(i)`: estimation of the number of elements of backend `i`,
+//   only available if the backends provide `size_approx()`
+// * `locality(i)`: where the owner of backend `i` registered it
+// * `local(i)`: whether backend `i` is the one of the calling thread
+
+/// \brief Start from a backend chosen uniformly at random
+struct RandomVictim
+{
+  template <typename Victims>
+  static size_t select(const Victims& victims, pcg32& rng);
+};
+
+/// \brief Start from the larger of two backends chosen at random
+///
+/// Stealing from the fuller backend drains the queues evenly at the cost of
+/// reading two sizes. The backends must provide `size_approx()`.
+///
+/// **Reference**
+///
+/// * M. Mitzenmacher. The Power of Two Choices in Randomized Load Balancing.
+///   IEEE Transactions on Parallel and Distributed Systems, 12(10), 2001.
+struct TwoChoicesVictim
+{
+  template <typename Victims>
+  static size_t select(const Victims& victims, pcg32& rng);
+};
+
+/// \brief Start from the backend registered closest to the calling thread
+///
+/// Backends registered on the same CPU come first, then the ones on the same
+/// NUMA node. Ties are broken at random.
+struct NearestVictim
+{
+  template <typename Victims>
+  static size_t select(const Victims& victims, pcg32& rng);
+};
+
+template <typename Victims>
+size_t RandomVictim::select(const Victims& victims, pcg32& rng)
+{
+  return rng(static_cast<uint32_t>(victims.size()));
+}
+
+template <typename Victims>
+size_t TwoChoicesVictim::select(const Victims& victims, pcg32& rng)
+{
+  uint32_t length = static_cast<uint32_t>(victims.size());
+  size_t first = rng(length);
+  size_t second = rng(length);
+  return victims.size_approx(second) > victims.size_approx(first) ? second
+                                                                    : first;
+}
+
+template <typename Victims>
+size_t NearestVictim::select(const Victims& victims, pcg32& rng)
+{
+  const Locality here = Locality::current();
+  const size_t length = victims.size();
+  const size_t start = rng(static_cast<uint32_t>(length));
+
+  size_t nearest = start;
+  unsigned nearest_distance = std::numeric_limits<unsigned>::max();
+  for (size_t i = 0; i < length; ++i)
+  {
+    size_t index = (start + i) % length;
+    if (victims.local(index))
+      continue;
+    unsigned distance = here.distance(victims.locality(index));
+    if (distance < nearest_distance)
+    {
+      nearest = index;
+      nearest_distance = distance;
+      if (distance == 0)
+        break;
+    }
+  }
+  return nearest;
+}
+
+} // namespace ni
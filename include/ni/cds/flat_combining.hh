@@ -0,0 +1,332 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <ni/cache_locality.hh>
+#include <ni/optional.hh>
+#include <ni/sync/sleep.hh>
+#include <ni/sync/spinlock.hh>
+
+namespace ni
+{
+namespace details
+{
+// Request of a thread, executed by whichever thread is the combiner
+template <typename Seq, typename Fn, typename R>
+struct FlatCombiningCall
+{
+  Fn& fn;
+  optional<R> result;
+  std::exception_ptr error;
+
+  explicit FlatCombiningCall(Fn& f) noexcept
+    : fn(f)
+    , result()
+    , error()
+  {
+  }
+
+  static void invoke(void* self, Seq& seq) noexcept
+  {
+    auto call = static_cast<FlatCombiningCall*>(self);
+    try
+    {
+      call->result.emplace(call->fn(seq));
+    }
+    catch (...)
+    {
+      call->error = std::current_exception();
+    }
+  }
+
+  R take()
+  {
+    if (error)
+      std::rethrow_exception(error);
+    return std::move(*result);
+  }
+};
+
+template <typename Seq, typename Fn>
+struct FlatCombiningCall<Seq, Fn, void>
+{
+  Fn& fn;
+  std::exception_ptr error;
+
+  explicit FlatCombiningCall(Fn& f) noexcept
+    : fn(f)
+    , error()
+  {
+  }
+
+  static void invoke(void* self, Seq& seq) noexcept
+  {
+    auto call = static_cast<FlatCombiningCall*>(self);
+    try
+    {
+      call->fn(seq);
+    }
+    catch (...)
+    {
+      call->error = std::current_exception();
+    }
+  }
+
+  void take()
+  {
+    if (error)
+      std::rethrow_exception(error);
+  }
+};
+
+} // namespace details
+
+/// \brief Flat combining wrapper for a sequential data structure
+///
+/// Every thread publishes its operation in its own cache line aligned
+/// record and then either waits for the operation to be completed or, if the
+/// combiner lock is free, becomes the combiner: it applies the pending
+/// operations of all the threads in a single pass and releases the lock.
+/// Under contention the data structure and the lock stay in the cache of a
+/// single core, which is far cheaper than having every thread acquire the
+/// lock in turn.
+///
+/// Operations are arbitrary callables taking `Seq&`:
+///
+///     FlatCombining<std::priority_queue<int>> heap(max_threads);
+///     FlatCombining<std::priority_queue<int>>::RecordPtr record;
+///     heap.apply(record, [](auto& q) { q.push(42); });
+///     int top = heap.apply(record, [](auto& q) { return q.top(); });
+///     heap.deregister_thread(record);
+///
+/// An exception thrown by an operation is rethrown in the calling thread.
+/// Threads that cannot get a record (more than `max_threads` threads are
+/// registered) acquire the lock and apply their operation directly.
+///
+/// **Reference**
+///
+/// * D. Hendler, I. Incze, N. Shavit, and M. Tzafrir. Flat Combining and the
+///   Synchronization-Parallelism Tradeoff. SPAA '10.
+///
+/// \param Seq type of the sequential data structure
+template <typename Seq>
+class FlatCombining
+{
+  struct Record;
+
+public:
+  /// \brief Maximum number of passes over the records by a combiner, a pass
+  ///        which finds no pending operation ends combining earlier
+  static constexpr size_t COMBINE_PASSES = 3;
+
+  /// \brief Per-thread handle, has to be used by a single thread at a time
+  class RecordPtr
+  {
+  public:
+    RecordPtr() noexcept;
+
+    operator bool() const noexcept;
+
+  private:
+    friend class FlatCombining;
+
+    Record* m_ptr;
+  };
+
+  /// \param max_threads number of threads that can use a record at the same
+  ///        time
+  /// \param args arguments forwarded to the constructor of `Seq`
+  template <typename... Args>
+  explicit FlatCombining(size_t max_threads, Args&&... args);
+  FlatCombining(const FlatCombining&) = delete;
+  FlatCombining& operator=(const FlatCombining&) = delete;
+  ~FlatCombining();
+
+  /// \brief Apply `fn` to the data structure
+  ///
+  /// Registers the calling thread in `record` if it is not registered yet.
+  ///
+  /// \return the value returned by `fn(seq)`
+  template <typename Fn>
+  typename std::result_of<Fn&(Seq&)>::type apply(RecordPtr& record, Fn&& fn);
+
+  /// \brief Release the record of the calling thread, no-op if the thread
+  ///        is not registered
+  void deregister_thread(RecordPtr& record) noexcept;
+
+private:
+  struct NI_CACHELINE_ALIGNED Record
+  {
+    std::atomic<bool> pending;
+    std::atomic<bool> active;
+    void (*invoke)(void* call, Seq& seq) noexcept;
+    void* call;
+
+    Record() noexcept;
+  };
+
+  Record* m_records;
+  size_t m_max_threads;
+  NI_CACHELINE_ALIGNED SpinLock m_lock;
+  Seq m_seq;
+
+  bool register_thread(RecordPtr& record) noexcept;
+  void combine() noexcept;
+};
+
+template <typename Seq>
+FlatCombining<Seq>::Record::Record() noexcept
+  : pending(false)
+  , active(false)
+  , invoke()
+  , call()
+{
+}
+
+template <typename Seq>
+FlatCombining<Seq>::RecordPtr::RecordPtr() noexcept : m_ptr()
+{
+}
+
+template <typename Seq>
+FlatCombining<Seq>::RecordPtr::operator bool() const noexcept
+{
+  return m_ptr != nullptr;
+}
+
+template <typename Seq>
+template <typename... Args>
+FlatCombining<Seq>::FlatCombining(size_t max_threads, Args&&... args)
+  : m_records()
+  , m_max_threads(max_threads)
+  , m_lock()
+  , m_seq(std::forward<Args>(args)...)
+{
+  int rc = posix_memalign(reinterpret_cast<void**>(&m_records),
+                          alignof(Record), sizeof(Record) * max_threads);
+  if (rc)
+    throw std::system_error(rc, std::system_category(), __func__);
+
+  for (size_t i = 0; i < max_threads; ++i)
+    new (&m_records[i]) Record();
+}
+
+template <typename Seq>
+FlatCombining<Seq>::~FlatCombining()
+{
+  for (size_t i = 0; i < m_max_threads; ++i)
+    m_records[i].~Record();
+  free(m_records);
+}
+
+template <typename Seq>
+template <typename Fn>
+typename std::result_of<Fn&(Seq&)>::type
+FlatCombining<Seq>::apply(RecordPtr& record, Fn&& fn)
+{
+  using R = typename std::result_of<Fn&(Seq&)>::type;
+  using Call = details::FlatCombiningCall<Seq, Fn, R>;
+
+  if (!record && !register_thread(record))
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    return fn(m_seq);
+  }
+
+  Call call(fn);
+  Record* r = record.m_ptr;
+  r->invoke = &Call::invoke;
+  r->call = &call;
+  r->pending.store(true, std::memory_order_release);
+
+  Pause pause(2048);
+  while (r->pending.load(std::memory_order_acquire))
+  {
+    if (!m_lock.is_locked() && m_lock.try_lock())
+    {
+      // Our own operation is applied by the pass over the records
+      combine();
+      m_lock.unlock();
+      break;
+    }
+    pause();
+  }
+  return call.take();
+}
+
+template <typename Seq>
+void FlatCombining<Seq>::deregister_thread(RecordPtr& record) noexcept
+{
+  if (!record)
+    return;
+
+  record.m_ptr->active.store(false, std::memory_order_release);
+  record.m_ptr = nullptr;
+}
+
+template <typename Seq>
+bool FlatCombining<Seq>::register_thread(RecordPtr& record) noexcept
+{
+  for (size_t i = 0; i < m_max_threads; ++i)
+  {
+    Record& r = m_records[i];
+    bool active = false;
+    if (!r.active.load(std::memory_order_relaxed) &&
+        r.active.compare_exchange_strong(active, true,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed))
+    {
+      record.m_ptr = &r;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Seq>
+void FlatCombining<Seq>::combine() noexcept
+{
+  for (size_t pass = 0; pass < COMBINE_PASSES; ++pass)
+  {
+    bool combined = false;
+    for (size_t i = 0; i < m_max_threads; ++i)
+    {
+      Record& r = m_records[i];
+      if (!r.pending.load(std::memory_order_acquire))
+        continue;
+
+      r.invoke(r.call, m_seq);
+      r.pending.store(false, std::memory_order_release);
+      combined = true;
+    }
+    if (!combined)
+      break;
+  }
+}
+
+} // namespace ni
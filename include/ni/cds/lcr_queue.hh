@@ -0,0 +1,471 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <ni/cache_locality.hh>
+#include <ni/cds/queue.hh>
+#include <ni/dwcas.hh>
+#include <ni/hazard_pointers.hh>
+#include <ni/memory/node_pool.hh>
+
+namespace ni
+{
+/// \brief MPMC linked concurrent ring queue (LCRQ)
+///
+/// The queue is a linked list of ring segments (CRQ). Producers and consumers
+/// claim a cell of the tail (resp. head) segment with a fetch-and-add on its
+/// tail (resp. head) index and then complete the operation with a double
+/// width CAS on that cell only, so contended threads are spread over the
+/// cells instead of retrying a CAS on a single shared pointer. A producer
+/// which cannot make progress in a segment (full ring or livelock) closes it
+/// and appends a new segment. Drained segments are retired to
+/// `HazardPointers`.
+///
+/// Every cell is stored in a `DoubleWord`: the low word holds a `safe` bit,
+/// the index of the cell and an `occupied` bit, the high word holds the
+/// element. Elements therefore have to be trivially copyable and fit into 64
+/// bits (e.g. integers or pointers to the actual payload).
+///
+/// **Note**
+/// The state returned by `pop` and `tail_state` combines the sequence number
+/// of the tail segment and its tail index, it changes whenever an element is
+/// pushed. Like the state of `MSQueue`, it can be used to validate emptiness
+/// when this queue is the backend of a distributed queue.
+///
+/// **Reference**
+///
+/// * A. Morrison and Y. Afek. Fast Concurrent Queues for x86 Processors.
+///   PPoPP '13.
+///
+/// \param T type of the elements
+/// \param RING_SIZE number of cells of each ring segment, power of 2
+template <typename T, size_t RING_SIZE = 1024>
+class LCRQueue : public Queue<LCRQueue<T, RING_SIZE>, T>
+{
+public:
+  static_assert(std::is_trivially_copyable<T>::value &&
+                  sizeof(T) <= sizeof(uint64_t),
+                "Elements of LCRQueue must be trivially copyable and fit into "
+                "64 bits");
+  static_assert(RING_SIZE > 1 && (RING_SIZE & (RING_SIZE - 1)) == 0,
+                "RING_SIZE must be a power of 2");
+
+  using Element = T;
+  using State = uint64_t;
+
+  LCRQueue();
+  LCRQueue(const LCRQueue&) = delete;
+  LCRQueue& operator=(const LCRQueue&) = delete;
+  ~LCRQueue();
+
+  /// \return true if the queue is empty
+  bool empty() const noexcept;
+
+  /// \brief Estimate the number of elements
+  ///
+  /// Only the first segment which is not drained is accounted for, the
+  /// estimation is at most `RING_SIZE`. The indices claimed by the enqueuers
+  /// which failed and closed a segment are counted until the segment is
+  /// dropped.
+  size_t size_approx() const noexcept;
+
+  /// \brief Push new element into the queue
+  ///
+  /// \param element Element to push
+  template <typename U>
+  bool push(U&& element);
+
+  State tail_state() const noexcept;
+
+  /// \brief Pop an element from the queue
+  ///
+  /// \param [out] element Location to store the popped element (if the queue
+  ///                      is not empty)
+  /// \param [out] state Location to store the state of the queue if `state` is
+  ///                    not null. On failure it is the tail state that was
+  ///                    observed empty.
+  ///
+  /// \return false if the queue is empty
+  bool pop(Element* element, State* state = nullptr);
+
+private:
+  struct Segment
+  {
+    NI_CACHELINE_ALIGNED std::atomic<uint64_t> head;
+    NI_CACHELINE_ALIGNED std::atomic<uint64_t> tail;
+    NI_CACHELINE_ALIGNED std::atomic<Segment*> next;
+    uint64_t id;
+    NI_CACHELINE_ALIGNED DoubleWord cells[RING_SIZE];
+
+    explicit Segment(uint64_t seq);
+  };
+
+  // Bits of the tail index and of the low word of a cell
+  static constexpr uint64_t CLOSED = 1ULL << 63;
+  static constexpr uint64_t SAFE = 1ULL << 63;
+  static constexpr uint64_t OCCUPIED = 1;
+  static constexpr unsigned STATE_INDEX_BITS = 40;
+  // An enqueuer which fails that many times in a row closes the segment
+  static constexpr size_t MAX_ENQUEUE_TRIES = 16;
+
+  NI_CACHELINE_ALIGNED std::atomic<Segment*> m_head;
+  NI_CACHELINE_ALIGNED std::atomic<Segment*> m_tail;
+
+  NI_PADDING_AFTER(sizeof(m_tail));
+
+  static uint64_t make_cell(bool safe, uint64_t index, bool occupied) noexcept;
+  static uint64_t cell_index(uint64_t cell) noexcept;
+  static State make_state(const Segment* segment, uint64_t index) noexcept;
+
+  static bool enqueue(Segment* segment, uint64_t value) noexcept;
+  static bool dequeue(Segment* segment, uint64_t* value,
+                      uint64_t* tail) noexcept;
+  static void fix_state(Segment* segment) noexcept;
+
+  static Segment* create_segment(uint64_t seq);
+  static void destroy_segment(Segment* segment) noexcept;
+  static void reclaim_segment(void* segment) noexcept;
+};
+
+template <typename T, size_t RING_SIZE>
+LCRQueue<T, RING_SIZE>::Segment::Segment(uint64_t seq)
+  : head()
+  , tail()
+  , next()
+  , id(seq)
+{
+  for (uint64_t i = 0; i < RING_SIZE; ++i)
+    cells[i] = DoubleWord{make_cell(true, i, false), 0};
+}
+
+template <typename T, size_t RING_SIZE>
+LCRQueue<T, RING_SIZE>::LCRQueue()
+{
+  Segment* segment = create_segment(0);
+  m_head.store(segment, std::memory_order_relaxed);
+  m_tail.store(segment, std::memory_order_relaxed);
+}
+
+template <typename T, size_t RING_SIZE>
+LCRQueue<T, RING_SIZE>::~LCRQueue()
+{
+  Segment* segment = m_head.load(std::memory_order_relaxed);
+  while (segment)
+  {
+    Segment* tmp = segment;
+    segment = tmp->next.load(std::memory_order_relaxed);
+    destroy_segment(tmp);
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+bool LCRQueue<T, RING_SIZE>::empty() const noexcept
+{
+  HazardPointers::Guard guard;
+  Segment* segment = guard.protect(m_head);
+  while (true)
+  {
+    uint64_t tail = segment->tail.load(std::memory_order_acquire) & ~CLOSED;
+    if (segment->head.load(std::memory_order_acquire) < tail)
+      return false;
+
+    Segment* next = segment->next.load(std::memory_order_acquire);
+    if (!next)
+      return true;
+    // `next` cannot be retired before the head moves past it
+    guard.set(next);
+    if (m_head.load(std::memory_order_acquire) != segment)
+      segment = guard.protect(m_head);
+    else
+      segment = next;
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+size_t LCRQueue<T, RING_SIZE>::size_approx() const noexcept
+{
+  HazardPointers::Guard guard;
+  Segment* segment = guard.protect(m_head);
+  while (true)
+  {
+    uint64_t head = segment->head.load(std::memory_order_relaxed);
+    uint64_t tail = segment->tail.load(std::memory_order_relaxed) & ~CLOSED;
+    if (head < tail)
+      return std::min<uint64_t>(tail - head, RING_SIZE);
+
+    Segment* next = segment->next.load(std::memory_order_acquire);
+    if (!next)
+      return 0;
+    guard.set(next);
+    if (m_head.load(std::memory_order_acquire) != segment)
+      segment = guard.protect(m_head);
+    else
+      segment = next;
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+template <typename U>
+bool LCRQueue<T, RING_SIZE>::push(U&& element)
+{
+  Element item(std::forward<U>(element));
+  uint64_t value = 0;
+  std::memcpy(&value, &item, sizeof(item));
+
+  HazardPointers::Guard tail_guard;
+  while (true)
+  {
+    Segment* tail = tail_guard.protect(m_tail);
+    Segment* next = tail->next.load(std::memory_order_acquire);
+    if (next)
+    {
+      m_tail.compare_exchange_strong(tail, next);
+      continue;
+    }
+
+    if (enqueue(tail, value))
+      return true;
+
+    // The segment is closed, append a new one which already holds the element
+    Segment* segment = create_segment(tail->id + 1);
+    segment->cells[0] = DoubleWord{make_cell(true, 0, true), value};
+    segment->tail.store(1, std::memory_order_relaxed);
+
+    Segment* expected = nullptr;
+    if (tail->next.compare_exchange_strong(expected, segment))
+    {
+      m_tail.compare_exchange_strong(tail, segment);
+      return true;
+    }
+    destroy_segment(segment);
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+typename LCRQueue<T, RING_SIZE>::State
+LCRQueue<T, RING_SIZE>::tail_state() const noexcept
+{
+  HazardPointers::Guard tail_guard;
+  Segment* tail = tail_guard.protect(m_tail);
+  return make_state(tail, tail->tail.load(std::memory_order_acquire));
+}
+
+template <typename T, size_t RING_SIZE>
+bool LCRQueue<T, RING_SIZE>::pop(Element* element, State* state)
+{
+  HazardPointers::Guard head_guard;
+  uint64_t value;
+  uint64_t tail;
+
+  while (true)
+  {
+    Segment* head = head_guard.protect(m_head);
+    bool found = dequeue(head, &value, &tail);
+    if (!found)
+    {
+      Segment* next = head->next.load(std::memory_order_acquire);
+      if (!next)
+      {
+        if (state != nullptr)
+          *state = make_state(head, tail);
+        return false;
+      }
+
+      // Elements may have been pushed into the segment before it was closed
+      found = dequeue(head, &value, &tail);
+      if (!found)
+      {
+        // The tail must never lag behind the head
+        Segment* expected = head;
+        m_tail.compare_exchange_strong(expected, next);
+        if (m_head.compare_exchange_strong(head, next))
+          HazardPointers::retire(head, &reclaim_segment);
+        continue;
+      }
+    }
+
+    if (state != nullptr)
+      *state = make_state(head, head->head.load(std::memory_order_relaxed));
+    std::memcpy(element, &value, sizeof(Element));
+    return true;
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+uint64_t LCRQueue<T, RING_SIZE>::make_cell(bool safe, uint64_t index,
+                                          bool occupied) noexcept
+{
+  return (safe ? SAFE : 0) | (index << 1) | (occupied ? OCCUPIED : 0);
+}
+
+template <typename T, size_t RING_SIZE>
+uint64_t LCRQueue<T, RING_SIZE>::cell_index(uint64_t cell) noexcept
+{
+  return (cell & ~SAFE) >> 1;
+}
+
+template <typename T, size_t RING_SIZE>
+typename LCRQueue<T, RING_SIZE>::State
+LCRQueue<T, RING_SIZE>::make_state(const Segment* segment,
+                                   uint64_t index) noexcept
+{
+  return (segment->id << STATE_INDEX_BITS) + (index & ~CLOSED);
+}
+
+template <typename T, size_t RING_SIZE>
+bool LCRQueue<T, RING_SIZE>::enqueue(Segment* segment, uint64_t value) noexcept
+{
+  for (size_t tries = 0;; ++tries)
+  {
+    uint64_t tail = segment->tail.fetch_add(1);
+    if (tail & CLOSED)
+      return false;
+
+    DoubleWord& cell = segment->cells[tail & (RING_SIZE - 1)];
+    // The words may be torn, `dwcas` validates them
+    DoubleWord expected{__atomic_load_n(&cell.low, __ATOMIC_ACQUIRE),
+                        __atomic_load_n(&cell.high, __ATOMIC_RELAXED)};
+    if (!(expected.low & OCCUPIED) && cell_index(expected.low) <= tail &&
+        ((expected.low & SAFE) || segment->head.load() <= tail))
+    {
+      if (dwcas(&cell, expected,
+                DoubleWord{make_cell(true, tail, true), value}))
+        return true;
+    }
+
+    uint64_t head = segment->head.load();
+    if (static_cast<int64_t>(tail - head) >=
+          static_cast<int64_t>(RING_SIZE) ||
+        tries >= MAX_ENQUEUE_TRIES)
+    {
+      segment->tail.fetch_or(CLOSED);
+      return false;
+    }
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+bool LCRQueue<T, RING_SIZE>::dequeue(Segment* segment, uint64_t* value,
+                                    uint64_t* tail) noexcept
+{
+  while (true)
+  {
+    // Checking first keeps the indices, hence the state, of an empty segment
+    // unchanged
+    *tail = segment->tail.load() & ~CLOSED;
+    if (segment->head.load() >= *tail)
+      return false;
+
+    uint64_t head = segment->head.fetch_add(1);
+    DoubleWord& cell = segment->cells[head & (RING_SIZE - 1)];
+    while (true)
+    {
+      DoubleWord expected{__atomic_load_n(&cell.low, __ATOMIC_ACQUIRE),
+                          __atomic_load_n(&cell.high, __ATOMIC_RELAXED)};
+      uint64_t index = cell_index(expected.low);
+      if (index > head)
+        break;
+
+      bool safe = expected.low & SAFE;
+      if (expected.low & OCCUPIED)
+      {
+        if (index == head)
+        {
+          if (dwcas(&cell, expected,
+                    DoubleWord{make_cell(safe, head + RING_SIZE, false), 0}))
+          {
+            *value = expected.high;
+            return true;
+          }
+        }
+        else
+        {
+          // Element of a former round, prevent any enqueuer of this round
+          // from using the cell while it may still be dequeued
+          if (dwcas(&cell, expected,
+                    DoubleWord{expected.low & ~SAFE, expected.high}))
+            break;
+        }
+      }
+      else
+      {
+        // Skip the cell so that the enqueuer of this round fails
+        if (dwcas(&cell, expected,
+                  DoubleWord{make_cell(safe, head + RING_SIZE, false), 0}))
+          break;
+      }
+    }
+
+    *tail = segment->tail.load() & ~CLOSED;
+    if (*tail <= head + 1)
+    {
+      fix_state(segment);
+      return false;
+    }
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+void LCRQueue<T, RING_SIZE>::fix_state(Segment* segment) noexcept
+{
+  // Failed dequeuers may have moved the head past the tail, move the tail
+  // forward so that enqueuers do not have to skip those cells one at a time
+  while (true)
+  {
+    uint64_t tail = segment->tail.load();
+    uint64_t head = segment->head.load();
+    if (segment->tail.load() != tail)
+      continue;
+    // Never true when the segment is closed
+    if (head <= tail)
+      return;
+    if (segment->tail.compare_exchange_strong(tail, head))
+      return;
+  }
+}
+
+template <typename T, size_t RING_SIZE>
+typename LCRQueue<T, RING_SIZE>::Segment*
+LCRQueue<T, RING_SIZE>::create_segment(uint64_t seq)
+{
+  Segment* segment = HeapNodeAllocator<Segment>::allocate();
+  return new (segment) Segment(seq);
+}
+
+template <typename T, size_t RING_SIZE>
+void LCRQueue<T, RING_SIZE>::destroy_segment(Segment* segment) noexcept
+{
+  segment->~Segment();
+  HeapNodeAllocator<Segment>::deallocate(segment);
+}
+
+template <typename T, size_t RING_SIZE>
+void LCRQueue<T, RING_SIZE>::reclaim_segment(void* segment) noexcept
+{
+  destroy_segment(static_cast<Segment*>(segment));
+}
+
+} // namespace ni
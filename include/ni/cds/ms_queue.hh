@@ -18,16 +18,26 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <atomic>
 #include <utility>
 
 #include <ni/cache_locality.hh>
 #include <ni/cds/queue.hh>
+#include <ni/hazard_pointers.hh>
+#include <ni/memory/node_pool.hh>
 #include <ni/tagged_ptr.hh>
+#include <ni/wide_tagged_ptr.hh>
 
 namespace ni
 {
 /// \brief MPMC Michael-Scott lock-free queue
 ///
+/// Nodes are protected by hazard pointers while being accessed and removed
+/// nodes are retired to `HazardPointers`, so they can be handed back to the
+/// node allocator without racing with concurrent readers. The tags of the
+/// head and tail pointers still prevent ABA on the CAS operations and serve
+/// as the state of the queue.
+///
 /// **Note**
 /// This queue does not scale well when contention increases. If strict FIFO
 /// semantic is not required, it can be used as a backend (partial queue) of a
@@ -39,18 +49,24 @@ namespace ni
 ///   and Blocking Concurrent Queue Algorithms. PODC '96.
 ///
 /// \param T type of the elements
-template <typename T>
-class MSQueue : public Queue<MSQueue, T>
+/// \param NodeAllocator allocation policy of the nodes, see
+///        `HeapNodeAllocator` and `NodePool`
+/// \param PtrTraits representation of the links, `TaggedPtrTraits` (16-bit
+///        tags) or `WideTaggedPtrTraits` (64-bit tags, double width CAS)
+template <typename T,
+          template <typename> class NodeAllocator = HeapNodeAllocator,
+          typename PtrTraits = TaggedPtrTraits>
+class MSQueue : public Queue<MSQueue<T, NodeAllocator, PtrTraits>, T>
 {
 public:
   using Element = T;
-  using State = uint16_t;
+  using State = typename PtrTraits::Tag;
 
   class NI_CACHELINE_ALIGNED Node
   {
   public:
-    using Ptr = TaggedPtr<Node>;
-    using AtomicPtr = AtomicTaggedPtr<Ptr>;
+    using Ptr = typename PtrTraits::template Ptr<Node>;
+    using AtomicPtr = typename PtrTraits::template AtomicPtr<Node>;
 
     Element value;
     AtomicPtr next;
@@ -77,6 +93,9 @@ public:
   /// \return true if the queue is empty
   bool empty() const noexcept;
 
+  /// \return an estimation of the number of elements
+  size_t size_approx() const noexcept;
+
   /// \brief Push new element into the queue
   ///
   /// \param element Element to push
@@ -91,6 +110,15 @@ public:
   template <typename U>
   bool try_push(U&& element, State old_tail_state);
 
+  /// \brief Push a range of elements into the queue
+  ///
+  /// The nodes are linked together beforehand and the whole chain is
+  /// published with a single CAS, the elements stay contiguous in the queue.
+  ///
+  /// \return number of elements pushed
+  template <typename InputIt>
+  size_t push_bulk(InputIt first, InputIt last);
+
   State tail_state() const noexcept;
 
   /// \brief Pop an element from the queue
@@ -110,40 +138,64 @@ public:
   /// \return See `PopResult`
   PopResult try_pop(Element* element, State old_head_state, State* head_state);
 
+  /// \brief Pop up to `max` elements from the queue
+  ///
+  /// The elements are detached with a single CAS on the head.
+  ///
+  /// \param [out] elements Location to store the popped elements
+  ///
+  /// \return number of elements popped, 0 if the queue is empty
+  size_t pop_bulk(Element* elements, size_t max);
+
 private:
   using NodePtr = typename Node::Ptr;
   using AtomicNodePtr = typename Node::AtomicPtr;
 
   NI_CACHELINE_ALIGNED AtomicNodePtr m_head;
   NI_CACHELINE_ALIGNED AtomicNodePtr m_tail;
+  // Counters of pushed and popped elements for `size_approx`, kept away from
+  // the head and the tail and from each other so they don't add contention
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_pushed;
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_popped;
 
-  NI_PADDING_AFTER(sizeof(m_tail));
+  NI_PADDING_AFTER(sizeof(m_popped));
+
+  template <typename U>
+  static Node* create_node(U&& item);
+  static void destroy_node(Node* node) noexcept;
+  static void reclaim_node(void* node) noexcept;
 };
 
-template <typename T>
-MSQueue<T>::Node::Node(const Element& item)
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+MSQueue<T, NodeAllocator, PtrTraits>::Node::Node(const Element& item)
   : value(item)
   , next()
 {
 }
 
-template <typename T>
-MSQueue<T>::Node::Node(Element&& item)
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+MSQueue<T, NodeAllocator, PtrTraits>::Node::Node(Element&& item)
   : value(std::move(item))
   , next()
 {
 }
 
-template <typename T>
-MSQueue<T>::MSQueue()
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+MSQueue<T, NodeAllocator, PtrTraits>::MSQueue()
+  : m_pushed(0)
+  , m_popped(0)
 {
-  Node* node = new Node(Element());
+  Node* node = create_node(Element());
   m_head.store(NodePtr(node), std::memory_order_relaxed);
   m_tail.store(NodePtr(node), std::memory_order_relaxed);
 }
 
-template <typename T>
-MSQueue<T>::~MSQueue()
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+MSQueue<T, NodeAllocator, PtrTraits>::~MSQueue()
 {
   Node* head = m_head.load(std::memory_order_relaxed).value();
   Node* tail = m_tail.load(std::memory_order_relaxed).value();
@@ -151,20 +203,22 @@ MSQueue<T>::~MSQueue()
   {
     Node* tmp = head;
     head = tmp->next.load(std::memory_order_relaxed).value();
-    delete tmp;
+    destroy_node(tmp);
   }
-  delete tail;
+  destroy_node(tail);
 }
 
-template <typename T>
-bool MSQueue<T>::empty() const noexcept
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+bool MSQueue<T, NodeAllocator, PtrTraits>::empty() const noexcept
 {
+  HazardPointers::Guard head_guard;
   NodePtr old_head;
   NodePtr old_tail;
   NodePtr next;
   while (true)
   {
-    old_head = m_head.load(std::memory_order_relaxed);
+    old_head = head_guard.protect(m_head);
     old_tail = m_tail.load(std::memory_order_relaxed);
     next = old_head.value()->next.load(std::memory_order_relaxed);
     if (m_head.load(std::memory_order_relaxed) == old_head)
@@ -172,23 +226,33 @@ bool MSQueue<T>::empty() const noexcept
   }
 }
 
-template <typename T>
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+size_t MSQueue<T, NodeAllocator, PtrTraits>::size_approx() const noexcept
+{
+  // An element can be popped before its push is counted
+  size_t popped = m_popped.load(std::memory_order_relaxed);
+  size_t pushed = m_pushed.load(std::memory_order_relaxed);
+  return pushed > popped ? pushed - popped : 0;
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
 template <typename U>
-bool MSQueue<T>::push(U&& element)
+bool MSQueue<T, NodeAllocator, PtrTraits>::push(U&& element)
 {
-  Node* node = new Node(std::forward<U>(element));
-  NodePtr old_tail = m_tail.load(std::memory_order_relaxed);
+  Node* node = create_node(std::forward<U>(element));
+  HazardPointers::Guard tail_guard;
+  NodePtr old_tail;
   NodePtr next;
 
   while (true)
   {
-    next = old_tail.value()->next.load(std::memory_order_relaxed);
+    old_tail = tail_guard.protect(m_tail);
+    next = old_tail.value()->next.load(std::memory_order_acquire);
 
     if (m_tail.load(std::memory_order_relaxed) != old_tail)
-    {
-      old_tail = m_tail.load(std::memory_order_relaxed);
       continue;
-    }
 
     if (next.value() == nullptr)
     {
@@ -198,9 +262,9 @@ bool MSQueue<T>::push(U&& element)
         m_tail.compare_exchange_weak(old_tail,
                                      NodePtr(node, old_tail.tag() + 1),
                                      std::memory_order_release);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
         break;
       }
-      old_tail = m_tail.load(std::memory_order_relaxed);
     }
     else
     {
@@ -213,26 +277,30 @@ bool MSQueue<T>::push(U&& element)
   return true;
 }
 
-template <typename T>
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
 template <typename U>
-bool MSQueue<T>::try_push(U&& element, State old_tail_state)
+bool MSQueue<T, NodeAllocator, PtrTraits>::try_push(U&& element,
+                                                   State old_tail_state)
 {
-  NodePtr old_tail = m_tail.load(std::memory_order_relaxed);
+  HazardPointers::Guard tail_guard;
+  NodePtr old_tail = tail_guard.protect(m_tail);
   if (old_tail.tag() == old_tail_state)
   {
-    NodePtr next = old_tail.value()->next.load(std::memory_order_relaxed);
+    NodePtr next = old_tail.value()->next.load(std::memory_order_acquire);
     if (next.value() == nullptr)
     {
-      Node* node = new Node(std::forward<U>(element));
+      Node* node = create_node(std::forward<U>(element));
       if (old_tail.value()->next.compare_exchange_strong(
             next, NodePtr(node, next.tag() + 1), std::memory_order_release))
       {
         m_tail.compare_exchange_strong(old_tail,
                                        NodePtr(node, old_tail.tag() + 1),
                                        std::memory_order_release);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
         return true;
       }
-      delete node;
+      destroy_node(node);
     }
     else
     {
@@ -244,26 +312,104 @@ bool MSQueue<T>::try_push(U&& element, State old_tail_state)
   return false;
 }
 
-template <typename T>
-typename MSQueue<T>::State MSQueue<T>::tail_state() const noexcept
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+template <typename InputIt>
+size_t MSQueue<T, NodeAllocator, PtrTraits>::push_bulk(InputIt first,
+                                                      InputIt last)
+{
+  if (first == last)
+    return 0;
+
+  Node* chain_head = create_node(*first);
+  Node* chain_tail = chain_head;
+  size_t count = 1;
+  try
+  {
+    for (++first; first != last; ++first, ++count)
+    {
+      Node* node = create_node(*first);
+      chain_tail->next.store(NodePtr(node), std::memory_order_relaxed);
+      chain_tail = node;
+    }
+  }
+  catch (...)
+  {
+    while (chain_head)
+    {
+      Node* tmp = chain_head;
+      chain_head = tmp->next.load(std::memory_order_relaxed).value();
+      destroy_node(tmp);
+    }
+    throw;
+  }
+
+  HazardPointers::Guard tail_guard;
+  NodePtr old_tail;
+  NodePtr next;
+
+  while (true)
+  {
+    old_tail = tail_guard.protect(m_tail);
+    next = old_tail.value()->next.load(std::memory_order_acquire);
+
+    if (m_tail.load(std::memory_order_relaxed) != old_tail)
+      continue;
+
+    if (next.value() == nullptr)
+    {
+      if (old_tail.value()->next.compare_exchange_weak(
+            next, NodePtr(chain_head, next.tag() + 1),
+            std::memory_order_release))
+      {
+        // Other threads help to advance the tail one node at a time if this
+        // fails
+        m_tail.compare_exchange_weak(old_tail,
+                                     NodePtr(chain_tail, old_tail.tag() + 1),
+                                     std::memory_order_release);
+        m_pushed.fetch_add(count, std::memory_order_relaxed);
+        break;
+      }
+    }
+    else
+    {
+      m_tail.compare_exchange_weak(old_tail,
+                                   NodePtr(next.value(), old_tail.tag() + 1),
+                                   std::memory_order_release);
+    }
+  }
+
+  return count;
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+typename MSQueue<T, NodeAllocator, PtrTraits>::State
+MSQueue<T, NodeAllocator, PtrTraits>::tail_state() const noexcept
 {
   return m_tail.load(std::memory_order_relaxed).tag();
 }
 
-template <typename T>
-bool MSQueue<T>::pop(Element* element, State* head_state)
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+bool MSQueue<T, NodeAllocator, PtrTraits>::pop(Element* element,
+                                              State* head_state)
 {
+  HazardPointers::Guard head_guard;
+  HazardPointers::Guard next_guard;
   NodePtr old_head;
   NodePtr old_tail;
   NodePtr next;
 
   while (true)
   {
-    old_head = m_head.load(std::memory_order_relaxed);
-    old_tail = m_tail.load(std::memory_order_relaxed);
-    next = old_head.value()->next.load(std::memory_order_relaxed);
+    old_head = head_guard.protect(m_head);
+    old_tail = m_tail.load(std::memory_order_acquire);
+    next = old_head.value()->next.load(std::memory_order_acquire);
+    // `next` cannot be retired before the head moves past it
+    next_guard.set(next.value());
 
-    if (m_head.load(std::memory_order_relaxed) != old_head)
+    if (m_head.load(std::memory_order_acquire) != old_head)
       continue;
 
     if (old_head.value() == old_tail.value())
@@ -287,23 +433,30 @@ bool MSQueue<T>::pop(Element* element, State* head_state)
       {
         if (head_state != nullptr)
           *head_state = old_head.tag();
-        delete old_head.value();
+        m_popped.fetch_add(1, std::memory_order_relaxed);
+        HazardPointers::retire(old_head.value(), &reclaim_node);
         return true;
       }
     }
   }
 }
 
-template <typename T>
-typename MSQueue<T>::PopResult MSQueue<T>::try_pop(Element* element,
-                                                   State old_head_state,
-                                                   State* head_state)
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+typename MSQueue<T, NodeAllocator, PtrTraits>::PopResult
+MSQueue<T, NodeAllocator, PtrTraits>::try_pop(Element* element,
+                                              State old_head_state,
+                                              State* head_state)
 {
-  NodePtr old_head = m_head.load(std::memory_order_relaxed);
-  NodePtr old_tail = m_tail.load(std::memory_order_relaxed);
-  NodePtr next = old_head.value()->next.load(std::memory_order_relaxed);
-
-  if (old_head.tag() == old_head_state)
+  HazardPointers::Guard head_guard;
+  HazardPointers::Guard next_guard;
+  NodePtr old_head = head_guard.protect(m_head);
+  NodePtr old_tail = m_tail.load(std::memory_order_acquire);
+  NodePtr next = old_head.value()->next.load(std::memory_order_acquire);
+  next_guard.set(next.value());
+
+  if (old_head.tag() == old_head_state &&
+      m_head.load(std::memory_order_acquire) == old_head)
   {
     if (old_head.value() == old_tail.value())
     {
@@ -323,7 +476,8 @@ typename MSQueue<T>::PopResult MSQueue<T>::try_pop(Element* element,
                                                            old_head.tag() + 1),
                                          std::memory_order_release))
       {
-        delete old_head.value();
+        m_popped.fetch_add(1, std::memory_order_relaxed);
+        HazardPointers::retire(old_head.value(), &reclaim_node);
         return PopResult::Success;
       }
     }
@@ -331,4 +485,110 @@ typename MSQueue<T>::PopResult MSQueue<T>::try_pop(Element* element,
   return PopResult::Failure;
 }
 
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+size_t MSQueue<T, NodeAllocator, PtrTraits>::pop_bulk(Element* elements,
+                                                     size_t max)
+{
+  if (max == 0)
+    return 0;
+
+  HazardPointers::Guard head_guard;
+  // Hand-over-hand protection of the nodes being walked
+  HazardPointers::Guard node_guards[2];
+  NodePtr old_head;
+  NodePtr old_tail;
+  NodePtr next;
+
+  while (true)
+  {
+    old_head = head_guard.protect(m_head);
+    old_tail = m_tail.load(std::memory_order_acquire);
+    next = old_head.value()->next.load(std::memory_order_acquire);
+    node_guards[0].set(next.value());
+
+    if (m_head.load(std::memory_order_acquire) != old_head)
+      continue;
+
+    if (old_head.value() == old_tail.value())
+    {
+      if (next.value() == nullptr)
+        return 0;
+      m_tail.compare_exchange_weak(old_tail,
+                                   NodePtr(next.value(), old_tail.tag() + 1),
+                                   std::memory_order_release);
+      continue;
+    }
+
+    // Nodes up to `old_tail` are linked and cannot be retired as long as the
+    // head does not change, the head must not move past the tail.
+    Node* node = next.value();
+    elements[0] = node->value;
+    size_t count = 1;
+    bool valid = true;
+    while (count < max && node != old_tail.value())
+    {
+      Node* succ = node->next.load(std::memory_order_acquire).value();
+      node_guards[count % 2].set(succ);
+      if (m_head.load(std::memory_order_acquire) != old_head)
+      {
+        valid = false;
+        break;
+      }
+      elements[count++] = succ->value;
+      node = succ;
+    }
+    if (!valid)
+      continue;
+
+    if (m_head.compare_exchange_weak(old_head,
+                                     NodePtr(node, old_head.tag() + 1),
+                                     std::memory_order_release))
+    {
+      m_popped.fetch_add(count, std::memory_order_relaxed);
+      Node* retired = old_head.value();
+      while (retired != node)
+      {
+        Node* tmp = retired;
+        retired = tmp->next.load(std::memory_order_relaxed).value();
+        HazardPointers::retire(tmp, &reclaim_node);
+      }
+      return count;
+    }
+  }
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+template <typename U>
+typename MSQueue<T, NodeAllocator, PtrTraits>::Node*
+MSQueue<T, NodeAllocator, PtrTraits>::create_node(U&& item)
+{
+  Node* node = NodeAllocator<Node>::allocate();
+  try
+  {
+    return new (node) Node(std::forward<U>(item));
+  }
+  catch (...)
+  {
+    NodeAllocator<Node>::deallocate(node);
+    throw;
+  }
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+void MSQueue<T, NodeAllocator, PtrTraits>::destroy_node(Node* node) noexcept
+{
+  node->~Node();
+  NodeAllocator<Node>::deallocate(node);
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+void MSQueue<T, NodeAllocator, PtrTraits>::reclaim_node(void* node) noexcept
+{
+  destroy_node(static_cast<Node*>(node));
+}
+
 } // namespace ni
@@ -18,45 +18,93 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <cstddef>
 #include <utility>
 
-#include <ni/cache_locality.hh>
-#include <ni/tagged_ptr.hh>
-
 namespace ni
 {
-/// \brief MPMC Michael-Scott lock-free queue
+/// \brief CRTP base of the queues
+///
+/// Provides the common `put`/`get` interface on top of the `push`/`pop`
+/// operations of the concrete queue.
 ///
-/// **Note**
-/// This queue does not scale well when contention increases. If strict FIFO
-/// semantic is not required, it can be used as a backend (partial queue) of a
-/// distributed queue which can provide much better scalability.
+/// `put_bulk`/`get_bulk` forward to `push_bulk`/`pop_bulk`. The versions
+/// defined here fall back to one `push`/`pop` per element, queues which can
+/// transfer a batch more efficiently hide them with their own.
 ///
+/// \param Impl type of the concrete queue
 /// \param T type of the elements
-template <template <typename T> typename Impl, typename T>
+template <typename Impl, typename T>
 class Queue
 {
 public:
-  using Self = Impl<T>;
+  using Self = Impl;
   using Element = T;
 
   template <typename U>
   bool put(U&& element);
 
   bool get(Element* element);
+
+  /// \return number of elements put
+  template <typename InputIt>
+  size_t put_bulk(InputIt first, InputIt last);
+
+  /// \return number of elements stored into `elements`
+  size_t get_bulk(Element* elements, size_t max);
+
+  template <typename InputIt>
+  size_t push_bulk(InputIt first, InputIt last);
+
+  size_t pop_bulk(Element* elements, size_t max);
 };
 
-template <template <typename T> typename Impl, typename T>
+template <typename Impl, typename T>
 template <typename U>
 bool Queue<Impl, T>::put(U&& element)
 {
   return static_cast<Self*>(this)->push(std::forward<U>(element));
 }
 
-template <template <typename T> typename Impl, typename T>
+template <typename Impl, typename T>
 bool Queue<Impl, T>::get(Element* element)
 {
   return static_cast<Self*>(this)->pop(element);
 }
 
+template <typename Impl, typename T>
+template <typename InputIt>
+size_t Queue<Impl, T>::put_bulk(InputIt first, InputIt last)
+{
+  return static_cast<Self*>(this)->push_bulk(first, last);
+}
+
+template <typename Impl, typename T>
+size_t Queue<Impl, T>::get_bulk(Element* elements, size_t max)
+{
+  return static_cast<Self*>(this)->pop_bulk(elements, max);
+}
+
+template <typename Impl, typename T>
+template <typename InputIt>
+size_t Queue<Impl, T>::push_bulk(InputIt first, InputIt last)
+{
+  size_t count = 0;
+  for (; first != last; ++first, ++count)
+  {
+    if (!static_cast<Self*>(this)->push(*first))
+      break;
+  }
+  return count;
+}
+
+template <typename Impl, typename T>
+size_t Queue<Impl, T>::pop_bulk(Element* elements, size_t max)
+{
+  size_t count = 0;
+  while (count < max && static_cast<Self*>(this)->pop(&elements[count]))
+    ++count;
+  return count;
+}
+
 } // namespace ni
@@ -0,0 +1,295 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include <ni/cache_locality.hh>
+#include <ni/sync/event_count.hh>
+
+namespace ni
+{
+/// \brief Wait-free single producer single consumer ring buffer which can be
+///        shared between processes
+///
+/// Same algorithm as `SPSCRingBuffer`, but the control block and the slots
+/// are laid out in a single caller-provided region of memory (typically a
+/// `SharedMemory`) without any pointer, so that the producer and the consumer
+/// may map the region at different addresses in different processes.
+///
+/// Pushing and popping do not involve any system call. A consumer may also
+/// sleep on a process-shared futex until an element is pushed with
+/// `wait_pop()`: the producer only issues a system call when the consumer is
+/// actually sleeping.
+///
+/// \param T type of the elements, trivially copyable and lock-free when
+///        atomic. Both processes must use the same `T` and `Empty` (and
+///        architecture), elements must not be pointers.
+/// \param Empty `empty` value of type T (defaults to `T()`)
+template <typename T, T Empty = T()>
+class SharedSPSCRingBuffer
+{
+public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Elements of SharedSPSCRingBuffer must be trivially copyable");
+  // Otherwise the atomics would rely on a lock private to the process
+  static_assert(std::atomic<T>::is_always_lock_free,
+                "Elements of SharedSPSCRingBuffer must be lock-free");
+
+  using Element = T;
+
+  /// \return bytes of memory needed by a ring buffer of `size` elements
+  static size_t memory_size(size_t size) noexcept;
+
+  /// \brief Create a new ring buffer in `memory`
+  /// \param memory region of at least `memory_size(size)` bytes, cache line
+  ///        aligned
+  /// \param size capacity of the ring buffer, must be power of two (and
+  ///        greater than 1)
+  static SharedSPSCRingBuffer* create(void* memory, size_t size) noexcept;
+
+  /// \brief Attach to a ring buffer created in `memory`, possibly by another
+  ///        process
+  /// \return nullptr if no ring buffer has been created in `memory` (yet)
+  static SharedSPSCRingBuffer* attach(void* memory) noexcept;
+
+  SharedSPSCRingBuffer(const SharedSPSCRingBuffer&) = delete;
+  SharedSPSCRingBuffer& operator=(const SharedSPSCRingBuffer&) = delete;
+
+  /// \return capacity of the ring buffer
+  size_t size() const noexcept;
+
+  /// \return number of elements currently inside the ring buffer
+  size_t len() const noexcept;
+
+  /// \return true if the buffer is empty
+  bool empty() const noexcept;
+
+  /// \brief Push new element, producer only
+  /// \param element element to push, not `Empty`
+  /// \return false if the ring buffer is full
+  bool push(const Element& element) noexcept;
+
+  /// \brief Push up to `n` elements, producer only
+  /// \param elements elements to push, none of them is `Empty`
+  /// \return number of elements pushed, a prefix of `elements`
+  size_t push_n(const Element* elements, size_t n) noexcept;
+
+  /// \brief Pop an element, consumer only
+  /// \return `Empty` if the ring buffer is empty
+  Element pop() noexcept;
+
+  /// \brief Pop up to `max` elements, consumer only
+  /// \param [out] elements location to store the popped elements
+  /// \return number of elements popped
+  size_t pop_n(Element* elements, size_t max) noexcept;
+
+  /// \brief Pop an element, sleeping until one is pushed if the ring buffer
+  ///        is empty, consumer only
+  Element wait_pop() noexcept;
+
+private:
+  // "niSR", tells that the ring buffer is initialized
+  static constexpr uint32_t MAGIC = 0x6e695352;
+
+  // Read-only once created
+  std::atomic<uint32_t> m_magic;
+  size_t m_size;
+  size_t m_mask;
+
+  // Owned by the producer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_write_index;
+  // Owned by the consumer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_read_index;
+  // Polled by the producer after every push
+  NI_CACHELINE_ALIGNED SharedEventCount m_not_empty;
+
+  NI_PADDING_AFTER(sizeof(m_not_empty));
+
+  explicit SharedSPSCRingBuffer(size_t size) noexcept;
+
+  // The slots follow the control block
+  std::atomic<Element>& slot(size_t index) noexcept;
+  const std::atomic<Element>& slot(size_t index) const noexcept;
+};
+
+template <typename T, T Empty>
+size_t SharedSPSCRingBuffer<T, Empty>::memory_size(size_t size) noexcept
+{
+  return sizeof(SharedSPSCRingBuffer) + sizeof(std::atomic<Element>) * size;
+}
+
+template <typename T, T Empty>
+SharedSPSCRingBuffer<T, Empty>*
+SharedSPSCRingBuffer<T, Empty>::create(void* memory, size_t size) noexcept
+{
+  uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+  assert(address % NI_CACHELINE_SIZE<size_t> == 0 &&
+         "memory must be cache line aligned");
+  return new (memory) SharedSPSCRingBuffer(size);
+}
+
+template <typename T, T Empty>
+SharedSPSCRingBuffer<T, Empty>*
+SharedSPSCRingBuffer<T, Empty>::attach(void* memory) noexcept
+{
+  auto ring = static_cast<SharedSPSCRingBuffer*>(memory);
+  if (ring->m_magic.load(std::memory_order_acquire) != MAGIC)
+    return nullptr;
+  return ring;
+}
+
+template <typename T, T Empty>
+SharedSPSCRingBuffer<T, Empty>::SharedSPSCRingBuffer(size_t size) noexcept
+  : m_magic()
+  , m_size(size)
+  , m_mask(size - 1)
+  , m_write_index()
+  , m_read_index()
+  , m_not_empty()
+{
+  assert((size > 1) && (size & (size - 1)) == 0 &&
+         "size must be a power of two");
+
+  for (size_t i = 0; i < size; ++i)
+    new (&slot(i)) std::atomic<Element>(Empty);
+
+  // Publishes the initialized ring buffer to `attach()`
+  m_magic.store(MAGIC, std::memory_order_release);
+}
+
+template <typename T, T Empty>
+size_t SharedSPSCRingBuffer<T, Empty>::size() const noexcept
+{
+  return m_size;
+}
+
+template <typename T, T Empty>
+size_t SharedSPSCRingBuffer<T, Empty>::len() const noexcept
+{
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  if (w > r)
+    return w - r;
+  if (w < r)
+    return m_size - r + w;
+  if (slot(w).load(std::memory_order_relaxed) == Empty)
+    return 0;
+  return m_size;
+}
+
+template <typename T, T Empty>
+bool SharedSPSCRingBuffer<T, Empty>::empty() const noexcept
+{
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  return slot(r).load(std::memory_order_acquire) == Empty;
+}
+
+template <typename T, T Empty>
+bool SharedSPSCRingBuffer<T, Empty>::push(const Element& element) noexcept
+{
+  return push_n(&element, 1) == 1;
+}
+
+template <typename T, T Empty>
+size_t SharedSPSCRingBuffer<T, Empty>::push_n(const Element* elements,
+                                              size_t n) noexcept
+{
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+
+  // See `SPSCRingBuffer::push_n`
+  n = std::min(n, m_size);
+  while (n && slot(w + n - 1).load(std::memory_order_acquire) != Empty)
+    n /= 2;
+  if (!n)
+    return 0;
+
+  for (size_t i = 1; i < n; ++i)
+    slot(w + i).store(elements[i], std::memory_order_relaxed);
+  slot(w).store(elements[0], std::memory_order_release);
+  m_write_index.store((w + n) & m_mask, std::memory_order_relaxed);
+
+  m_not_empty.notify();
+  return n;
+}
+
+template <typename T, T Empty>
+T SharedSPSCRingBuffer<T, Empty>::pop() noexcept
+{
+  Element element;
+  return pop_n(&element, 1) ? element : Empty;
+}
+
+template <typename T, T Empty>
+size_t SharedSPSCRingBuffer<T, Empty>::pop_n(Element* elements,
+                                             size_t max) noexcept
+{
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  size_t n = 0;
+  for (; n < max && n < m_size; ++n)
+  {
+    Element element = slot(r + n).load(std::memory_order_acquire);
+    if (element == Empty)
+      break;
+    elements[n] = element;
+  }
+
+  for (size_t i = 0; i < n; ++i)
+    slot(r + i).store(Empty, std::memory_order_release);
+  m_read_index.store((r + n) & m_mask, std::memory_order_relaxed);
+  return n;
+}
+
+template <typename T, T Empty>
+T SharedSPSCRingBuffer<T, Empty>::wait_pop() noexcept
+{
+  Element element;
+  while ((element = pop()) == Empty)
+  {
+    SharedEventCount::Key key = m_not_empty.prepare_wait();
+    if ((element = pop()) != Empty)
+    {
+      m_not_empty.cancel_wait();
+      break;
+    }
+    m_not_empty.commit_wait(key);
+  }
+  return element;
+}
+
+template <typename T, T Empty>
+std::atomic<T>& SharedSPSCRingBuffer<T, Empty>::slot(size_t index) noexcept
+{
+  return reinterpret_cast<std::atomic<Element>*>(this + 1)[index & m_mask];
+}
+
+template <typename T, T Empty>
+const std::atomic<T>&
+SharedSPSCRingBuffer<T, Empty>::slot(size_t index) const noexcept
+{
+  return reinterpret_cast<const std::atomic<Element>*>(this + 1)
+    [index & m_mask];
+}
+
+} // namespace ni
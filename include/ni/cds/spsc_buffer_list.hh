@@ -18,139 +18,310 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
 #include <ni/cds/spsc_linked_list.hh>
 
 namespace ni
 {
-
-template <typename T, T Empty = T(), typename Fill = T>
+/// \brief Unbounded single producer single consumer queue made of a list of
+///        `SPSCRingBuffer` segments
+///
+/// The producer moves on to a new segment when the current one is full and
+/// the consumer follows once it has drained it. Drained segments are handed
+/// back to the producer through a cache of `cache_size` segments.
+///
+/// The footprint adapts to the load:
+///
+/// * When the producer needs a segment and none is cached, i.e. the consumer
+///   is lagging behind, each new segment is twice as large as the previous
+///   one, up to `set_max_buffer_size()` elements.
+/// * Cached segments which have not been needed for `set_idle_period()` are
+///   freed by the producer, when it moves on to a new segment or calls
+///   `trim()`. The growth starts over from `buffer_size` afterwards.
+///
+/// \param T type of the elements, see `SPSCRingBuffer`
+/// \param Empty `empty` value of type T
+/// \param Fill see `SPSCRingBuffer`
+/// \param Allocator storage of the segments, see `HeapBufferAllocator` and
+///        `MappedBufferAllocator`
+template <typename T, T Empty = T(), typename Fill = T,
+          typename Allocator = HeapBufferAllocator>
 class SPSCBufferList
 {
-  using Buffer = SPSCRingBuffer<T, Empty, Fill>;
+  using Buffer = SPSCRingBuffer<T, Empty, Fill, Allocator>;
 
 public:
+  using Clock = std::chrono::steady_clock;
+
+  /// \param buffer_size number of elements of a segment, must be power of two
+  /// \param cache_size maximum number of cached segments
+  /// \param fill_cache whether to allocate the cached segments upfront
   SPSCBufferList(size_t buffer_size, size_t cache_size,
-                 bool fill_cache = false);
+                 bool fill_cache = false,
+                 const Allocator& allocator = Allocator());
+  SPSCBufferList(const SPSCBufferList&) = delete;
+  SPSCBufferList& operator=(const SPSCBufferList&) = delete;
   ~SPSCBufferList();
 
+  /// \brief Let new segments grow up to `max_buffer_size` elements (a power
+  ///        of two), `buffer_size` by default
+  ///
+  /// Not thread-safe, to be called before the producer starts.
+  void set_max_buffer_size(size_t max_buffer_size) noexcept;
+
+  /// \brief Free cached segments which have not been needed for `period`,
+  ///        zero (the default) never frees them
+  ///
+  /// Not thread-safe, to be called before the producer starts.
+  void set_idle_period(Clock::duration period) noexcept;
+
+  /// \return true if the list is empty, consumer only
   bool empty() const;
+
+  /// \brief Push new element, producer only
   void push(const T& element);
+  void push(T&& element);
+
+  /// \brief Push an element constructed from `args`, producer only
+  template <typename... Args>
+  void emplace(Args&&... args);
+
+  /// \brief Pop an element, consumer only
+  /// \return `Empty` if the list is empty
   T pop();
 
+  /// \brief Free the cached segments which have been idle for the idle
+  ///        period, producer only
+  void trim();
+
+  /// \return bytes reserved for the segments, in use or cached, as reported
+  ///         by the allocator (e.g. whole mappings)
+  size_t memory_usage() const noexcept;
+
 private:
+  // Owned by the consumer
   NI_CACHELINE_ALIGNED Buffer* m_buf_to_read;
+  Buffer* m_next_to_read;
+
+  // Owned by the producer
   NI_CACHELINE_ALIGNED Buffer* m_buf_to_write;
+  size_t m_next_buf_size;
+  // Lowest number of cached segments seen since `m_window_start`, as many
+  // segments have not been needed since then
+  size_t m_cache_low;
+  Clock::time_point m_window_start;
+
+  // Read-only once the producer has started
   const size_t m_buf_size;
+  size_t m_max_buf_size;
+  Clock::duration m_idle_period;
+  const Allocator m_allocator;
+
+  std::atomic<size_t> m_memory_usage;
   SPSCLinkedList<Buffer*> m_in_use;
   SPSCRingBuffer<Buffer*> m_cache;
 
-  Buffer* next_to_read();
-  Buffer* next_to_write(const size_t buf_size);
+  Buffer* next_to_write();
   void release(Buffer* buf);
-  void reset();
+  Buffer* create_buffer(size_t buf_size);
+  void destroy_buffer(Buffer* buf) noexcept;
+  size_t footprint(size_t buf_size) const noexcept;
 };
 
-template <typename T, T Empty, typename Fill>
-SPSCBufferList<T, Empty, Fill>::SPSCBufferList(size_t buffer_size,
-                                               size_t cache_size,
-                                               bool fill_cache)
-  : m_buf_to_read(new Buffer(buffer_size))
-  , m_buf_to_write(m_buf_to_read)
+template <typename T, T Empty, typename Fill, typename Allocator>
+SPSCBufferList<T, Empty, Fill, Allocator>::SPSCBufferList(
+  size_t buffer_size, size_t cache_size, bool fill_cache,
+  const Allocator& allocator)
+  : m_buf_to_read()
+  , m_next_to_read()
+  , m_buf_to_write()
+  , m_next_buf_size(buffer_size)
+  , m_cache_low()
+  , m_window_start(Clock::now())
   , m_buf_size(buffer_size)
+  , m_max_buf_size(buffer_size)
+  , m_idle_period(Clock::duration::zero())
+  , m_allocator(allocator)
+  , m_memory_usage()
   , m_in_use(cache_size)
   , m_cache(cache_size)
 {
+  m_buf_to_read = m_buf_to_write = create_buffer(buffer_size);
   if (fill_cache)
   {
     assert(buffer_size > 0);
     for (size_t i = 0; i < cache_size; ++i)
-      m_cache.push(new Buffer(buffer_size));
+      m_cache.push(create_buffer(buffer_size));
   }
 }
 
-template <typename T, T Empty, typename Fill>
-SPSCBufferList<T, Empty, Fill>::~SPSCBufferList()
+template <typename T, T Empty, typename Fill, typename Allocator>
+SPSCBufferList<T, Empty, Fill, Allocator>::~SPSCBufferList()
 {
-  if (m_buf_to_read)
-    delete m_buf_to_read;
+  destroy_buffer(m_buf_to_read);
+  if (m_next_to_read)
+    destroy_buffer(m_next_to_read);
 
   Buffer* buf;
   while ((buf = m_in_use.pop()))
-    delete buf;
+    destroy_buffer(buf);
 
   while ((buf = m_cache.pop()))
-    delete buf;
+    destroy_buffer(buf);
 }
 
-template <typename T, T Empty, typename Fill>
-bool SPSCBufferList<T, Empty, Fill>::empty() const
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::set_max_buffer_size(
+  size_t max_buffer_size) noexcept
 {
-  return m_buf_to_read->empty() && m_buf_to_read == m_buf_to_write;
+  assert(max_buffer_size >= m_buf_size);
+  m_max_buf_size = max_buffer_size;
 }
 
-template <typename T, T Empty, typename Fill>
-void SPSCBufferList<T, Empty, Fill>::push(const T& element)
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::set_idle_period(
+  Clock::duration period) noexcept
 {
-  if (!m_buf_to_write->available())
-    m_buf_to_write = next_to_write(m_buf_size);
+  m_idle_period = period;
+}
 
-  m_buf_to_write->push(element);
+template <typename T, T Empty, typename Fill, typename Allocator>
+bool SPSCBufferList<T, Empty, Fill, Allocator>::empty() const
+{
+  return m_buf_to_read->empty() && !m_next_to_read && m_in_use.empty();
 }
 
-template <typename T, T Empty, typename Fill>
-T SPSCBufferList<T, Empty, Fill>::pop()
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::push(const T& element)
 {
-  if (m_buf_to_read->empty())
+  if (!m_buf_to_write->push(element))
   {
-    if (m_buf_to_read == m_buf_to_write)
-      return Empty;
+    m_buf_to_write = next_to_write();
+    m_buf_to_write->push(element);
+  }
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::push(T&& element)
+{
+  // The segments hold atomic, hence trivially copyable, elements
+  push(static_cast<const T&>(element));
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+template <typename... Args>
+void SPSCBufferList<T, Empty, Fill, Allocator>::emplace(Args&&... args)
+{
+  push(T(std::forward<Args>(args)...));
+}
 
-    if (m_buf_to_read->empty())
+template <typename T, T Empty, typename Fill, typename Allocator>
+T SPSCBufferList<T, Empty, Fill, Allocator>::pop()
+{
+  T element;
+  while ((element = m_buf_to_read->pop()) == Empty)
+  {
+    if (!m_next_to_read)
     {
-      Buffer* next = next_to_read();
-      if (next)
-      {
-        release(m_buf_to_read);
-        m_buf_to_read = next;
-      }
+      m_next_to_read = m_in_use.pop();
+      if (!m_next_to_read)
+        return Empty;
+
+      // The producer has moved on, every element it pushed into the current
+      // segment is visible now
+      if ((element = m_buf_to_read->pop()) != Empty)
+        break;
     }
+    release(m_buf_to_read);
+    m_buf_to_read = m_next_to_read;
+    m_next_to_read = nullptr;
   }
-  return m_buf_to_read->pop();
+  return element;
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::trim()
+{
+  if (m_idle_period == Clock::duration::zero())
+    return;
+
+  Clock::time_point now = Clock::now();
+  if (now - m_window_start < m_idle_period)
+    return;
+
+  size_t freed = 0;
+  Buffer* buf;
+  for (; freed < m_cache_low && (buf = m_cache.pop()); ++freed)
+    destroy_buffer(buf);
+  if (freed)
+    m_next_buf_size = m_buf_size;
+
+  m_window_start = now;
+  m_cache_low = m_cache.len();
 }
 
-template <typename T, T Empty, typename Fill>
-typename SPSCBufferList<T, Empty, Fill>::Buffer*
-SPSCBufferList<T, Empty, Fill>::next_to_read()
+template <typename T, T Empty, typename Fill, typename Allocator>
+size_t SPSCBufferList<T, Empty, Fill, Allocator>::memory_usage() const
+  noexcept
 {
-  return m_in_use.pop();
+  return m_memory_usage.load(std::memory_order_relaxed);
 }
 
-template <typename T, T Empty, typename Fill>
-typename SPSCBufferList<T, Empty, Fill>::Buffer*
-SPSCBufferList<T, Empty, Fill>::next_to_write(const size_t buf_size)
+template <typename T, T Empty, typename Fill, typename Allocator>
+typename SPSCBufferList<T, Empty, Fill, Allocator>::Buffer*
+SPSCBufferList<T, Empty, Fill, Allocator>::next_to_write()
 {
   Buffer* buf = m_cache.pop();
-  if (!buf)
-    buf = new Buffer(buf_size);
+  if (buf)
+  {
+    m_cache_low = std::min(m_cache_low, m_cache.len());
+  }
+  else
+  {
+    buf = create_buffer(m_next_buf_size);
+    m_next_buf_size = std::min(m_next_buf_size * 2, m_max_buf_size);
+    m_cache_low = 0;
+  }
 
   m_in_use.push(buf);
+  trim();
   return buf;
 }
 
-template <typename T, T Empty, typename Fill>
-void SPSCBufferList<T, Empty, Fill>::release(Buffer* buf)
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::release(Buffer* buf)
 {
   buf->reset();
   if (!m_cache.push(buf))
-    delete buf;
+    destroy_buffer(buf);
 }
 
-template <typename T, T Empty, typename Fill>
-void SPSCBufferList<T, Empty, Fill>::reset()
+template <typename T, T Empty, typename Fill, typename Allocator>
+typename SPSCBufferList<T, Empty, Fill, Allocator>::Buffer*
+SPSCBufferList<T, Empty, Fill, Allocator>::create_buffer(size_t buf_size)
 {
-  Buffer* buf;
-  while ((buf = m_in_use.pop()))
-    release(buf);
+  Buffer* buf = new Buffer(buf_size, m_allocator);
+  m_memory_usage.fetch_add(footprint(buf_size), std::memory_order_relaxed);
+  return buf;
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCBufferList<T, Empty, Fill, Allocator>::destroy_buffer(
+  Buffer* buf) noexcept
+{
+  m_memory_usage.fetch_sub(footprint(buf->size()), std::memory_order_relaxed);
+  delete buf;
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+size_t SPSCBufferList<T, Empty, Fill, Allocator>::footprint(
+  size_t buf_size) const noexcept
+{
+  return sizeof(Buffer) + m_allocator.reserved_size(sizeof(T) * buf_size);
 }
 
 } // namespace ni
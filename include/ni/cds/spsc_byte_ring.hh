@@ -0,0 +1,167 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+
+#include <ni/cache_locality.hh>
+#include <ni/memory/double_mapped_buffer.hh>
+
+namespace ni
+{
+/// \brief Wait-free single producer single consumer ring of bytes
+///
+/// Records of any size are written and read in place: the producer reserves
+/// a writable span, serializes into it and commits the bytes written, the
+/// consumer peeks at the readable span, processes it (e.g. `write(2)`s it
+/// out) and consumes the bytes processed. The ring lives in a
+/// `DoubleMappedBuffer`, so spans are always contiguous, wrap-around
+/// included.
+///
+/// The indices grow monotonically and are published with release stores,
+/// each side caches the index of the other side and only reloads it when the
+/// cached value does not leave enough room (resp. data).
+class SPSCByteRing
+{
+public:
+  struct Span
+  {
+    char* data;
+    size_t size;
+  };
+
+  /// \brief Create an empty ring
+  /// \param size capacity in bytes, must be a power of two and a multiple of
+  ///        the page size
+  explicit SPSCByteRing(size_t size);
+  SPSCByteRing(const SPSCByteRing&) = delete;
+  SPSCByteRing& operator=(const SPSCByteRing&) = delete;
+
+  /// \return capacity in bytes
+  size_t size() const noexcept;
+
+  /// \return number of bytes committed and not consumed yet
+  size_t len() const noexcept;
+
+  /// \return true if there are no bytes to read
+  bool empty() const noexcept;
+
+  /// \brief Writable space at the tail, producer only
+  /// \return all the free space if there are at least `n` free bytes, an
+  ///         empty span (null data) otherwise
+  Span reserve(size_t n) noexcept;
+
+  /// \brief Publish the first `n` bytes of the reserved span, producer only
+  void commit(size_t n) noexcept;
+
+  /// \brief Readable data at the head, consumer only
+  /// \return all the committed bytes, an empty span if there are none
+  Span peek() noexcept;
+
+  /// \brief Release the first `n` bytes of the readable span, consumer only
+  void consume(size_t n) noexcept;
+
+private:
+  // Read-only, kept apart from the indices which are written all the time
+  const size_t m_mask;
+  DoubleMappedBuffer m_buffer;
+
+  // Owned by the producer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_write_index;
+  size_t m_read_cache;
+
+  // Owned by the consumer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_read_index;
+  size_t m_write_cache;
+
+  // Fill out the cache line to prevent false sharing with other allocations
+  NI_PADDING_AFTER(sizeof(m_read_index) + sizeof(m_write_cache));
+};
+
+inline SPSCByteRing::SPSCByteRing(size_t size)
+  : m_mask(size - 1)
+  , m_buffer(size)
+  , m_write_index()
+  , m_read_cache()
+  , m_read_index()
+  , m_write_cache()
+{
+  assert((size & (size - 1)) == 0 && "size must be a power of two");
+}
+
+inline size_t SPSCByteRing::size() const noexcept
+{
+  return m_buffer.size();
+}
+
+inline size_t SPSCByteRing::len() const noexcept
+{
+  size_t r = m_read_index.load(std::memory_order_acquire);
+  size_t w = m_write_index.load(std::memory_order_acquire);
+  return w - r;
+}
+
+inline bool SPSCByteRing::empty() const noexcept
+{
+  return len() == 0;
+}
+
+inline SPSCByteRing::Span SPSCByteRing::reserve(size_t n) noexcept
+{
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+  size_t available = size() - (w - m_read_cache);
+  if (available < n)
+  {
+    m_read_cache = m_read_index.load(std::memory_order_acquire);
+    available = size() - (w - m_read_cache);
+    if (available < n)
+      return Span{nullptr, 0};
+  }
+  return Span{m_buffer.data() + (w & m_mask), available};
+}
+
+inline void SPSCByteRing::commit(size_t n) noexcept
+{
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+  assert(n <= size() - (w - m_read_cache) && "commit() exceeds reserve()");
+  m_write_index.store(w + n, std::memory_order_release);
+}
+
+inline SPSCByteRing::Span SPSCByteRing::peek() noexcept
+{
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  if (r == m_write_cache)
+  {
+    m_write_cache = m_write_index.load(std::memory_order_acquire);
+    if (r == m_write_cache)
+      return Span{nullptr, 0};
+  }
+  return Span{m_buffer.data() + (r & m_mask), m_write_cache - r};
+}
+
+inline void SPSCByteRing::consume(size_t n) noexcept
+{
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  assert(n <= m_write_cache - r && "consume() exceeds peek()");
+  m_read_index.store(r + n, std::memory_order_release);
+}
+
+} // namespace ni
@@ -0,0 +1,194 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <type_traits>
+
+#include <ni/cache_locality.hh>
+
+namespace ni
+{
+template <typename T, typename Tag>
+class SPSCIntrusiveList;
+
+/// \brief Link embedded in the elements of a `SPSCIntrusiveList`, by
+///        inheriting from it
+///
+/// Copying an element does not copy its link.
+///
+/// \param Tag distinguishes several hooks, so that an element may be in
+///        several lists at once
+template <typename Tag = void>
+class SPSCIntrusiveListHook
+{
+public:
+  SPSCIntrusiveListHook() noexcept;
+  SPSCIntrusiveListHook(const SPSCIntrusiveListHook&) noexcept;
+  SPSCIntrusiveListHook& operator=(const SPSCIntrusiveListHook&) noexcept;
+
+private:
+  template <typename T, typename ListTag>
+  friend class SPSCIntrusiveList;
+
+  std::atomic<SPSCIntrusiveListHook*> m_next;
+};
+
+/// \brief Single producer single consumer intrusive linked list
+///
+/// The elements embed their link (`SPSCIntrusiveListHook`), so pushing and
+/// popping never allocate. The list does not own the elements: an element
+/// belongs to the list from the time it is pushed until it is popped, and
+/// may be pushed again (or destroyed) as soon as it is popped.
+///
+/// The list keeps a stub node of its own: when the consumer is about to pop
+/// the last element, it links the stub after it so the element is not
+/// needed as the head of the list anymore. Hence the tail is exchanged
+/// atomically by both sides, which is the only read-modify-write operation
+/// of the list.
+///
+/// A pop which overlaps a push may miss the element being pushed (and
+/// report an empty list) until the push completes.
+///
+/// **Reference**
+///
+/// * D. Vyukov. Intrusive MPSC node-based queue.
+///   http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+///
+/// \param T type of the elements, inheriting from
+///        `SPSCIntrusiveListHook<Tag>`
+template <typename T, typename Tag = void>
+class SPSCIntrusiveList
+{
+public:
+  using Element = T;
+  using Hook = SPSCIntrusiveListHook<Tag>;
+
+  SPSCIntrusiveList() noexcept;
+  SPSCIntrusiveList(const SPSCIntrusiveList&) = delete;
+  SPSCIntrusiveList& operator=(const SPSCIntrusiveList&) = delete;
+
+  /// \return true if the list is empty, consumer only
+  bool empty() const noexcept;
+
+  /// \brief Push an element, producer only
+  /// \param element element not in the list
+  void push(Element* element) noexcept;
+
+  /// \brief Pop the oldest element, consumer only
+  /// \return nullptr if the list is empty
+  Element* pop() noexcept;
+
+private:
+  // Exchanged by the producer, and by the consumer to link the stub
+  NI_CACHELINE_ALIGNED std::atomic<Hook*> m_tail;
+  // Owned by the consumer
+  NI_CACHELINE_ALIGNED Hook* m_head;
+  Hook m_stub;
+
+  NI_PADDING_AFTER(sizeof(m_head) + sizeof(m_stub));
+
+  void link(Hook* hook) noexcept;
+  static Element* element_of(Hook* hook) noexcept;
+};
+
+template <typename Tag>
+SPSCIntrusiveListHook<Tag>::SPSCIntrusiveListHook() noexcept : m_next()
+{
+}
+
+template <typename Tag>
+SPSCIntrusiveListHook<Tag>::SPSCIntrusiveListHook(
+  const SPSCIntrusiveListHook&) noexcept : m_next()
+{
+}
+
+template <typename Tag>
+SPSCIntrusiveListHook<Tag>& SPSCIntrusiveListHook<Tag>::
+operator=(const SPSCIntrusiveListHook&) noexcept
+{
+  return *this;
+}
+
+template <typename T, typename Tag>
+SPSCIntrusiveList<T, Tag>::SPSCIntrusiveList() noexcept
+  : m_tail(&m_stub)
+  , m_head(&m_stub)
+  , m_stub()
+{
+}
+
+template <typename T, typename Tag>
+bool SPSCIntrusiveList<T, Tag>::empty() const noexcept
+{
+  return m_head == &m_stub &&
+         m_stub.m_next.load(std::memory_order_acquire) == nullptr;
+}
+
+template <typename T, typename Tag>
+void SPSCIntrusiveList<T, Tag>::push(Element* element) noexcept
+{
+  link(element);
+}
+
+template <typename T, typename Tag>
+T* SPSCIntrusiveList<T, Tag>::pop() noexcept
+{
+  Hook* head = m_head;
+  Hook* next = head->m_next.load(std::memory_order_acquire);
+  if (head == &m_stub)
+  {
+    if (!next)
+      return nullptr;
+    m_head = head = next;
+    next = next->m_next.load(std::memory_order_acquire);
+  }
+
+  if (!next)
+  {
+    // `head` is the last element, unless a push is in progress
+    if (head != m_tail.load(std::memory_order_acquire))
+      return nullptr;
+    link(&m_stub);
+    next = head->m_next.load(std::memory_order_acquire);
+    if (!next)
+      return nullptr;
+  }
+
+  m_head = next;
+  return element_of(head);
+}
+
+template <typename T, typename Tag>
+void SPSCIntrusiveList<T, Tag>::link(Hook* hook) noexcept
+{
+  hook->m_next.store(nullptr, std::memory_order_relaxed);
+  Hook* prev = m_tail.exchange(hook, std::memory_order_acq_rel);
+  prev->m_next.store(hook, std::memory_order_release);
+}
+
+template <typename T, typename Tag>
+T* SPSCIntrusiveList<T, Tag>::element_of(Hook* hook) noexcept
+{
+  static_assert(std::is_base_of<Hook, Element>::value,
+                "Elements must inherit from SPSCIntrusiveListHook<Tag>");
+  return static_cast<Element*>(hook);
+}
+
+} // namespace ni
@@ -30,6 +30,7 @@ public:
   explicit SPSCLinkedList(size_t cache_size = NI_CACHELINE_SIZE<size_t>,
                           bool fill_cache = false);
   ~SPSCLinkedList();
+  bool empty() const;
   void push(const T& element);
   T pop();
 
@@ -46,10 +47,8 @@ private:
 
   NI_CACHELINE_ALIGNED Node* m_head;
   NI_CACHELINE_ALIGNED Node* m_tail;
+  // Cache line aligned and padded, no false sharing with other allocations
   SPSCPtrRingBuffer<Node> m_cache;
-
-  // Fill out the cache line to prevent false sharing with other allocations
-  NI_PADDING_AFTER(sizeof(m_cache));
 };
 
 template <typename T, T Empty, typename Fill>
@@ -111,12 +110,26 @@ SPSCLinkedList<T, Empty, Fill>::~SPSCLinkedList()
     delete m_head;
 }
 
+template <typename T, T Empty, typename Fill>
+bool SPSCLinkedList<T, Empty, Fill>::empty() const
+{
+  return !m_head->next.load(std::memory_order_acquire);
+}
+
 template <typename T, T Empty, typename Fill>
 void SPSCLinkedList<T, Empty, Fill>::push(const T& element)
 {
   Node* n = m_cache.pop();
-  if (!n)
+  if (n)
+  {
+    // Recycled nodes still hold the links and data of their previous use
+    n->data = element;
+    n->next.store(nullptr, std::memory_order_relaxed);
+  }
+  else
+  {
     n = new Node(element);
+  }
 
   m_tail->next.store(n, std::memory_order_release);
   m_tail = n;
@@ -0,0 +1,248 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <ni/cache_locality.hh>
+#include <ni/memory/buffer_allocator.hh>
+
+namespace ni
+{
+/// \brief Wait-free single producer single consumer bounded queue storing the
+///        elements inline
+///
+/// Unlike `SPSCRingBuffer`, the elements need neither be atomic nor have an
+/// empty value: they are constructed in place in the buffer and the producer
+/// and the consumer synchronize through the tail and head indices. Each side
+/// keeps a private copy of the index of the other side and only reloads it
+/// when the copy says the queue is full (resp. empty), so the index cache
+/// lines are not bounced at every operation.
+///
+/// **Reference**
+///
+/// * L. Lamport. Specifying Concurrent Program Modules. ACM TOPLAS, 1983.
+/// * P. P. C. Lee, T. Bu, and G. Chandranmenon. A Lock-Free, Cache-Efficient
+///   Multi-Core Synchronization Mechanism for Line-Rate Network Traffic
+///   Monitoring. IPDPS '10.
+///
+/// \param T type of the elements
+/// \param Allocator storage of the elements, see `HeapBufferAllocator` and
+///        `MappedBufferAllocator`
+template <typename T, typename Allocator = HeapBufferAllocator>
+class SPSCQueue
+{
+public:
+  using Element = T;
+
+  /// \brief Create a new queue
+  /// \param size the capacity of the queue, must be power of two
+  /// \param allocator allocator of the elements
+  explicit SPSCQueue(size_t size, const Allocator& allocator = Allocator());
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+  ~SPSCQueue();
+
+  /// \return capacity of the queue
+  size_t size() const noexcept;
+
+  /// \return number of elements in the queue
+  size_t len() const noexcept;
+
+  /// \return true if the queue is empty
+  bool empty() const noexcept;
+
+  /// \brief Construct an element in place at the tail, producer only
+  /// \return false if the queue is full
+  template <typename... Args>
+  bool emplace(Args&&... args);
+
+  /// \brief Push new element at the tail, producer only
+  /// \return false if the queue is full
+  template <typename U>
+  bool push(U&& element);
+
+  /// \brief Element at the head, consumer only
+  /// \return nullptr if the queue is empty
+  Element* front() noexcept;
+
+  /// \brief Destroy the element at the head, consumer only
+  ///
+  /// The queue must not be empty, i.e. `front()` returned an element.
+  void pop() noexcept;
+
+  /// \brief Pop the element at the head, consumer only
+  /// \param [out] element Location to move the popped element to
+  /// \return false if the queue is empty
+  bool pop(Element* element);
+
+private:
+  using Slot =
+    typename std::aligned_storage<sizeof(Element), alignof(Element)>::type;
+
+  // Read-only, kept apart from the indices which are written all the time
+  const size_t m_size;
+  const size_t m_mask;
+  Slot* m_buf;
+  Allocator m_allocator;
+
+  // Owned by the producer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_tail;
+  size_t m_head_cache;
+
+  // Owned by the consumer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_head;
+  size_t m_tail_cache;
+
+  // Fill out the cache line to prevent false sharing with other allocations
+  NI_PADDING_AFTER(sizeof(m_head) + sizeof(m_tail_cache));
+
+  size_t buffer_size() const noexcept;
+  Element* slot(size_t index) const noexcept;
+};
+
+template <typename T, typename Allocator>
+SPSCQueue<T, Allocator>::SPSCQueue(size_t size, const Allocator& allocator)
+  : m_size(size)
+  , m_mask(size - 1)
+  , m_buf()
+  , m_allocator(allocator)
+  , m_tail()
+  , m_head_cache()
+  , m_head()
+  , m_tail_cache()
+{
+  assert(size && (size & (size - 1)) == 0 && "size must be a power of two");
+
+  m_buf = static_cast<Slot*>(m_allocator.allocate(
+    buffer_size(), std::max(NI_CACHELINE_SIZE<size_t>, alignof(Slot))));
+}
+
+template <typename T, typename Allocator>
+SPSCQueue<T, Allocator>::~SPSCQueue()
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  for (; head != tail; ++head)
+    slot(head)->~Element();
+  m_allocator.deallocate(m_buf, buffer_size());
+}
+
+template <typename T, typename Allocator>
+size_t SPSCQueue<T, Allocator>::size() const noexcept
+{
+  return m_size;
+}
+
+template <typename T, typename Allocator>
+size_t SPSCQueue<T, Allocator>::len() const noexcept
+{
+  size_t head = m_head.load(std::memory_order_acquire);
+  size_t tail = m_tail.load(std::memory_order_acquire);
+  return tail - head;
+}
+
+template <typename T, typename Allocator>
+bool SPSCQueue<T, Allocator>::empty() const noexcept
+{
+  return len() == 0;
+}
+
+template <typename T, typename Allocator>
+template <typename... Args>
+bool SPSCQueue<T, Allocator>::emplace(Args&&... args)
+{
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  if (tail - m_head_cache == m_size)
+  {
+    m_head_cache = m_head.load(std::memory_order_acquire);
+    if (tail - m_head_cache == m_size)
+      return false;
+  }
+
+  // Nothing is published if the constructor throws
+  new (slot(tail)) Element(std::forward<Args>(args)...);
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T, typename Allocator>
+template <typename U>
+bool SPSCQueue<T, Allocator>::push(U&& element)
+{
+  return emplace(std::forward<U>(element));
+}
+
+template <typename T, typename Allocator>
+T* SPSCQueue<T, Allocator>::front() noexcept
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  if (head == m_tail_cache)
+  {
+    m_tail_cache = m_tail.load(std::memory_order_acquire);
+    if (head == m_tail_cache)
+      return nullptr;
+  }
+  return slot(head);
+}
+
+template <typename T, typename Allocator>
+void SPSCQueue<T, Allocator>::pop() noexcept
+{
+  size_t head = m_head.load(std::memory_order_relaxed);
+  assert(head != m_tail_cache && "pop() on an empty queue");
+
+  slot(head)->~Element();
+  m_head.store(head + 1, std::memory_order_release);
+}
+
+template <typename T, typename Allocator>
+bool SPSCQueue<T, Allocator>::pop(Element* element)
+{
+  Element* head = front();
+  if (!head)
+    return false;
+
+  *element = std::move(*head);
+  pop();
+  return true;
+}
+
+template <typename T, typename Allocator>
+size_t SPSCQueue<T, Allocator>::buffer_size() const noexcept
+{
+  // Whole cache lines, so that the last slot does not share its line with
+  // another allocation
+  size_t bytes = sizeof(Slot) * m_size;
+  return (bytes + NI_CACHELINE_SIZE<size_t> - 1) &
+         ~(NI_CACHELINE_SIZE<size_t> - 1);
+}
+
+template <typename T, typename Allocator>
+T* SPSCQueue<T, Allocator>::slot(size_t index) const noexcept
+{
+  return reinterpret_cast<Element*>(&m_buf[index & m_mask]);
+}
+
+} // namespace ni
@@ -18,15 +18,15 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstdio>
-#include <cstdlib>
 #include <cstring>
-#include <system_error>
 #include <type_traits>
 
 #include <ni/cache_locality.hh>
+#include <ni/memory/buffer_allocator.hh>
 #include <ni/mpl/unit.hh>
 
 namespace ni
@@ -60,6 +60,10 @@ struct SPSCRingBufferFiller<
 
 /// \brief Wait-free single producer single consumer ring buffer
 ///
+/// Producer and consumer synchronize through the slots only: an `Empty` slot
+/// is free. The write and read indices are private to the producer and the
+/// consumer respectively and are accessed without ordering constraints.
+///
 /// **Reference**
 ///
 /// * Massimo Torquati, "Single-Producer/Single-Consumer Queue on Shared Cache
@@ -75,15 +79,20 @@ struct SPSCRingBufferFiller<
 /// \param T type of the elements
 /// \param Empty `empty` or `null` value of type T (defaults to `T()`)
 /// \param Fill
+/// \param Allocator storage of the slots, see `HeapBufferAllocator` and
+///        `MappedBufferAllocator`
 ///
-template <typename T, T Empty = T(), typename Fill = T>
+template <typename T, T Empty = T(), typename Fill = T,
+          typename Allocator = HeapBufferAllocator>
 class SPSCRingBuffer
 {
 public:
   /// \brief Create a new ring buffer
   /// \param size the maximum size of the ring buffer, must be power of two (
   ///        and greater than 1 )
-  explicit SPSCRingBuffer(size_t size);
+  /// \param allocator allocator of the slots
+  explicit SPSCRingBuffer(size_t size,
+                          const Allocator& allocator = Allocator());
   SPSCRingBuffer(const SPSCRingBuffer&) = delete;
   SPSCRingBuffer& operator==(const SPSCRingBuffer&) = delete;
   ~SPSCRingBuffer();
@@ -105,10 +114,25 @@ public:
   /// \return whether the element was pushed into the ring buffer
   bool push(const T& element);
 
+  /// \brief Push up to `n` elements
+  ///
+  /// Checks for free slots with a single load when there is room for the
+  /// whole run, and publishes it with a single release store: the other
+  /// slots are written first and become visible along with the first one.
+  ///
+  /// \param elements elements to push, none of them is `Empty`
+  /// \return number of elements pushed, a prefix of `elements`
+  size_t push_n(const T* elements, size_t n);
+
   /// \brief Pop an element from the ring buffer
   /// \return nullptr the ring buffer is empty
   T pop();
 
+  /// \brief Pop up to `max` elements
+  /// \param [out] elements location to store the popped elements
+  /// \return number of elements popped
+  size_t pop_n(T* elements, size_t max);
+
   /// \return the next element to be popped without removing it
   T top() const;
 
@@ -116,56 +140,60 @@ public:
   void reset();
 
 private:
-  NI_CACHELINE_ALIGNED std::atomic<size_t> m_write_index;
-  NI_CACHELINE_ALIGNED std::atomic<size_t> m_read_index;
+  // Read-only, kept apart from the indices which are written all the time
   const size_t m_size;
   const size_t m_mask;
   std::atomic<T>* m_buf;
+  Allocator m_allocator;
+
+  // Owned by the producer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_write_index;
+  // Owned by the consumer
+  NI_CACHELINE_ALIGNED std::atomic<size_t> m_read_index;
 
   // Fill out the cache line to prevent false sharing with other allocations
-  NI_PADDING_AFTER(sizeof(m_size) + sizeof(m_mask) + sizeof(m_buf));
+  NI_PADDING_AFTER(sizeof(m_read_index));
 
   using Filler = details::SPSCRingBufferFiller<T, Empty, Fill>;
   void clear(Unit, bool initialized = true);
   void clear(int value, bool initialized = true);
 };
 
-template <typename T, T Empty, typename Fill>
-SPSCRingBuffer<T, Empty, Fill>::SPSCRingBuffer(size_t size)
-  : m_write_index()
-  , m_read_index()
-  , m_size(size)
+template <typename T, T Empty, typename Fill, typename Allocator>
+SPSCRingBuffer<T, Empty, Fill, Allocator>::SPSCRingBuffer(
+  size_t size, const Allocator& allocator)
+  : m_size(size)
   , m_mask(size - 1)
   , m_buf()
+  , m_allocator(allocator)
+  , m_write_index()
+  , m_read_index()
 {
   assert((size > 1) && (size & (size - 1)) == 0 &&
          "size must be a power of two");
 
-  int rc = posix_memalign(reinterpret_cast<void**>(&m_buf),
-                          NI_CACHELINE_SIZE<size_t>, sizeof(T) * size);
-  if (rc)
-    throw std::system_error(rc, std::system_category(), __func__);
-
+  m_buf = static_cast<std::atomic<T>*>(
+    m_allocator.allocate(sizeof(T) * size, NI_CACHELINE_SIZE<size_t>));
   clear(Filler::value, false);
 }
 
-template <typename T, T Empty, typename Fill>
-SPSCRingBuffer<T, Empty, Fill>::~SPSCRingBuffer()
+template <typename T, T Empty, typename Fill, typename Allocator>
+SPSCRingBuffer<T, Empty, Fill, Allocator>::~SPSCRingBuffer()
 {
-  delete[] m_buf;
+  m_allocator.deallocate(m_buf, sizeof(T) * m_size);
 }
 
-template <typename T, T Empty, typename Fill>
-size_t SPSCRingBuffer<T, Empty, Fill>::size() const
+template <typename T, T Empty, typename Fill, typename Allocator>
+size_t SPSCRingBuffer<T, Empty, Fill, Allocator>::size() const
 {
   return m_size;
 }
 
-template <typename T, T Empty, typename Fill>
-size_t SPSCRingBuffer<T, Empty, Fill>::len() const
+template <typename T, T Empty, typename Fill, typename Allocator>
+size_t SPSCRingBuffer<T, Empty, Fill, Allocator>::len() const
 {
-  size_t w = m_write_index;
-  size_t r = m_read_index;
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+  size_t r = m_read_index.load(std::memory_order_relaxed);
   if (w > r)
     return w - r;
   if (w < r)
@@ -175,56 +203,107 @@ size_t SPSCRingBuffer<T, Empty, Fill>::len() const
   return m_size;
 }
 
-template <typename T, T Empty, typename Fill>
-bool SPSCRingBuffer<T, Empty, Fill>::empty() const
+template <typename T, T Empty, typename Fill, typename Allocator>
+bool SPSCRingBuffer<T, Empty, Fill, Allocator>::empty() const
 {
-  return m_buf[m_read_index].load(std::memory_order_acquire) == Empty;
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  return m_buf[r].load(std::memory_order_acquire) == Empty;
 }
 
-template <typename T, T Empty, typename Fill>
-bool SPSCRingBuffer<T, Empty, Fill>::available() const
+template <typename T, T Empty, typename Fill, typename Allocator>
+bool SPSCRingBuffer<T, Empty, Fill, Allocator>::available() const
 {
-  return m_buf[m_write_index].load(std::memory_order_acquire) == Empty;
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+  return m_buf[w].load(std::memory_order_acquire) == Empty;
 }
 
-template <typename T, T Empty, typename Fill>
-bool SPSCRingBuffer<T, Empty, Fill>::push(const T& element)
+template <typename T, T Empty, typename Fill, typename Allocator>
+bool SPSCRingBuffer<T, Empty, Fill, Allocator>::push(const T& element)
 {
-  if (!available())
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+  if (m_buf[w].load(std::memory_order_acquire) != Empty)
     return false;
 
-  m_buf[m_write_index].store(element, std::memory_order_release);
-  m_write_index = (m_write_index + 1) & m_mask;
+  m_buf[w].store(element, std::memory_order_release);
+  m_write_index.store((w + 1) & m_mask, std::memory_order_relaxed);
   return true;
 }
 
-template <typename T, T Empty, typename Fill>
-T SPSCRingBuffer<T, Empty, Fill>::pop()
+template <typename T, T Empty, typename Fill, typename Allocator>
+size_t SPSCRingBuffer<T, Empty, Fill, Allocator>::push_n(const T* elements,
+                                                        size_t n)
+{
+  size_t w = m_write_index.load(std::memory_order_relaxed);
+
+  // The consumer frees the slots in order, if the last slot of the run is
+  // free so are the others. Halve the run until it fits.
+  n = std::min(n, m_size);
+  while (n && m_buf[(w + n - 1) & m_mask].load(std::memory_order_acquire) !=
+                Empty)
+    n /= 2;
+  if (!n)
+    return 0;
+
+  // The consumer reads the slots in order too, storing the first one last
+  // publishes the whole run
+  for (size_t i = 1; i < n; ++i)
+    m_buf[(w + i) & m_mask].store(elements[i], std::memory_order_relaxed);
+  m_buf[w].store(elements[0], std::memory_order_release);
+  m_write_index.store((w + n) & m_mask, std::memory_order_relaxed);
+  return n;
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+T SPSCRingBuffer<T, Empty, Fill, Allocator>::pop()
 {
-  T element = m_buf[m_read_index].load(std::memory_order_acquire);
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  T element = m_buf[r].load(std::memory_order_acquire);
   if (element == Empty)
     return Empty;
 
-  m_buf[m_read_index].store(Empty, std::memory_order_release);
-  m_read_index = (m_read_index + 1) & m_mask;
+  m_buf[r].store(Empty, std::memory_order_release);
+  m_read_index.store((r + 1) & m_mask, std::memory_order_relaxed);
   return element;
 }
 
-template <typename T, T Empty, typename Fill>
-T SPSCRingBuffer<T, Empty, Fill>::top() const
+template <typename T, T Empty, typename Fill, typename Allocator>
+size_t SPSCRingBuffer<T, Empty, Fill, Allocator>::pop_n(T* elements, size_t max)
 {
-  return m_buf[m_read_index].load(std::memory_order_acquire);
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  size_t n = 0;
+  for (; n < max && n < m_size; ++n)
+  {
+    T element = m_buf[(r + n) & m_mask].load(std::memory_order_acquire);
+    if (element == Empty)
+      break;
+    elements[n] = element;
+  }
+
+  // Free the slots once they have all been read, the producer may check any
+  // of them
+  for (size_t i = 0; i < n; ++i)
+    m_buf[(r + i) & m_mask].store(Empty, std::memory_order_release);
+  m_read_index.store((r + n) & m_mask, std::memory_order_relaxed);
+  return n;
 }
 
-template <typename T, T Empty, typename Fill>
-void SPSCRingBuffer<T, Empty, Fill>::reset()
+template <typename T, T Empty, typename Fill, typename Allocator>
+T SPSCRingBuffer<T, Empty, Fill, Allocator>::top() const
 {
-  m_read_index = m_write_index = 0;
+  size_t r = m_read_index.load(std::memory_order_relaxed);
+  return m_buf[r].load(std::memory_order_acquire);
+}
+
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCRingBuffer<T, Empty, Fill, Allocator>::reset()
+{
+  m_read_index.store(0, std::memory_order_relaxed);
+  m_write_index.store(0, std::memory_order_relaxed);
   clear(Filler::value);
 }
 
-template <typename T, T Empty, typename Fill>
-void SPSCRingBuffer<T, Empty, Fill>::clear(Unit, bool initialized)
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCRingBuffer<T, Empty, Fill, Allocator>::clear(Unit, bool initialized)
 {
   if (!initialized)
     new (m_buf) std::atomic<T>[m_size]
@@ -234,10 +313,14 @@ void SPSCRingBuffer<T, Empty, Fill>::clear(Unit, bool initialized)
     m_buf[i].store(Empty, std::memory_order_release);
 }
 
-template <typename T, T Empty, typename Fill>
-void SPSCRingBuffer<T, Empty, Fill>::clear(int value, bool)
+template <typename T, T Empty, typename Fill, typename Allocator>
+void SPSCRingBuffer<T, Empty, Fill, Allocator>::clear(int value, bool)
 {
-  memset(m_buf, value, sizeof(T) * m_size);
+  // The atomics are plain storage for `T`, filling them bytewise is valid
+  static_assert(std::is_trivially_destructible<std::atomic<T>>::value &&
+                  std::is_standard_layout<std::atomic<T>>::value,
+                "std::atomic<T> must be layout compatible with T");
+  memset(static_cast<void*>(m_buf), value, sizeof(T) * m_size);
 }
 
 /// \brief Convenient template alias for pointers
@@ -0,0 +1,347 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <utility>
+
+#include <ni/cache_locality.hh>
+#include <ni/cds/queue.hh>
+#include <ni/hazard_pointers.hh>
+#include <ni/memory/node_pool.hh>
+#include <ni/random.hh>
+#include <ni/tagged_ptr.hh>
+#include <ni/wide_tagged_ptr.hh>
+
+namespace ni
+{
+/// \brief MPMC Treiber lock-free stack with an optional elimination array
+///
+/// When a CAS on the top of the stack fails, a pusher may offer its node in a
+/// random slot of the elimination array for a short while, and a popper may
+/// take a node offered there. Such a push/pop pair cancels out without
+/// touching the top of the stack, which keeps the stack scalable under
+/// contention. Popped nodes are retired to `HazardPointers`.
+///
+/// The stack implements the `Queue` interface (with LIFO order), the state is
+/// the tag of the top pointer so it can be used as a backend of
+/// `LLDynamicDistributed`.
+///
+/// **Reference**
+///
+/// * R. K. Treiber. Systems Programming: Coping with Parallelism. Technical
+///   Report RJ 5118, IBM Almaden Research Center, 1986.
+/// * D. Hendler, N. Shavit, and L. Yerushalmi. A Scalable Lock-free Stack
+///   Algorithm. SPAA '04.
+///
+/// \param T type of the elements
+/// \param NodeAllocator allocation policy of the nodes, see
+///        `HeapNodeAllocator` and `NodePool`
+/// \param PtrTraits representation of the links, see `TaggedPtrTraits` and
+///        `WideTaggedPtrTraits`
+template <typename T,
+          template <typename> class NodeAllocator = HeapNodeAllocator,
+          typename PtrTraits = TaggedPtrTraits>
+class TreiberStack : public Queue<TreiberStack<T, NodeAllocator, PtrTraits>, T>
+{
+public:
+  using Element = T;
+  using State = typename PtrTraits::Tag;
+
+  /// Number of polls of an offered node before it is withdrawn
+  static constexpr size_t ELIMINATION_SPINS = 64;
+
+  class Node
+  {
+  public:
+    Element value;
+    Node* next;
+
+    explicit Node(const Element& item);
+    explicit Node(Element&& item);
+  };
+
+  /// \brief Create an empty stack
+  /// \param elimination_size number of slots of the elimination array, 0
+  ///        disables elimination
+  explicit TreiberStack(size_t elimination_size = 0);
+  TreiberStack(const TreiberStack&) = delete;
+  TreiberStack& operator=(const TreiberStack&) = delete;
+  ~TreiberStack();
+
+  /// \return true if the stack is empty
+  bool empty() const noexcept;
+
+  /// \brief Push new element onto the stack
+  ///
+  /// \param element Element to push
+  template <typename U>
+  bool push(U&& element);
+
+  State tail_state() const noexcept;
+
+  /// \brief Pop the most recently pushed element
+  ///
+  /// \param [out] element Location to store the popped element (if the stack
+  ///                      is not empty)
+  /// \param [out] state Location to store the state of the stack if `state`
+  ///                    is not null
+  ///
+  /// \return false if the stack is empty
+  bool pop(Element* element, State* state = nullptr);
+
+private:
+  using NodePtr = typename PtrTraits::template Ptr<Node>;
+  using AtomicNodePtr = typename PtrTraits::template AtomicPtr<Node>;
+
+  struct NI_CACHELINE_ALIGNED EliminationSlot
+  {
+    AtomicNodePtr offer;
+  };
+
+  NI_CACHELINE_ALIGNED AtomicNodePtr m_top;
+  NI_CACHELINE_ALIGNED EliminationSlot* m_elimination;
+  size_t m_elimination_size;
+
+  NI_PADDING_AFTER(sizeof(m_elimination) + sizeof(m_elimination_size));
+
+  EliminationSlot& random_slot() noexcept;
+  bool try_eliminate_push(Node* node) noexcept;
+  Node* try_eliminate_pop() noexcept;
+
+  template <typename U>
+  static Node* create_node(U&& item);
+  static void destroy_node(Node* node) noexcept;
+  static void reclaim_node(void* node) noexcept;
+};
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+TreiberStack<T, NodeAllocator, PtrTraits>::Node::Node(const Element& item)
+  : value(item)
+  , next()
+{
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+TreiberStack<T, NodeAllocator, PtrTraits>::Node::Node(Element&& item)
+  : value(std::move(item))
+  , next()
+{
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+TreiberStack<T, NodeAllocator, PtrTraits>::TreiberStack(
+  size_t elimination_size)
+  : m_top()
+  , m_elimination(elimination_size ? new EliminationSlot[elimination_size]
+                                   : nullptr)
+  , m_elimination_size(elimination_size)
+{
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+TreiberStack<T, NodeAllocator, PtrTraits>::~TreiberStack()
+{
+  Node* node = m_top.load(std::memory_order_relaxed).value();
+  while (node)
+  {
+    Node* tmp = node;
+    node = tmp->next;
+    destroy_node(tmp);
+  }
+  delete[] m_elimination;
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+bool TreiberStack<T, NodeAllocator, PtrTraits>::empty() const noexcept
+{
+  return m_top.load(std::memory_order_acquire).value() == nullptr;
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+template <typename U>
+bool TreiberStack<T, NodeAllocator, PtrTraits>::push(U&& element)
+{
+  Node* node = create_node(std::forward<U>(element));
+  NodePtr old_top = m_top.load(std::memory_order_relaxed);
+  while (true)
+  {
+    node->next = old_top.value();
+    if (m_top.compare_exchange_weak(old_top, NodePtr(node, old_top.tag() + 1),
+                                    std::memory_order_release,
+                                    std::memory_order_relaxed))
+      return true;
+
+    if (m_elimination && try_eliminate_push(node))
+      return true;
+    old_top = m_top.load(std::memory_order_relaxed);
+  }
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+typename TreiberStack<T, NodeAllocator, PtrTraits>::State
+TreiberStack<T, NodeAllocator, PtrTraits>::tail_state() const noexcept
+{
+  return m_top.load(std::memory_order_relaxed).tag();
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+bool TreiberStack<T, NodeAllocator, PtrTraits>::pop(Element* element,
+                                                    State* state)
+{
+  HazardPointers::Guard top_guard;
+  while (true)
+  {
+    NodePtr old_top = top_guard.protect(m_top);
+    if (old_top.value() == nullptr)
+    {
+      if (state != nullptr)
+        *state = old_top.tag();
+      return false;
+    }
+
+    // `next` may be stale if the top has been popped concurrently, the tag
+    // makes the CAS fail in that case
+    Node* next = old_top.value()->next;
+    if (m_top.compare_exchange_weak(old_top, NodePtr(next, old_top.tag() + 1),
+                                    std::memory_order_acquire,
+                                    std::memory_order_relaxed))
+    {
+      if (state != nullptr)
+        *state = old_top.tag();
+      *element = std::move(old_top.value()->value);
+      top_guard.reset();
+      HazardPointers::retire(old_top.value(), &reclaim_node);
+      return true;
+    }
+
+    if (m_elimination)
+    {
+      Node* node = try_eliminate_pop();
+      if (node)
+      {
+        if (state != nullptr)
+          *state = old_top.tag();
+        *element = std::move(node->value);
+        destroy_node(node);
+        return true;
+      }
+    }
+  }
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+typename TreiberStack<T, NodeAllocator, PtrTraits>::EliminationSlot&
+TreiberStack<T, NodeAllocator, PtrTraits>::random_slot() noexcept
+{
+  return m_elimination[thread_rng()() % m_elimination_size];
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+bool TreiberStack<T, NodeAllocator, PtrTraits>::try_eliminate_push(
+  Node* node) noexcept
+{
+  AtomicNodePtr& offer = random_slot().offer;
+  NodePtr empty = offer.load(std::memory_order_relaxed);
+  if (empty.value() != nullptr)
+    return false;
+
+  NodePtr offered(node, empty.tag() + 1);
+  if (!offer.compare_exchange_strong(empty, offered, std::memory_order_release,
+                                     std::memory_order_relaxed))
+    return false;
+
+  for (size_t i = 0; i < ELIMINATION_SPINS; ++i)
+  {
+    if (offer.load(std::memory_order_acquire) != offered)
+      return true;
+  }
+
+  // Withdraw the offer, fails if a popper has taken the node meanwhile. The
+  // tag prevents ABA if the slot has been reused since.
+  return !offer.compare_exchange_strong(
+    offered, NodePtr(nullptr, offered.tag() + 1), std::memory_order_acquire,
+    std::memory_order_relaxed);
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+typename TreiberStack<T, NodeAllocator, PtrTraits>::Node*
+TreiberStack<T, NodeAllocator, PtrTraits>::try_eliminate_pop() noexcept
+{
+  AtomicNodePtr& offer = random_slot().offer;
+  NodePtr offered = offer.load(std::memory_order_acquire);
+  if (offered.value() == nullptr)
+    return nullptr;
+
+  // The node is not dereferenced before the CAS succeeds, it belongs to
+  // this thread afterwards
+  if (offer.compare_exchange_strong(offered,
+                                    NodePtr(nullptr, offered.tag() + 1),
+                                    std::memory_order_acquire,
+                                    std::memory_order_relaxed))
+    return offered.value();
+  return nullptr;
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+template <typename U>
+typename TreiberStack<T, NodeAllocator, PtrTraits>::Node*
+TreiberStack<T, NodeAllocator, PtrTraits>::create_node(U&& item)
+{
+  Node* node = NodeAllocator<Node>::allocate();
+  try
+  {
+    return new (node) Node(std::forward<U>(item));
+  }
+  catch (...)
+  {
+    NodeAllocator<Node>::deallocate(node);
+    throw;
+  }
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+void TreiberStack<T, NodeAllocator, PtrTraits>::destroy_node(
+  Node* node) noexcept
+{
+  node->~Node();
+  NodeAllocator<Node>::deallocate(node);
+}
+
+template <typename T, template <typename> class NodeAllocator,
+          typename PtrTraits>
+void TreiberStack<T, NodeAllocator, PtrTraits>::reclaim_node(
+  void* node) noexcept
+{
+  destroy_node(static_cast<Node*>(node));
+}
+
+} // namespace ni
@@ -0,0 +1,320 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <system_error>
+#include <type_traits>
+
+#include <ni/cache_locality.hh>
+#include <ni/hazard_pointers.hh>
+
+namespace ni
+{
+/// \brief Chase-Lev work-stealing deque
+///
+/// The owner thread pushes and pops elements at the bottom without any
+/// atomic read-modify-write operation except when the deque holds a single
+/// element. Other threads steal elements from the top with a CAS.
+///
+/// The elements are stored in a circular array which is replaced by an array
+/// twice as large when it is full. Thieves keep reading the old array in the
+/// meantime (the live elements are copied), so growing never blocks them.
+/// Replaced arrays are retired to `HazardPointers`.
+///
+/// **Reference**
+///
+/// * D. Chase and Y. Lev. Dynamic Circular Work-Stealing Deque. SPAA '05.
+/// * N. M. Lê, A. Pop, A. Cohen, and F. Zappa Nardelli. Correct and Efficient
+///   Work-Stealing for Weak Memory Models. PPoPP '13.
+///
+/// \param T type of the elements, trivially copyable (e.g. pointers to tasks)
+template <typename T>
+class WorkStealingDeque
+{
+public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Elements of WorkStealingDeque must be trivially copyable");
+
+  using Element = T;
+
+  /// \brief Create an empty deque
+  /// \param capacity initial capacity, must be power of two (and greater than
+  ///        1)
+  explicit WorkStealingDeque(size_t capacity = 64);
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+  ~WorkStealingDeque();
+
+  /// \return an estimation of the number of elements
+  size_t size_approx() const noexcept;
+
+  /// \return true if the deque looks empty
+  bool empty() const noexcept;
+
+  /// \brief Push an element at the bottom, owner only
+  void push(const Element& element);
+
+  /// \brief Pop the element at the bottom, owner only
+  /// \return false if the deque is empty
+  bool pop(Element* element) noexcept;
+
+  /// \brief Steal the element at the top
+  ///
+  /// Protects the array with a hazard pointer, throws `std::length_error`
+  /// if the calling thread has no free hazard slot.
+  ///
+  /// \return false if the deque is empty
+  bool steal(Element* element);
+
+  /// \brief Steal up to half of the elements (at most `max`) from the top
+  ///
+  /// Elements are stolen one CAS at a time: a single CAS moving the top past
+  /// several elements could race with the owner popping one of them, since
+  /// the owner only synchronizes with thieves on the last element.
+  ///
+  /// Throws `std::length_error` like `steal`, before anything is stolen.
+  ///
+  /// \param [out] elements Location to store the stolen elements, in FIFO
+  ///                       order
+  /// \return number of elements stolen
+  size_t steal_half(Element* elements, size_t max);
+
+private:
+  class Array
+  {
+  public:
+    explicit Array(size_t capacity);
+    Array(const Array&) = delete;
+    Array& operator=(const Array&) = delete;
+    ~Array();
+
+    size_t capacity() const noexcept;
+    Element get(int64_t index) const noexcept;
+    void put(int64_t index, const Element& element) noexcept;
+    Array* grow(int64_t top, int64_t bottom) const;
+
+  private:
+    const size_t m_mask;
+    std::atomic<Element>* m_buffer;
+  };
+
+  NI_CACHELINE_ALIGNED std::atomic<int64_t> m_top;
+  NI_CACHELINE_ALIGNED std::atomic<int64_t> m_bottom;
+  std::atomic<Array*> m_array;
+
+  NI_PADDING_AFTER(sizeof(m_bottom) + sizeof(m_array));
+
+  enum class StealResult
+  {
+    Success,
+    Empty,
+    Abort
+  };
+
+  StealResult try_steal(Element* element,
+                        HazardPointers::Guard& guard) noexcept;
+};
+
+template <typename T>
+WorkStealingDeque<T>::Array::Array(size_t capacity)
+  : m_mask(capacity - 1)
+  , m_buffer()
+{
+  assert((capacity > 1) && (capacity & (capacity - 1)) == 0 &&
+         "capacity must be a power of two");
+
+  int rc = posix_memalign(reinterpret_cast<void**>(&m_buffer),
+                          NI_CACHELINE_SIZE<size_t>,
+                          sizeof(std::atomic<Element>) * capacity);
+  if (rc)
+    throw std::system_error(rc, std::system_category(), __func__);
+}
+
+template <typename T>
+WorkStealingDeque<T>::Array::~Array()
+{
+  free(m_buffer);
+}
+
+template <typename T>
+size_t WorkStealingDeque<T>::Array::capacity() const noexcept
+{
+  return m_mask + 1;
+}
+
+template <typename T>
+T WorkStealingDeque<T>::Array::get(int64_t index) const noexcept
+{
+  return m_buffer[index & m_mask].load(std::memory_order_relaxed);
+}
+
+template <typename T>
+void WorkStealingDeque<T>::Array::put(int64_t index,
+                                      const Element& element) noexcept
+{
+  m_buffer[index & m_mask].store(element, std::memory_order_relaxed);
+}
+
+template <typename T>
+typename WorkStealingDeque<T>::Array*
+WorkStealingDeque<T>::Array::grow(int64_t top, int64_t bottom) const
+{
+  Array* array = new Array(capacity() * 2);
+  for (int64_t i = top; i < bottom; ++i)
+    array->put(i, get(i));
+  return array;
+}
+
+template <typename T>
+WorkStealingDeque<T>::WorkStealingDeque(size_t capacity)
+  : m_top()
+  , m_bottom()
+  , m_array(new Array(capacity))
+{
+}
+
+template <typename T>
+WorkStealingDeque<T>::~WorkStealingDeque()
+{
+  delete m_array.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+size_t WorkStealingDeque<T>::size_approx() const noexcept
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+  int64_t top = m_top.load(std::memory_order_relaxed);
+  return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::empty() const noexcept
+{
+  return size_approx() == 0;
+}
+
+template <typename T>
+void WorkStealingDeque<T>::push(const Element& element)
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+  int64_t top = m_top.load(std::memory_order_acquire);
+  Array* array = m_array.load(std::memory_order_relaxed);
+  if (bottom - top > static_cast<int64_t>(array->capacity()) - 1)
+  {
+    Array* old_array = array;
+    array = old_array->grow(top, bottom);
+    m_array.store(array, std::memory_order_release);
+    HazardPointers::retire(old_array);
+  }
+  array->put(bottom, element);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::pop(Element* element) noexcept
+{
+  int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+  Array* array = m_array.load(std::memory_order_relaxed);
+  m_bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = m_top.load(std::memory_order_relaxed);
+
+  if (top > bottom)
+  {
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+
+  *element = array->get(bottom);
+  if (top == bottom)
+  {
+    // Last element, race with the thieves
+    bool won = m_top.compare_exchange_strong(top, top + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::steal(Element* element)
+{
+  HazardPointers::Guard guard;
+  while (true)
+  {
+    switch (try_steal(element, guard))
+    {
+    case StealResult::Success:
+      return true;
+    case StealResult::Empty:
+      return false;
+    case StealResult::Abort:
+      break;
+    }
+  }
+}
+
+template <typename T>
+size_t WorkStealingDeque<T>::steal_half(Element* elements, size_t max)
+{
+  size_t count = (size_approx() + 1) / 2;
+  if (count > max)
+    count = max;
+
+  HazardPointers::Guard guard;
+  size_t stolen = 0;
+  while (stolen < count)
+  {
+    StealResult result = try_steal(&elements[stolen], guard);
+    if (result == StealResult::Success)
+      ++stolen;
+    else if (result == StealResult::Empty)
+      break;
+  }
+  return stolen;
+}
+
+template <typename T>
+typename WorkStealingDeque<T>::StealResult
+WorkStealingDeque<T>::try_steal(Element* element,
+                                HazardPointers::Guard& guard) noexcept
+{
+  int64_t top = m_top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t bottom = m_bottom.load(std::memory_order_acquire);
+  if (top >= bottom)
+    return StealResult::Empty;
+
+  Array* array = guard.protect(m_array);
+  Element tmp = array->get(top);
+  if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+    return StealResult::Abort;
+  *element = tmp;
+  return StealResult::Success;
+}
+
+} // namespace ni
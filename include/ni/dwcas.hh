@@ -0,0 +1,81 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <cstdint>
+
+namespace ni
+{
+
+/// \brief Two adjacent 64-bit words which can be updated atomically as a whole
+///        by `dwcas`
+struct alignas(16) DoubleWord
+{
+  uint64_t low;
+  uint64_t high;
+
+  bool operator==(const DoubleWord& other) const noexcept;
+  bool operator!=(const DoubleWord& other) const noexcept;
+};
+
+/// \brief Double-width compare-and-swap
+///
+/// Atomically compares `*target` with `expected` and replaces it with
+/// `desired` if they are equal. Otherwise `expected` is updated with the
+/// current value of `*target`. Acts as a full memory barrier.
+///
+/// Uses `lock cmpxchg16b` on x86-64 so that it does not depend on `-mcx16` or
+/// on libatomic.
+///
+/// \return true if `*target` has been replaced
+bool dwcas(DoubleWord* target, DoubleWord& expected,
+           DoubleWord desired) noexcept;
+
+inline bool DoubleWord::operator==(const DoubleWord& other) const noexcept
+{
+  return low == other.low && high == other.high;
+}
+
+inline bool DoubleWord::operator!=(const DoubleWord& other) const noexcept
+{
+  return !(*this == other);
+}
+
+inline bool dwcas(DoubleWord* target, DoubleWord& expected,
+                  DoubleWord desired) noexcept
+{
+#if defined(__x86_64__)
+  bool result;
+  __asm__ __volatile__("lock cmpxchg16b %1\n\t"
+                       "setz %0"
+                       : "=q"(result), "+m"(*target), "+a"(expected.low),
+                         "+d"(expected.high)
+                       : "b"(desired.low), "c"(desired.high)
+                       : "cc", "memory");
+  return result;
+#else
+  using Raw = unsigned __int128;
+  return __atomic_compare_exchange(
+    reinterpret_cast<Raw*>(target), reinterpret_cast<Raw*>(&expected),
+    reinterpret_cast<Raw*>(&desired), false, __ATOMIC_SEQ_CST,
+    __ATOMIC_SEQ_CST);
+#endif
+}
+
+} // namespace ni
@@ -31,9 +31,15 @@
 namespace ni
 {
 
-struct Futex : public std::atomic<int32_t>
+/// \brief Atomic integer which threads can wait on
+///
+/// \param Shared whether the futex may be shared between processes (i.e. it
+///        lives in shared memory), otherwise the cheaper private futex
+///        operations are used
+template <bool Shared>
+struct BasicFutex : public std::atomic<int32_t>
 {
-  explicit Futex(int32_t value = 0) noexcept;
+  explicit BasicFutex(int32_t value = 0) noexcept;
 
   /// \brief Puts the thread to sleep if this->load() == expected.
   /// \return Returns true if this->load() != expected or when it has consumed
@@ -44,16 +50,31 @@ struct Futex : public std::atomic<int32_t>
   /// \brief Wakens up to count waiters where (wait_mask & wake_mask) != 0.
   /// \return Returns the number of awoken threads.
   int wake(int count = INT_MAX, int wake_mask = -1) noexcept;
+
+private:
+  static constexpr int WAIT_OP =
+    Shared ? FUTEX_WAIT_BITSET : FUTEX_WAIT_BITSET_PRIVATE;
+  static constexpr int WAKE_OP =
+    Shared ? FUTEX_WAKE_BITSET : FUTEX_WAKE_BITSET_PRIVATE;
 };
 
-inline Futex::Futex(int32_t value) noexcept : std::atomic<int32_t>(value)
+/// \brief Futex private to the process
+using Futex = BasicFutex<false>;
+
+/// \brief Futex which may be placed in memory shared between processes
+using SharedFutex = BasicFutex<true>;
+
+template <bool Shared>
+BasicFutex<Shared>::BasicFutex(int32_t value) noexcept
+  : std::atomic<int32_t>(value)
 {
 }
 
-inline bool Futex::wait(int32_t expected, int wait_mask) noexcept
+template <bool Shared>
+bool BasicFutex<Shared>::wait(int32_t expected, int wait_mask) noexcept
 {
   int rv = syscall(SYS_futex, this, // addr1
-                   FUTEX_WAIT_BITSET_PRIVATE, // op
+                   WAIT_OP, // op
                    expected, // val
                    nullptr, // timeout
                    nullptr, // addr2
@@ -61,11 +82,12 @@ inline bool Futex::wait(int32_t expected, int wait_mask) noexcept
   return (rv == 0 || errno == EWOULDBLOCK);
 }
 
-inline int Futex::wake(int count, int wake_mask) noexcept
+template <bool Shared>
+int BasicFutex<Shared>::wake(int count, int wake_mask) noexcept
 {
   assert(count > 0);
   int rv = syscall(SYS_futex, this, // addr1
-                   FUTEX_WAKE_BITSET_PRIVATE, // op
+                   WAKE_OP, // op
                    count, // val
                    nullptr, // timeout
                    nullptr, // addr2
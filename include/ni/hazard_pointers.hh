@@ -0,0 +1,214 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <ni/cache_locality.hh>
+#include <ni/tagged_ptr.hh>
+
+namespace ni
+{
+
+/// \brief Hazard pointers based safe memory reclamation
+///
+/// Every thread owns `SLOTS_PER_THREAD` hazard slots. A thread publishes the
+/// address of a shared object in one of its slots (through a `Guard`) before
+/// dereferencing it. Removed objects are `retire`d instead of being freed
+/// directly, and are handed to their deleter once no hazard slot refers to
+/// them anymore. Retired objects are kept in a per-thread list which is
+/// scanned when it grows beyond a threshold proportional to the total number
+/// of hazard slots, so the cost of a scan is amortized over the retirements.
+///
+/// **Reference**
+///
+/// * M. M. Michael. Hazard Pointers: Safe Memory Reclamation for Lock-Free
+///   Objects. IEEE TPDS 15(6), 2004.
+class HazardPointers
+{
+public:
+  using Deleter = void (*)(void*);
+
+  static constexpr size_t SLOTS_PER_THREAD = 8;
+  static constexpr size_t MIN_SCAN_THRESHOLD = 64;
+
+  /// \brief Owns one hazard slot of the calling thread
+  class Guard
+  {
+  public:
+    Guard();
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+    ~Guard();
+
+    /// \brief Load `src` and protect the loaded pointer
+    /// \param src `AtomicTaggedPtr` or `AtomicWideTaggedPtr`
+    /// \return the protected value, which was the value of `src` after
+    ///         the hazard pointer had been published
+    template <typename A>
+    typename A::TaggedPtr protect(const A& src) noexcept;
+
+    template <typename T>
+    T* protect(const std::atomic<T*>& src) noexcept;
+
+    /// \brief Publish `ptr`. The caller has to validate that `ptr` is still
+    ///        reachable after this call before dereferencing it.
+    void set(const void* ptr) noexcept;
+
+    void reset() noexcept;
+
+  private:
+    std::atomic<const void*>* m_slot;
+  };
+
+  /// \brief Defer `deleter(ptr)` until no hazard pointer refers to `ptr`
+  static void retire(void* ptr, Deleter deleter);
+
+  /// \brief Defer `delete ptr` until no hazard pointer refers to `ptr`
+  template <typename T>
+  static void retire(T* ptr);
+
+  /// \brief Reclaim every retired object of the calling thread that is not
+  ///        protected anymore
+  static void scan();
+
+private:
+  struct Retired
+  {
+    void* ptr;
+    Deleter deleter;
+  };
+
+  struct NI_CACHELINE_ALIGNED Record
+  {
+    std::atomic<const void*> slots[SLOTS_PER_THREAD];
+    std::atomic<bool> active;
+    Record* next;
+
+    // Owned by the thread which holds the record
+    uint32_t free_slots;
+    std::vector<Retired> retired;
+
+    Record();
+  };
+
+  // Releases the record of the thread when it exits. Other thread_local
+  // destructors may still use hazard pointers after it ran: the record is
+  // then acquired again and released as soon as it is not used anymore.
+  struct ExitHook
+  {
+    ~ExitHook();
+  };
+
+  static std::atomic<Record*> s_records;
+  static std::atomic<size_t> s_record_count;
+  static thread_local Record* t_record;
+  static thread_local bool t_exited;
+  static thread_local ExitHook t_exit_hook;
+
+  static Record* local_record();
+  static Record* acquire_record();
+  static void release_record(Record* record) noexcept;
+  static void release_exited() noexcept;
+  static void scan(Record* record);
+};
+
+inline HazardPointers::Guard::Guard()
+  : m_slot()
+{
+  Record* record = local_record();
+  if (NI_UNLIKELY(!record->free_slots))
+    throw std::length_error("HazardPointers: out of hazard slots");
+
+  unsigned index = __builtin_ctz(record->free_slots);
+  record->free_slots &= ~(1u << index);
+  m_slot = &record->slots[index];
+}
+
+inline HazardPointers::Guard::~Guard()
+{
+  Record* record = t_record;
+  m_slot->store(nullptr, std::memory_order_release);
+  record->free_slots |= 1u << (m_slot - record->slots);
+  if (NI_UNLIKELY(t_exited))
+    release_exited();
+}
+
+template <typename A>
+typename A::TaggedPtr HazardPointers::Guard::protect(const A& src) noexcept
+{
+  using P = typename A::TaggedPtr;
+  P ptr = src.load(std::memory_order_relaxed);
+  while (true)
+  {
+    set(ptr.value());
+    P current = src.load(std::memory_order_acquire);
+    if (current.value() == ptr.value())
+      return current;
+    ptr = current;
+  }
+}
+
+template <typename T>
+T* HazardPointers::Guard::protect(const std::atomic<T*>& src) noexcept
+{
+  T* ptr = src.load(std::memory_order_relaxed);
+  while (true)
+  {
+    set(ptr);
+    T* current = src.load(std::memory_order_acquire);
+    if (current == ptr)
+      return current;
+    ptr = current;
+  }
+}
+
+inline void HazardPointers::Guard::set(const void* ptr) noexcept
+{
+  // The store has to be ordered before the subsequent validating load
+  m_slot->store(ptr, std::memory_order_seq_cst);
+}
+
+inline void HazardPointers::Guard::reset() noexcept
+{
+  m_slot->store(nullptr, std::memory_order_release);
+}
+
+template <typename T>
+void HazardPointers::retire(T* ptr)
+{
+  retire(ptr, [](void* p)
+         {
+           delete static_cast<T*>(p);
+         });
+}
+
+inline HazardPointers::Record* HazardPointers::local_record()
+{
+  Record* record = t_record;
+  if (NI_UNLIKELY(!record))
+    record = t_record = acquire_record();
+  return record;
+}
+
+} // namespace ni
@@ -0,0 +1,111 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <system_error>
+
+namespace ni
+{
+/// \brief Buffer allocator which forwards every request to the heap
+///
+/// Buffer allocators provide the storage of array based containers such as
+/// `SPSCRingBuffer`. Unlike node allocators they are passed by value to the
+/// container, so they may carry options. `allocate(bytes, alignment)` returns
+/// uninitialized (possibly not yet faulted in) storage and
+/// `deallocate(ptr, bytes)` takes it back given the same size.
+/// `reserved_size(bytes)` tells how much memory such a request actually
+/// reserves.
+class HeapBufferAllocator
+{
+public:
+  void* allocate(size_t bytes, size_t alignment) const;
+  void deallocate(void* ptr, size_t bytes) const noexcept;
+  size_t reserved_size(size_t bytes) const noexcept;
+};
+
+/// \brief Buffer allocator mapping anonymous memory with `mmap`
+///
+/// Intended for large buffers (several MB) which are long-lived: every
+/// buffer is a mapping of its own, rounded up to whole pages.
+///
+/// * `HUGE_PAGES` first tries to map explicit huge pages (`MAP_HUGETLB`) and
+///   falls back to regular pages with transparent huge pages enabled when no
+///   huge page is reserved. Either way the size is rounded up to
+///   `HUGE_PAGE_SIZE`.
+/// * A NUMA node binds the pages to that node with `mbind`, before they are
+///   faulted in.
+/// * `PREFAULT` touches every page at allocation time and `LOCK` keeps the
+///   pages resident with `mlock`, so that the first accesses do not stall on
+///   page faults.
+///
+/// Failing to map the memory throws `std::system_error`. NUMA binding and
+/// locking are best-effort: they are skipped silently if the kernel refuses
+/// them (no NUMA support, `RLIMIT_MEMLOCK` exceeded...).
+class MappedBufferAllocator
+{
+public:
+  enum Flags : unsigned
+  {
+    HUGE_PAGES = 1,
+    PREFAULT = 2,
+    LOCK = 4
+  };
+
+  static constexpr int ANY_NODE = -1;
+  static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+  /// \param flags combination of `Flags`
+  /// \param numa_node node to bind the memory to, or `ANY_NODE`
+  explicit MappedBufferAllocator(unsigned flags = HUGE_PAGES,
+                                 int numa_node = ANY_NODE) noexcept;
+
+  void* allocate(size_t bytes, size_t alignment) const;
+  void deallocate(void* ptr, size_t bytes) const noexcept;
+
+  /// \return size of the mapping of `bytes`
+  size_t reserved_size(size_t bytes) const noexcept;
+
+private:
+  unsigned m_flags;
+  int m_numa_node;
+};
+
+inline void* HeapBufferAllocator::allocate(size_t bytes,
+                                           size_t alignment) const
+{
+  void* ptr;
+  int rc = posix_memalign(&ptr, alignment, bytes);
+  if (rc)
+    throw std::system_error(rc, std::system_category(), __func__);
+  return ptr;
+}
+
+inline void HeapBufferAllocator::deallocate(void* ptr, size_t) const noexcept
+{
+  free(ptr);
+}
+
+inline size_t HeapBufferAllocator::reserved_size(size_t bytes) const noexcept
+{
+  return bytes;
+}
+
+} // namespace ni
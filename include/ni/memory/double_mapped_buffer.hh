@@ -0,0 +1,65 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <cstddef>
+
+namespace ni
+{
+/// \brief Memory buffer mapped twice back to back
+///
+/// The pages of a `memfd` are mapped at `data()` and again right after, at
+/// `data() + size()`. Any range of at most `size()` bytes starting in the
+/// first mapping is therefore contiguous in virtual memory, even when it
+/// wraps around the end of the buffer, which spares ring buffers from
+/// splitting their records.
+class DoubleMappedBuffer
+{
+public:
+  /// \param size size of the buffer, must be a multiple of the page size
+  explicit DoubleMappedBuffer(size_t size);
+  DoubleMappedBuffer(const DoubleMappedBuffer&) = delete;
+  DoubleMappedBuffer& operator=(const DoubleMappedBuffer&) = delete;
+  ~DoubleMappedBuffer();
+
+  /// \return start of the first mapping, `2 * size()` bytes are addressable
+  char* data() const noexcept;
+
+  /// \return size of the buffer (and of each mapping)
+  size_t size() const noexcept;
+
+  /// \return size of a page, the granularity of the buffer sizes
+  static size_t page_size() noexcept;
+
+private:
+  char* m_data;
+  size_t m_size;
+};
+
+inline char* DoubleMappedBuffer::data() const noexcept
+{
+  return m_data;
+}
+
+inline size_t DoubleMappedBuffer::size() const noexcept
+{
+  return m_size;
+}
+
+} // namespace ni
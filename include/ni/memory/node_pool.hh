@@ -0,0 +1,275 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <system_error>
+
+#include <ni/cache_locality.hh>
+#include <ni/preprocessor.hh>
+#include <ni/tagged_ptr.hh>
+
+namespace ni
+{
+/// \brief Node allocator which forwards every request to the heap
+///
+/// Node allocators are stateless policies used by node based containers.
+/// `allocate()` returns uninitialized storage suitable for a `T` and
+/// `deallocate()` takes back storage of an already destroyed `T`.
+///
+/// \param T type of the nodes
+template <typename T>
+class HeapNodeAllocator
+{
+public:
+  static T* allocate();
+  static void deallocate(T* ptr) noexcept;
+};
+
+template <typename T>
+T* HeapNodeAllocator<T>::allocate()
+{
+  void* ptr;
+  int rc =
+    posix_memalign(&ptr, std::max(alignof(T), sizeof(void*)), sizeof(T));
+  if (rc)
+    throw std::system_error(rc, std::system_category(), __func__);
+  return static_cast<T*>(ptr);
+}
+
+template <typename T>
+void HeapNodeAllocator<T>::deallocate(T* ptr) noexcept
+{
+  free(ptr);
+}
+
+/// \brief Lock-free node pool with per-thread caches
+///
+/// Freed nodes are kept in a thread local magazine of `BATCH_SIZE` nodes plus
+/// a spare one. Full magazines are exchanged with a global lock-free stack
+/// with a single CAS, so a steady-state workload does not call the system
+/// allocator at all and touches shared state once every `BATCH_SIZE`
+/// operations.
+///
+/// Storage obtained by the pool is never returned to the system. Memory
+/// handed out by the pool is therefore type-stable: a stale pointer to a
+/// recycled node still points to a valid (possibly reused) node, which is
+/// what makes the tag of `AtomicTaggedPtr` sufficient to prevent ABA on the
+/// global stack.
+///
+/// **Reference**
+///
+/// * J. Bonwick and J. Adams. Magazines and Vmem: Extending the Slab
+///   Allocator to Many CPUs and Arbitrary Resources. USENIX ATC '01.
+///
+/// \param T type of the nodes
+template <typename T>
+class NodePool
+{
+public:
+  static constexpr size_t BATCH_SIZE = 32;
+
+  static T* allocate();
+  static void deallocate(T* ptr) noexcept;
+
+private:
+  struct FreeNode
+  {
+    FreeNode* next;
+    // Only meaningful for the first node of a batch
+    std::atomic<FreeNode*> next_batch;
+    size_t batch_size;
+  };
+
+  using FreeNodePtr = TaggedPtr<FreeNode>;
+  using AtomicFreeNodePtr = AtomicTaggedPtr<FreeNodePtr>;
+
+  // Trivially destructible so that it can still be used safely by thread
+  // local destructors which run after `CacheFlusher`
+  struct LocalCache
+  {
+    FreeNode* current;
+    size_t current_size;
+    FreeNode* spare;
+  };
+
+  struct CacheFlusher
+  {
+    ~CacheFlusher();
+  };
+
+  struct NI_CACHELINE_ALIGNED GlobalStack
+  {
+    AtomicFreeNodePtr top;
+  };
+
+  static constexpr size_t DESTROYED = SIZE_MAX;
+  static constexpr size_t NODE_SIZE = std::max(sizeof(T), sizeof(FreeNode));
+  static constexpr size_t NODE_ALIGNMENT =
+    std::max(alignof(T), alignof(FreeNode));
+
+  static GlobalStack s_batches;
+  static thread_local LocalCache t_cache;
+  static thread_local CacheFlusher t_flusher;
+
+  static void register_flusher() noexcept;
+  static void push_batch(FreeNode* batch, size_t size) noexcept;
+  static FreeNode* pop_batch(size_t* size) noexcept;
+};
+
+template <typename T>
+typename NodePool<T>::GlobalStack NodePool<T>::s_batches;
+
+template <typename T>
+thread_local typename NodePool<T>::LocalCache NodePool<T>::t_cache;
+
+template <typename T>
+thread_local typename NodePool<T>::CacheFlusher NodePool<T>::t_flusher;
+
+template <typename T>
+NodePool<T>::CacheFlusher::~CacheFlusher()
+{
+  LocalCache& cache = t_cache;
+  if (cache.current)
+    push_batch(cache.current, cache.current_size);
+  if (cache.spare)
+    push_batch(cache.spare, BATCH_SIZE);
+
+  // Nodes may still be released after the cache has been flushed (e.g. by
+  // thread local destructors which run later), they bypass the cache.
+  cache.current = nullptr;
+  cache.spare = nullptr;
+  cache.current_size = DESTROYED;
+}
+
+template <typename T>
+void NodePool<T>::register_flusher() noexcept
+{
+  // Odr-using the thread local constructs it and registers its destructor
+  static_cast<void>(&t_flusher);
+}
+
+template <typename T>
+T* NodePool<T>::allocate()
+{
+  LocalCache& cache = t_cache;
+  if (NI_UNLIKELY(!cache.current))
+  {
+    if (cache.current_size == DESTROYED)
+    {
+      // Leave the cache empty
+    }
+    else if (cache.spare)
+    {
+      cache.current = cache.spare;
+      cache.current_size = BATCH_SIZE;
+      cache.spare = nullptr;
+    }
+    else
+    {
+      register_flusher();
+      cache.current = pop_batch(&cache.current_size);
+    }
+
+    if (!cache.current)
+    {
+      void* ptr;
+      int rc = posix_memalign(&ptr, NODE_ALIGNMENT, NODE_SIZE);
+      if (rc)
+        throw std::system_error(rc, std::system_category(), __func__);
+      return static_cast<T*>(ptr);
+    }
+  }
+
+  FreeNode* node = cache.current;
+  cache.current = node->next;
+  --cache.current_size;
+  node->~FreeNode();
+  return reinterpret_cast<T*>(node);
+}
+
+template <typename T>
+void NodePool<T>::deallocate(T* ptr) noexcept
+{
+  LocalCache& cache = t_cache;
+  if (NI_UNLIKELY(cache.current_size >= BATCH_SIZE))
+  {
+    if (cache.current_size == DESTROYED)
+    {
+      push_batch(new (ptr) FreeNode(), 1);
+      return;
+    }
+    if (cache.spare)
+      push_batch(cache.spare, BATCH_SIZE);
+    cache.spare = cache.current;
+    cache.current = nullptr;
+    cache.current_size = 0;
+  }
+  else if (NI_UNLIKELY(!cache.current))
+  {
+    register_flusher();
+  }
+
+  FreeNode* node = new (ptr) FreeNode();
+  node->next = cache.current;
+  cache.current = node;
+  ++cache.current_size;
+}
+
+template <typename T>
+void NodePool<T>::push_batch(FreeNode* batch, size_t size) noexcept
+{
+  batch->batch_size = size;
+  FreeNodePtr old_top = s_batches.top.load(std::memory_order_relaxed);
+  do
+    batch->next_batch.store(old_top.value(), std::memory_order_relaxed);
+  while (!s_batches.top.compare_exchange_weak(
+    old_top, FreeNodePtr(batch, old_top.tag() + 1), std::memory_order_release,
+    std::memory_order_relaxed));
+}
+
+template <typename T>
+typename NodePool<T>::FreeNode* NodePool<T>::pop_batch(size_t* size) noexcept
+{
+  FreeNodePtr old_top = s_batches.top.load(std::memory_order_acquire);
+  while (old_top.value())
+  {
+    // The batch may have been popped and reused concurrently, in which case
+    // `next_batch` is garbage and the CAS below fails
+    FreeNodePtr new_top;
+    new_top.set_value(
+      old_top.value()->next_batch.load(std::memory_order_relaxed));
+    new_top.set_tag(old_top.tag() + 1);
+    if (s_batches.top.compare_exchange_weak(old_top, new_top,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire))
+    {
+      *size = old_top.value()->batch_size;
+      return old_top.value();
+    }
+  }
+  *size = 0;
+  return nullptr;
+}
+
+} // namespace ni
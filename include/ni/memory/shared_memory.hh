@@ -0,0 +1,97 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <cstddef>
+
+namespace ni
+{
+/// \brief Mapping of memory which can be shared between processes
+///
+/// The memory is either a named POSIX shared memory object (`shm_open`),
+/// which unrelated processes find by name, or an anonymous `memfd` whose
+/// file descriptor is inherited by a child process or sent over a UNIX
+/// socket. Every process maps it at its own address, so the data structures
+/// stored in it must not contain pointers.
+class SharedMemory
+{
+public:
+  /// \brief Create and map an anonymous shared memory object
+  static SharedMemory create(size_t size);
+
+  /// \brief Create and map a named shared memory object
+  ///
+  /// Fails with `EEXIST` if an object with the same name exists, see
+  /// `unlink()`.
+  ///
+  /// \param name name of the object, "/somename"
+  static SharedMemory create(const char* name, size_t size);
+
+  /// \brief Map an existing named shared memory object
+  static SharedMemory open(const char* name);
+
+  /// \brief Map an existing shared memory object
+  /// \param fd file descriptor of the object, duplicated
+  static SharedMemory open(int fd);
+
+  /// \brief Remove a named shared memory object, existing mappings are not
+  ///        affected
+  static void unlink(const char* name) noexcept;
+
+  SharedMemory(SharedMemory&& other) noexcept;
+  SharedMemory& operator=(SharedMemory&& other) noexcept;
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+  ~SharedMemory();
+
+  /// \return start of the mapping, page aligned
+  void* data() const noexcept;
+
+  /// \return size of the mapping
+  size_t size() const noexcept;
+
+  /// \return file descriptor of the object, to share it with other processes
+  int fd() const noexcept;
+
+private:
+  void* m_data;
+  size_t m_size;
+  int m_fd;
+
+  /// Takes ownership of `fd`
+  explicit SharedMemory(int fd, size_t size);
+  void reset() noexcept;
+};
+
+inline void* SharedMemory::data() const noexcept
+{
+  return m_data;
+}
+
+inline size_t SharedMemory::size() const noexcept
+{
+  return m_size;
+}
+
+inline int SharedMemory::fd() const noexcept
+{
+  return m_fd;
+}
+
+} // namespace ni
@@ -18,9 +18,21 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <random>
+
 #include <ni/thirdparty/pcg_random.hpp>
 
 namespace ni
 {
+/// \return generator of the calling thread, seeded from `std::random_device`
+inline pcg32& thread_rng()
+{
+  static thread_local pcg32 rng = []
+  {
+    pcg_extras::seed_seq_from<std::random_device> seed_source;
+    return pcg32(seed_source);
+  }();
+  return rng;
+}
 
 } // namespace ni
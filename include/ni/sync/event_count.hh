@@ -0,0 +1,162 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <limits.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <ni/futex.hh>
+
+namespace ni
+{
+
+/// \brief Condition variable for lock-free data structures
+///
+/// A waiter announces itself with `prepare_wait`, re-checks its condition and
+/// then either gives up with `cancel_wait` or sleeps with `commit_wait`:
+///
+///     while (!queue.pop(&value))
+///     {
+///       EventCount::Key key = event_count.prepare_wait();
+///       if (queue.pop(&value))
+///       {
+///         event_count.cancel_wait();
+///         break;
+///       }
+///       event_count.commit_wait(key);
+///     }
+///
+/// A notifier changes the condition first and then calls `notify`. A wakeup
+/// cannot be lost: a notification which happens after `prepare_wait` makes
+/// `commit_wait` return immediately. `notify` costs a single load when there
+/// is no waiter, the futex is only woken up if a waiter is registered.
+///
+/// \param Shared whether the event count may be shared between processes,
+///        see `BasicFutex`
+template <bool Shared>
+class BasicEventCount
+{
+public:
+  class Key
+  {
+    friend class BasicEventCount;
+
+    explicit Key(int32_t epoch) noexcept;
+
+    int32_t m_epoch;
+  };
+
+  BasicEventCount() noexcept;
+  BasicEventCount(const BasicEventCount&) = delete;
+  BasicEventCount& operator=(const BasicEventCount&) = delete;
+
+  /// \brief Register the calling thread as a waiter
+  /// \return key to pass to `commit_wait`
+  Key prepare_wait() noexcept;
+
+  /// \brief Unregister the calling thread after `prepare_wait`
+  void cancel_wait() noexcept;
+
+  /// \brief Sleep until a notification issued after `prepare_wait` and
+  ///        unregister the calling thread
+  void commit_wait(Key key) noexcept;
+
+  /// \brief Wake up one waiter, if any
+  void notify() noexcept;
+
+  /// \brief Wake up all the waiters, if any
+  void notify_all() noexcept;
+
+private:
+  BasicFutex<Shared> m_epoch;
+  std::atomic<int32_t> m_waiters;
+
+  void notify(int count) noexcept;
+};
+
+/// \brief Event count private to the process
+using EventCount = BasicEventCount<false>;
+
+/// \brief Event count which may be placed in memory shared between processes
+using SharedEventCount = BasicEventCount<true>;
+
+template <bool Shared>
+BasicEventCount<Shared>::Key::Key(int32_t epoch) noexcept
+  : m_epoch(epoch)
+{
+}
+
+template <bool Shared>
+BasicEventCount<Shared>::BasicEventCount() noexcept
+  : m_epoch()
+  , m_waiters()
+{
+}
+
+template <bool Shared>
+typename BasicEventCount<Shared>::Key
+BasicEventCount<Shared>::prepare_wait() noexcept
+{
+  // Ordered before the re-check of the condition by the caller, pairs with
+  // the fence of `notify`
+  m_waiters.fetch_add(1, std::memory_order_seq_cst);
+  return Key(m_epoch.load(std::memory_order_acquire));
+}
+
+template <bool Shared>
+void BasicEventCount<Shared>::cancel_wait() noexcept
+{
+  m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <bool Shared>
+void BasicEventCount<Shared>::commit_wait(Key key) noexcept
+{
+  // `Futex::wait` may return spuriously (e.g. on signals)
+  while (m_epoch.load(std::memory_order_acquire) == key.m_epoch)
+    m_epoch.wait(key.m_epoch);
+  m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <bool Shared>
+void BasicEventCount<Shared>::notify() noexcept
+{
+  notify(1);
+}
+
+template <bool Shared>
+void BasicEventCount<Shared>::notify_all() noexcept
+{
+  notify(INT_MAX);
+}
+
+template <bool Shared>
+void BasicEventCount<Shared>::notify(int count) noexcept
+{
+  // Orders the caller's update of the condition before the load below
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_waiters.load(std::memory_order_relaxed) == 0)
+    return;
+  m_epoch.fetch_add(1, std::memory_order_release);
+  m_epoch.wake(count);
+}
+
+} // namespace ni
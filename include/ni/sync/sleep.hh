@@ -18,6 +18,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 #pragma once
+#include <stdint.h>
 #include <time.h>
 #include <x86intrin.h>
 
@@ -37,13 +38,13 @@ private:
   uint32_t m_spins;
 };
 
-Pause::Pause(uint32_t max_spins) noexcept
+inline Pause::Pause(uint32_t max_spins) noexcept
   : m_max_spins(max_spins)
   , m_spins(0)
 {
 }
 
-void Pause::operator()() noexcept
+inline void Pause::operator()() noexcept
 {
   if (m_spins < m_max_spins)
   {
@@ -57,7 +58,7 @@ void Pause::operator()() noexcept
   }
 }
 
-void Pause::reset() noexcept
+inline void Pause::reset() noexcept
 {
   m_spins = 0;
 }
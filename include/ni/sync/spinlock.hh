@@ -34,9 +34,11 @@ struct SpinLock
   bool try_lock() noexcept;
   void lock() noexcept;
   void unlock() noexcept;
+  bool is_locked() const noexcept;
 
 private:
   std::atomic<bool>* self() noexcept;
+  const std::atomic<bool>* self() const noexcept;
 };
 
 inline bool SpinLock::try_lock() noexcept
@@ -67,11 +69,21 @@ inline void SpinLock::unlock() noexcept
   self()->store(false, std::memory_order_release);
 }
 
+inline bool SpinLock::is_locked() const noexcept
+{
+  return self()->load(std::memory_order_relaxed);
+}
+
 inline std::atomic<bool>* SpinLock::self() noexcept
 {
   return reinterpret_cast<std::atomic<bool>*>(&locked);
 }
 
+inline const std::atomic<bool>* SpinLock::self() const noexcept
+{
+  return reinterpret_cast<const std::atomic<bool>*>(&locked);
+}
+
 static_assert(std::is_pod<SpinLock>::value, "SpinLock should be a POD type");
 
 } // namespace ni
@@ -470,4 +470,19 @@ bool AtomicTaggedPtr<T>::operator!=(TaggedPtr other) const noexcept
   return !(*this == other);
 }
 
+/// \brief Pointer policy of the lock-free containers selecting `TaggedPtr`
+///
+/// Node based containers take such a policy to choose how their links are
+/// represented, see also `WideTaggedPtrTraits`.
+struct TaggedPtrTraits
+{
+  using Tag = TaggedPtr<void>::Tag;
+
+  template <typename T>
+  using Ptr = TaggedPtr<T>;
+
+  template <typename T>
+  using AtomicPtr = AtomicTaggedPtr<TaggedPtr<T>>;
+};
+
 } // namespace ni
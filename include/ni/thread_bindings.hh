@@ -0,0 +1,115 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <ni/preprocessor.hh>
+
+namespace ni
+{
+
+/// \brief Per-object thread-local pointers, cleaned up on thread exit
+///
+/// An object holding a `Key` owns a pointer slot in every thread, found in
+/// O(1) by indexing a thread-local array with the key. A value is bound along
+/// with a cleanup function, which runs when the thread exits unless the key
+/// has been deleted first. The index of a deleted key is reused by the next
+/// key, the serial number of the key tells the stale slots apart.
+///
+/// Creating and deleting keys and running the cleanups are serialized by a
+/// global mutex: a deleted key has no cleanup running anymore.
+class ThreadBindings
+{
+public:
+  /// Called with the `owner` and `value` given to `set` on thread exit. It
+  /// must not create or delete keys.
+  using Cleanup = void (*)(void* owner, void* value);
+
+  struct Key
+  {
+    uint32_t index;
+    uint64_t serial;
+  };
+
+  static Key create_key();
+
+  /// \brief Unbind `key` in every thread, without running the cleanups
+  static void delete_key(const Key& key);
+
+  /// \return value bound to `key` in the calling thread, nullptr if none
+  static void* get(const Key& key) noexcept;
+
+  /// \brief Bind `value` to `key` in the calling thread, replacing the
+  ///        previous value without cleaning it up
+  static void set(const Key& key, void* value, Cleanup cleanup, void* owner);
+
+  /// \brief Unbind `key` in the calling thread without cleaning it up
+  static void reset(const Key& key) noexcept;
+
+private:
+  struct Entry
+  {
+    uint64_t serial;
+    void* value;
+    Cleanup cleanup;
+    void* owner;
+  };
+
+  struct LocalEntries
+  {
+    Entry* data;
+    size_t size;
+  };
+
+  struct ExitHook
+  {
+    ~ExitHook();
+  };
+
+  static std::mutex s_mutex;
+  // Serial of the live key of each index, 0 if the index is free
+  static std::vector<uint64_t> s_serials;
+  static std::vector<uint32_t> s_free_indices;
+  static uint64_t s_next_serial;
+
+  static thread_local LocalEntries t_entries;
+  static thread_local ExitHook t_exit_hook;
+};
+
+inline void* ThreadBindings::get(const Key& key) noexcept
+{
+  LocalEntries& entries = t_entries;
+  if (NI_UNLIKELY(key.index >= entries.size))
+    return nullptr;
+  const Entry& entry = entries.data[key.index];
+  return entry.serial == key.serial ? entry.value : nullptr;
+}
+
+inline void ThreadBindings::reset(const Key& key) noexcept
+{
+  LocalEntries& entries = t_entries;
+  if (key.index < entries.size && entries.data[key.index].serial == key.serial)
+    entries.data[key.index] = Entry();
+}
+
+} // namespace ni
@@ -0,0 +1,291 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include <ni/dwcas.hh>
+
+namespace ni
+{
+
+/// \brief 128-bit tagged pointer storing a full 64-bit pointer and a 64-bit
+///        tag.
+///
+/// Unlike `TaggedPtr`, the tag does not wrap around in practice and any
+/// virtual address (e.g. with 5-level paging) can be stored, at the cost of
+/// a double width CAS in `AtomicWideTaggedPtr`.
+template <typename T>
+class WideTaggedPtr
+{
+public:
+  using RawType = DoubleWord;
+  using Tag = uint64_t;
+  using Value = T*;
+  // `low` holds the pointer, `high` the tag
+  RawType raw_value;
+
+  WideTaggedPtr() noexcept;
+  explicit WideTaggedPtr(RawType raw) noexcept;
+  WideTaggedPtr(Value value) noexcept;
+  WideTaggedPtr(Value value, Tag tag) noexcept;
+
+  Value value() const noexcept;
+  Tag tag() const noexcept;
+  void set_value(Value value) noexcept;
+  void set_tag(Tag tag) noexcept;
+  void clear_tag() noexcept;
+
+  bool operator==(WideTaggedPtr other) const noexcept;
+  bool operator!=(WideTaggedPtr other) const noexcept;
+};
+
+template <typename T>
+WideTaggedPtr<T>::WideTaggedPtr() noexcept : raw_value()
+{
+}
+
+template <typename T>
+WideTaggedPtr<T>::WideTaggedPtr(RawType raw) noexcept : raw_value(raw)
+{
+}
+
+template <typename T>
+WideTaggedPtr<T>::WideTaggedPtr(Value value) noexcept
+  : raw_value{reinterpret_cast<uint64_t>(value), 0}
+{
+}
+
+template <typename T>
+WideTaggedPtr<T>::WideTaggedPtr(Value value, Tag tag) noexcept
+  : raw_value{reinterpret_cast<uint64_t>(value), tag}
+{
+}
+
+template <typename T>
+typename WideTaggedPtr<T>::Value WideTaggedPtr<T>::value() const noexcept
+{
+  return reinterpret_cast<Value>(raw_value.low);
+}
+
+template <typename T>
+typename WideTaggedPtr<T>::Tag WideTaggedPtr<T>::tag() const noexcept
+{
+  return raw_value.high;
+}
+
+template <typename T>
+void WideTaggedPtr<T>::set_value(Value value) noexcept
+{
+  raw_value.low = reinterpret_cast<uint64_t>(value);
+}
+
+template <typename T>
+void WideTaggedPtr<T>::set_tag(Tag tag) noexcept
+{
+  raw_value.high = tag;
+}
+
+template <typename T>
+void WideTaggedPtr<T>::clear_tag() noexcept
+{
+  raw_value.high = 0;
+}
+
+template <typename T>
+bool WideTaggedPtr<T>::operator==(WideTaggedPtr other) const noexcept
+{
+  return raw_value == other.raw_value;
+}
+
+template <typename T>
+bool WideTaggedPtr<T>::operator!=(WideTaggedPtr other) const noexcept
+{
+  return !(*this == other);
+}
+
+/// \brief Provides atomic access to wide tagged pointers.
+///
+/// Read-modify-write operations use `dwcas` and are always sequentially
+/// consistent whatever the requested memory order. `load` reads the two words
+/// separately and retries until the tag is stable around the read of the
+/// pointer: the snapshot is consistent as long as every update of the pointer
+/// also changes the tag, which is how the tag is used as an ABA counter.
+template <typename T>
+class AtomicWideTaggedPtr
+{
+public:
+  using TaggedPtr = T;
+
+  AtomicWideTaggedPtr();
+  constexpr AtomicWideTaggedPtr(TaggedPtr tagged_ptr);
+  AtomicWideTaggedPtr(const AtomicWideTaggedPtr&) = delete;
+  AtomicWideTaggedPtr& operator=(const AtomicWideTaggedPtr&) = delete;
+
+  bool is_lock_free() const;
+
+  void store(TaggedPtr desired,
+             std::memory_order order = std::memory_order_seq_cst);
+
+  TaggedPtr load(std::memory_order order = std::memory_order_seq_cst) const;
+
+  operator TaggedPtr() const;
+
+  TaggedPtr exchange(TaggedPtr desired,
+                     std::memory_order order = std::memory_order_seq_cst);
+
+  bool compare_exchange_weak(TaggedPtr& expected, TaggedPtr desired,
+                             std::memory_order success,
+                             std::memory_order failure);
+  bool compare_exchange_weak(
+    TaggedPtr& expected, TaggedPtr desired,
+    std::memory_order order = std::memory_order_seq_cst);
+
+  bool compare_exchange_strong(TaggedPtr& expected, TaggedPtr desired,
+                               std::memory_order success,
+                               std::memory_order failure);
+  bool compare_exchange_strong(
+    TaggedPtr& expected, TaggedPtr desired,
+    std::memory_order order = std::memory_order_seq_cst);
+
+  bool operator==(TaggedPtr other) const noexcept;
+  bool operator!=(TaggedPtr other) const noexcept;
+
+private:
+  DoubleWord m_raw_value;
+};
+
+template <typename T>
+AtomicWideTaggedPtr<T>::AtomicWideTaggedPtr()
+  : m_raw_value()
+{
+}
+
+template <typename T>
+constexpr AtomicWideTaggedPtr<T>::AtomicWideTaggedPtr(TaggedPtr tagged_ptr)
+  : m_raw_value(tagged_ptr.raw_value)
+{
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::is_lock_free() const
+{
+  return true;
+}
+
+template <typename T>
+void AtomicWideTaggedPtr<T>::store(TaggedPtr desired, std::memory_order order)
+{
+  exchange(desired, order);
+}
+
+template <typename T>
+typename AtomicWideTaggedPtr<T>::TaggedPtr AtomicWideTaggedPtr<T>::load(
+  std::memory_order order) const
+{
+  int word_order = order == std::memory_order_relaxed ? __ATOMIC_RELAXED
+                                                      : __ATOMIC_ACQUIRE;
+  DoubleWord raw;
+  uint64_t tag = __atomic_load_n(&m_raw_value.high, word_order);
+  while (true)
+  {
+    raw.low = __atomic_load_n(&m_raw_value.low, __ATOMIC_ACQUIRE);
+    raw.high = __atomic_load_n(&m_raw_value.high, word_order);
+    if (raw.high == tag)
+      return TaggedPtr(raw);
+    tag = raw.high;
+  }
+}
+
+template <typename T>
+AtomicWideTaggedPtr<T>::operator TaggedPtr() const
+{
+  return load();
+}
+
+template <typename T>
+typename AtomicWideTaggedPtr<T>::TaggedPtr
+AtomicWideTaggedPtr<T>::exchange(TaggedPtr desired, std::memory_order order)
+{
+  TaggedPtr expected = load(std::memory_order_relaxed);
+  while (!dwcas(&m_raw_value, expected.raw_value, desired.raw_value))
+    ;
+  return expected;
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::compare_exchange_weak(TaggedPtr& expected,
+                                                   TaggedPtr desired,
+                                                   std::memory_order success,
+                                                   std::memory_order failure)
+{
+  return dwcas(&m_raw_value, expected.raw_value, desired.raw_value);
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::compare_exchange_weak(TaggedPtr& expected,
+                                                   TaggedPtr desired,
+                                                   std::memory_order order)
+{
+  return dwcas(&m_raw_value, expected.raw_value, desired.raw_value);
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::compare_exchange_strong(
+  TaggedPtr& expected, TaggedPtr desired, std::memory_order success,
+  std::memory_order failure)
+{
+  return dwcas(&m_raw_value, expected.raw_value, desired.raw_value);
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::compare_exchange_strong(TaggedPtr& expected,
+                                                     TaggedPtr desired,
+                                                     std::memory_order order)
+{
+  return dwcas(&m_raw_value, expected.raw_value, desired.raw_value);
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::operator==(TaggedPtr other) const noexcept
+{
+  return load() == other;
+}
+
+template <typename T>
+bool AtomicWideTaggedPtr<T>::operator!=(TaggedPtr other) const noexcept
+{
+  return !(*this == other);
+}
+
+/// \brief Pointer policy of the lock-free containers selecting
+///        `WideTaggedPtr`, see `TaggedPtrTraits`
+struct WideTaggedPtrTraits
+{
+  using Tag = WideTaggedPtr<void>::Tag;
+
+  template <typename T>
+  using Ptr = WideTaggedPtr<T>;
+
+  template <typename T>
+  using AtomicPtr = AtomicWideTaggedPtr<WideTaggedPtr<T>>;
+};
+
+} // namespace ni
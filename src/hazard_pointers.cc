@@ -0,0 +1,154 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <ni/hazard_pointers.hh>
+
+#include <algorithm>
+
+namespace ni
+{
+
+std::atomic<HazardPointers::Record*> HazardPointers::s_records(nullptr);
+std::atomic<size_t> HazardPointers::s_record_count(0);
+thread_local HazardPointers::Record* HazardPointers::t_record;
+thread_local bool HazardPointers::t_exited;
+thread_local HazardPointers::ExitHook HazardPointers::t_exit_hook;
+
+HazardPointers::Record::Record()
+  : slots()
+  , active(true)
+  , next()
+  , free_slots((1u << SLOTS_PER_THREAD) - 1)
+  , retired()
+{
+}
+
+HazardPointers::ExitHook::~ExitHook()
+{
+  if (t_record)
+    release_record(t_record);
+  t_record = nullptr;
+  t_exited = true;
+}
+
+void HazardPointers::retire(void* ptr, Deleter deleter)
+{
+  Record* record = local_record();
+  record->retired.push_back(Retired{ptr, deleter});
+
+  size_t threshold = std::max(
+    MIN_SCAN_THRESHOLD,
+    2 * SLOTS_PER_THREAD * s_record_count.load(std::memory_order_relaxed));
+  if (record->retired.size() >= threshold)
+    scan(record);
+  if (NI_UNLIKELY(t_exited))
+    release_exited();
+}
+
+void HazardPointers::scan()
+{
+  scan(local_record());
+  if (NI_UNLIKELY(t_exited))
+    release_exited();
+}
+
+HazardPointers::Record* HazardPointers::acquire_record()
+{
+  // Registers the destructor of the hook on the first acquisition
+  static_cast<void>(&t_exit_hook);
+
+  for (Record* record = s_records.load(std::memory_order_acquire); record;
+       record = record->next)
+  {
+    bool expected = false;
+    if (!record->active.load(std::memory_order_relaxed) &&
+        record->active.compare_exchange_strong(expected, true,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed))
+      return record;
+  }
+
+  Record* record = new Record();
+  Record* head = s_records.load(std::memory_order_relaxed);
+  do
+    record->next = head;
+  while (!s_records.compare_exchange_weak(head, record,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+  s_record_count.fetch_add(1, std::memory_order_relaxed);
+  return record;
+}
+
+void HazardPointers::release_record(Record* record) noexcept
+{
+  for (auto& slot : record->slots)
+    slot.store(nullptr, std::memory_order_relaxed);
+  record->free_slots = (1u << SLOTS_PER_THREAD) - 1;
+
+  // Objects which are still protected are inherited by the next owner of the
+  // record
+  try
+  {
+    scan(record);
+  }
+  catch (...)
+  {
+  }
+  record->active.store(false, std::memory_order_release);
+}
+
+void HazardPointers::release_exited() noexcept
+{
+  // Unless guards of the thread are still alive
+  Record* record = t_record;
+  if (record->free_slots != (1u << SLOTS_PER_THREAD) - 1)
+    return;
+  t_record = nullptr;
+  release_record(record);
+}
+
+void HazardPointers::scan(Record* record)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  std::vector<const void*> hazards;
+  for (Record* r = s_records.load(std::memory_order_acquire); r; r = r->next)
+  {
+    for (auto& slot : r->slots)
+    {
+      const void* ptr = slot.load(std::memory_order_acquire);
+      if (ptr)
+        hazards.push_back(ptr);
+    }
+  }
+  std::sort(hazards.begin(), hazards.end());
+
+  // Deleters are allowed to retire other objects
+  std::vector<Retired> retired;
+  retired.swap(record->retired);
+  for (const Retired& r : retired)
+  {
+    if (std::binary_search(hazards.begin(), hazards.end(), r.ptr))
+      record->retired.push_back(r);
+    else
+      r.deleter(r.ptr);
+  }
+}
+
+} // namespace ni
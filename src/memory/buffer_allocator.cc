@@ -0,0 +1,100 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <ni/memory/buffer_allocator.hh>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+namespace ni
+{
+
+constexpr int MappedBufferAllocator::ANY_NODE;
+constexpr size_t MappedBufferAllocator::HUGE_PAGE_SIZE;
+
+MappedBufferAllocator::MappedBufferAllocator(unsigned flags,
+                                             int numa_node) noexcept
+  : m_flags(flags)
+  , m_numa_node(numa_node)
+{
+}
+
+void* MappedBufferAllocator::allocate(size_t bytes, size_t alignment) const
+{
+  size_t size = reserved_size(bytes);
+  assert(alignment <= static_cast<size_t>(sysconf(_SC_PAGESIZE)) &&
+         "mappings are only page aligned");
+
+  const int prot = PROT_READ | PROT_WRITE;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* ptr = MAP_FAILED;
+  if (m_flags & HUGE_PAGES)
+    ptr = mmap(nullptr, size, prot, flags | MAP_HUGETLB, -1, 0);
+  if (ptr == MAP_FAILED)
+  {
+    ptr = mmap(nullptr, size, prot, flags, -1, 0);
+    if (ptr == MAP_FAILED)
+      throw std::system_error(errno, std::system_category(), __func__);
+    if (m_flags & HUGE_PAGES)
+      madvise(ptr, size, MADV_HUGEPAGE);
+  }
+
+  // Must happen before the pages are faulted in, `mbind` does not move them
+  // without MPOL_MF_MOVE
+  if (m_numa_node >= 0 && m_numa_node < static_cast<int>(sizeof(long) * 8))
+  {
+    unsigned long nodemask = 1ul << m_numa_node;
+    syscall(SYS_mbind, ptr, size, MPOL_BIND, &nodemask,
+            sizeof(nodemask) * CHAR_BIT, 0);
+  }
+
+  if (m_flags & PREFAULT)
+  {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    volatile char* page = static_cast<char*>(ptr);
+    for (size_t offset = 0; offset < size; offset += page_size)
+      page[offset] = 0;
+  }
+  if (m_flags & LOCK)
+    mlock(ptr, size);
+
+  return ptr;
+}
+
+void MappedBufferAllocator::deallocate(void* ptr, size_t bytes) const noexcept
+{
+  munmap(ptr, reserved_size(bytes));
+}
+
+size_t MappedBufferAllocator::reserved_size(size_t bytes) const noexcept
+{
+  size_t granularity = (m_flags & HUGE_PAGES)
+                         ? HUGE_PAGE_SIZE
+                         : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return (bytes + granularity - 1) & ~(granularity - 1);
+}
+
+} // namespace ni
@@ -0,0 +1,81 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <ni/memory/double_mapped_buffer.hh>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <system_error>
+
+#include <ni/scope_guard.hh>
+
+namespace ni
+{
+
+DoubleMappedBuffer::DoubleMappedBuffer(size_t size)
+  : m_data()
+  , m_size(size)
+{
+  assert(size && size % page_size() == 0 &&
+         "size must be a multiple of the page size");
+
+  int fd = memfd_create("ni::DoubleMappedBuffer", MFD_CLOEXEC);
+  if (fd < 0)
+    throw std::system_error(errno, std::system_category(), __func__);
+  NI_DEFER [fd]()
+  {
+    close(fd);
+  };
+  if (ftruncate(fd, size))
+    throw std::system_error(errno, std::system_category(), __func__);
+
+  // Reserve the whole range first so that both mappings are adjacent
+  void* base =
+    mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    throw std::system_error(errno, std::system_category(), __func__);
+  m_data = static_cast<char*>(base);
+
+  for (char* half : {m_data, m_data + size})
+  {
+    if (mmap(half, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+             0) == MAP_FAILED)
+    {
+      int rc = errno;
+      munmap(m_data, 2 * size);
+      throw std::system_error(rc, std::system_category(), __func__);
+    }
+  }
+}
+
+DoubleMappedBuffer::~DoubleMappedBuffer()
+{
+  munmap(m_data, 2 * m_size);
+}
+
+size_t DoubleMappedBuffer::page_size() noexcept
+{
+  static const size_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+} // namespace ni
@@ -0,0 +1,156 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <ni/memory/shared_memory.hh>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+namespace ni
+{
+namespace
+{
+int check(int rv, const char* what)
+{
+  if (rv < 0)
+    throw std::system_error(errno, std::system_category(), what);
+  return rv;
+}
+
+// Sizes the object, closes `fd` on failure
+int truncate(int fd, size_t size, const char* what)
+{
+  if (ftruncate(fd, size))
+  {
+    int rc = errno;
+    close(fd);
+    throw std::system_error(rc, std::system_category(), what);
+  }
+  return fd;
+}
+
+size_t size_of(int fd, const char* what)
+{
+  struct stat st;
+  if (fstat(fd, &st))
+  {
+    int rc = errno;
+    close(fd);
+    throw std::system_error(rc, std::system_category(), what);
+  }
+  return st.st_size;
+}
+
+} // namespace
+
+SharedMemory SharedMemory::create(size_t size)
+{
+  int fd = check(memfd_create("ni::SharedMemory", MFD_CLOEXEC), __func__);
+  return SharedMemory(truncate(fd, size, __func__), size);
+}
+
+SharedMemory SharedMemory::create(const char* name, size_t size)
+{
+  int fd = check(shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600),
+                 __func__);
+  try
+  {
+    return SharedMemory(truncate(fd, size, __func__), size);
+  }
+  catch (...)
+  {
+    shm_unlink(name);
+    throw;
+  }
+}
+
+SharedMemory SharedMemory::open(const char* name)
+{
+  int fd = check(shm_open(name, O_RDWR | O_CLOEXEC, 0), __func__);
+  return SharedMemory(fd, size_of(fd, __func__));
+}
+
+SharedMemory SharedMemory::open(int fd)
+{
+  fd = check(fcntl(fd, F_DUPFD_CLOEXEC, 0), __func__);
+  return SharedMemory(fd, size_of(fd, __func__));
+}
+
+void SharedMemory::unlink(const char* name) noexcept
+{
+  shm_unlink(name);
+}
+
+SharedMemory::SharedMemory(int fd, size_t size)
+  : m_data()
+  , m_size(size)
+  , m_fd(fd)
+{
+  m_data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (m_data == MAP_FAILED)
+  {
+    int rc = errno;
+    close(fd);
+    throw std::system_error(rc, std::system_category(), __func__);
+  }
+}
+
+SharedMemory::SharedMemory(SharedMemory&& other) noexcept
+  : m_data(other.m_data)
+  , m_size(other.m_size)
+  , m_fd(other.m_fd)
+{
+  other.m_data = nullptr;
+  other.m_fd = -1;
+}
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept
+{
+  if (this != &other)
+  {
+    reset();
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_fd, other.m_fd);
+  }
+  return *this;
+}
+
+SharedMemory::~SharedMemory()
+{
+  reset();
+}
+
+void SharedMemory::reset() noexcept
+{
+  if (m_data)
+    munmap(m_data, m_size);
+  if (m_fd >= 0)
+    close(m_fd);
+  m_data = nullptr;
+  m_fd = -1;
+}
+
+} // namespace ni
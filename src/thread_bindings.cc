@@ -0,0 +1,96 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <ni/thread_bindings.hh>
+
+#include <algorithm>
+
+namespace ni
+{
+
+std::mutex ThreadBindings::s_mutex;
+std::vector<uint64_t> ThreadBindings::s_serials;
+std::vector<uint32_t> ThreadBindings::s_free_indices;
+uint64_t ThreadBindings::s_next_serial = 1;
+thread_local ThreadBindings::LocalEntries ThreadBindings::t_entries;
+thread_local ThreadBindings::ExitHook ThreadBindings::t_exit_hook;
+
+ThreadBindings::Key ThreadBindings::create_key()
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  Key key;
+  key.serial = s_next_serial++;
+  if (s_free_indices.empty())
+  {
+    key.index = static_cast<uint32_t>(s_serials.size());
+    s_serials.push_back(key.serial);
+  }
+  else
+  {
+    key.index = s_free_indices.back();
+    s_free_indices.pop_back();
+    s_serials[key.index] = key.serial;
+  }
+  return key;
+}
+
+void ThreadBindings::delete_key(const Key& key)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  s_serials[key.index] = 0;
+  s_free_indices.push_back(key.index);
+}
+
+void ThreadBindings::set(const Key& key, void* value, Cleanup cleanup,
+                         void* owner)
+{
+  LocalEntries& entries = t_entries;
+  if (key.index >= entries.size)
+  {
+    // Instantiate the hook of the thread along with its first entries
+    static_cast<void>(&t_exit_hook);
+
+    size_t size = std::max<size_t>(key.index + 1, 2 * entries.size);
+    Entry* data = new Entry[size]();
+    std::copy(entries.data, entries.data + entries.size, data);
+    delete[] entries.data;
+    entries.data = data;
+    entries.size = size;
+  }
+  entries.data[key.index] = Entry{key.serial, value, cleanup, owner};
+}
+
+ThreadBindings::ExitHook::~ExitHook()
+{
+  LocalEntries& entries = t_entries;
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (size_t i = 0; i < entries.size; ++i)
+    {
+      Entry entry = entries.data[i];
+      if (entry.value && entry.cleanup && s_serials[i] == entry.serial)
+        entry.cleanup(entry.owner, entry.value);
+    }
+  }
+  delete[] entries.data;
+  entries.data = nullptr;
+  entries.size = 0;
+}
+
+} // namespace ni
@@ -0,0 +1,128 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/blocking_queue.hh>
+#include <ni/cds/bounded_mpmc_queue.hh>
+#include <ni/cds/ms_queue.hh>
+
+using namespace ni;
+
+TEST_CASE("BlockingQueue-Wakeup")
+{
+  BlockingQueue<MSQueue<int>> queue;
+  std::atomic<bool> done(false);
+
+  std::thread consumer([&]
+                       {
+                         int value;
+                         queue.get(&value);
+                         REQUIRE(value == 42);
+                         done = true;
+                       });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE_FALSE(done);
+  queue.put(42);
+  consumer.join();
+  REQUIRE(done);
+
+  int value;
+  REQUIRE_FALSE(queue.try_get(&value));
+}
+
+TEST_CASE("BlockingQueue-MPMC")
+{
+  const int PRODUCERS = 2;
+  const int CONSUMERS = 3;
+  const int ITEMS = 30000;
+  BlockingQueue<BoundedMPMCQueue<int>> queue(1024);
+
+  std::atomic<int> in(0);
+  std::atomic<long> sum(0);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < ITEMS; ++i)
+        {
+          int value = in.fetch_add(1, std::memory_order_relaxed);
+          while (!queue.put(value))
+            std::this_thread::yield();
+        }
+      });
+  }
+
+  // Every consumer gets the same number of elements, so none of them blocks
+  // forever
+  for (int c = 0; c < CONSUMERS; ++c)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        int value;
+        for (int i = 0; i < PRODUCERS * ITEMS / CONSUMERS; ++i)
+        {
+          queue.get(&value);
+          sum.fetch_add(value, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  const long total = PRODUCERS * ITEMS;
+  REQUIRE(sum == (0 + total - 1) * total / 2);
+  REQUIRE(queue.queue().empty());
+}
+
+TEST_CASE("BlockingQueue-Bulk")
+{
+  BlockingQueue<MSQueue<int>> queue;
+  std::atomic<int> sum(0);
+  std::vector<std::thread> consumers;
+
+  for (int c = 0; c < 4; ++c)
+  {
+    consumers.emplace_back([&]
+                           {
+                             int value;
+                             queue.get(&value);
+                             sum += value;
+                           });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  int values[] = {1, 2, 3, 4};
+  REQUIRE(queue.put_bulk(values, values + 4) == 4);
+
+  for (auto& t : consumers)
+    t.join();
+  REQUIRE(sum == 10);
+}
@@ -0,0 +1,171 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/bounded_mpmc_queue.hh>
+
+using namespace ni;
+
+TEST_CASE("BoundedMPMCQueue-Capacity")
+{
+  BoundedMPMCQueue<int> queue(4);
+  REQUIRE(queue.size() == 4);
+  REQUIRE(queue.empty());
+  REQUIRE(queue.size_approx() == 0);
+
+  int value;
+  REQUIRE_FALSE(queue.pop(&value));
+
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(queue.push(i));
+  REQUIRE_FALSE(queue.push(4));
+  REQUIRE_FALSE(queue.empty());
+  REQUIRE(queue.size_approx() == 4);
+
+  REQUIRE(queue.pop(&value));
+  REQUIRE(value == 0);
+  REQUIRE(queue.size_approx() == 3);
+  REQUIRE(queue.push(4));
+
+  for (int i = 1; i <= 4; ++i)
+  {
+    REQUIRE(queue.get(&value));
+    REQUIRE(value == i);
+  }
+  REQUIRE(queue.empty());
+  REQUIRE(queue.size_approx() == 0);
+}
+
+TEST_CASE("BoundedMPMCQueue-Destruction")
+{
+  auto item = std::make_shared<int>(0);
+  {
+    BoundedMPMCQueue<std::shared_ptr<int>> queue(8);
+    queue.push(item);
+    queue.push(item);
+    std::shared_ptr<int> value;
+    REQUIRE(queue.pop(&value));
+    REQUIRE(item.use_count() == 3);
+  }
+  REQUIRE(item.use_count() == 1);
+}
+
+namespace
+{
+struct ThrowingCopy
+{
+  static bool fail;
+  int value;
+
+  explicit ThrowingCopy(int value)
+    : value(value)
+  {
+  }
+
+  ThrowingCopy(const ThrowingCopy& other)
+    : value(other.value)
+  {
+    if (fail)
+      throw std::runtime_error("copy");
+  }
+
+  ThrowingCopy(ThrowingCopy&&) noexcept = default;
+  ThrowingCopy& operator=(ThrowingCopy&&) noexcept = default;
+};
+
+bool ThrowingCopy::fail = false;
+
+} // namespace
+
+TEST_CASE("BoundedMPMCQueue-ThrowingConstructor")
+{
+  BoundedMPMCQueue<ThrowingCopy> queue(4);
+  ThrowingCopy element(1);
+
+  ThrowingCopy::fail = true;
+  REQUIRE_THROWS_AS(queue.push(element), std::runtime_error);
+  ThrowingCopy::fail = false;
+
+  // No element is made up for the failed push
+  ThrowingCopy value(0);
+  REQUIRE(queue.empty());
+  REQUIRE_FALSE(queue.pop(&value));
+
+  REQUIRE(queue.push(element));
+  REQUIRE(queue.pop(&value));
+  REQUIRE(value.value == 1);
+  REQUIRE_FALSE(queue.pop(&value));
+}
+
+TEST_CASE("BoundedMPMCQueue-MPMC")
+{
+  const int PRODUCERS = 3;
+  const int ITEMS = 20000;
+  BoundedMPMCQueue<int> queue(64);
+
+  std::atomic<int> in(0);
+  std::atomic<long> sum(0);
+  std::atomic<int> popped(0);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < ITEMS; ++i)
+        {
+          int value = in.fetch_add(1, std::memory_order_relaxed);
+          while (!queue.push(value))
+            std::this_thread::yield();
+        }
+      });
+  }
+
+  for (int c = 0; c < 3; ++c)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        int value;
+        while (popped.load(std::memory_order_relaxed) < PRODUCERS * ITEMS)
+        {
+          if (queue.pop(&value))
+          {
+            sum.fetch_add(value, std::memory_order_relaxed);
+            popped.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  const long total = PRODUCERS * ITEMS;
+  REQUIRE(sum == (0 + total - 1) * total / 2);
+  REQUIRE(queue.empty());
+}
@@ -0,0 +1,193 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/concurrent_hash_map.hh>
+
+using namespace ni;
+
+TEST_CASE("ConcurrentHashMap-Sequential")
+{
+  ConcurrentHashMap<int, int> map;
+  int value;
+
+  REQUIRE_FALSE(map.find(1, &value));
+  REQUIRE(map.insert(1, 10));
+  REQUIRE_FALSE(map.insert(1, 11));
+  REQUIRE(map.find(1, &value));
+  REQUIRE(value == 10);
+
+  REQUIRE_FALSE(map.insert_or_assign(1, 12));
+  REQUIRE(map.find(1, &value));
+  REQUIRE(value == 12);
+
+  REQUIRE(map.erase(1));
+  REQUIRE_FALSE(map.erase(1));
+  REQUIRE_FALSE(map.contains(1));
+  REQUIRE(map.insert_or_assign(1, 13));
+  REQUIRE(map.find(1, &value));
+  REQUIRE(value == 13);
+  REQUIRE(map.size_approx() == 1);
+
+  // Grow several times
+  for (int i = 2; i < 10000; ++i)
+    REQUIRE(map.insert(i, i * 10));
+  REQUIRE(map.size_approx() == 9999);
+  REQUIRE(map.capacity() >= 9999);
+  for (int i = 2; i < 10000; ++i)
+  {
+    REQUIRE(map.find(i, &value));
+    REQUIRE(value == i * 10);
+  }
+
+  // Deleted entries are dropped by resizes, which do not grow the table
+  size_t capacity = map.capacity();
+  for (int round = 0; round < 10; ++round)
+  {
+    for (int i = 2; i < 10000; ++i)
+      REQUIRE(map.erase(i));
+    for (int i = 2; i < 10000; ++i)
+      REQUIRE(map.insert(i + round * 10000, i));
+    for (int i = 2; i < 10000; ++i)
+      REQUIRE(map.erase(i + round * 10000));
+    for (int i = 2; i < 10000; ++i)
+      REQUIRE(map.insert(i, i * 10));
+  }
+  REQUIRE(map.capacity() <= capacity * 2);
+  REQUIRE(map.size_approx() == 9999);
+}
+
+TEST_CASE("ConcurrentHashMap-StringKeys")
+{
+  ConcurrentHashMap<std::string, size_t> map;
+  std::string key;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    // Keys longer than a chunk of the hasher
+    key += static_cast<char>('a' + i % 26);
+    REQUIRE(map.insert(key, i));
+  }
+
+  key.clear();
+  size_t value;
+  for (size_t i = 0; i < 1000; ++i)
+  {
+    key += static_cast<char>('a' + i % 26);
+    REQUIRE(map.find(key, &value));
+    REQUIRE(value == i);
+  }
+  REQUIRE_FALSE(map.contains("0"));
+}
+
+TEST_CASE("ConcurrentHashMap-Concurrent")
+{
+  const int THREADS = 4;
+  const int KEYS = 20000;
+  ConcurrentHashMap<int, int> map;
+  std::atomic<bool> failed(false);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           int value;
+                           for (int i = t; i < KEYS; i += THREADS)
+                           {
+                             if (!map.insert(i, i) || !map.find(i, &value) ||
+                                 value != i)
+                               failed = true;
+                             map.insert_or_assign(i, -i);
+                             if (i % 3 == 0 && !map.erase(i))
+                               failed = true;
+                           }
+                         });
+  }
+  // Readers running while the table grows
+  for (int t = 0; t < 2; ++t)
+  {
+    threads.emplace_back([&]
+                         {
+                           int value;
+                           for (int round = 0; round < 5; ++round)
+                           {
+                             for (int i = 0; i < KEYS; ++i)
+                             {
+                               if (map.find(i, &value) && value != i &&
+                                   value != -i)
+                                 failed = true;
+                             }
+                           }
+                         });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE_FALSE(failed);
+  int value;
+  for (int i = 0; i < KEYS; ++i)
+  {
+    if (i % 3 == 0)
+      REQUIRE_FALSE(map.find(i, &value));
+    else
+    {
+      REQUIRE(map.find(i, &value));
+      REQUIRE(value == -i);
+    }
+  }
+  REQUIRE(map.size_approx() == static_cast<size_t>(KEYS - (KEYS + 2) / 3));
+}
+
+TEST_CASE("ConcurrentHashMap-SameKeys")
+{
+  const int THREADS = 4;
+  const int KEYS = 1000;
+  ConcurrentHashMap<int, int> map;
+  std::atomic<int> inserted(0);
+  std::atomic<int> erased(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&]
+                         {
+                           for (int round = 0; round < 20; ++round)
+                           {
+                             for (int i = 0; i < KEYS; ++i)
+                             {
+                               if (map.insert(i + round * KEYS, i))
+                                 ++inserted;
+                               if (map.erase(i + round * KEYS))
+                                 ++erased;
+                             }
+                           }
+                         });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(inserted == erased);
+  REQUIRE(map.size_approx() == 0);
+}
@@ -0,0 +1,145 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/concurrent_skip_list_map.hh>
+
+using namespace ni;
+
+TEST_CASE("ConcurrentSkipListMap-Sequential")
+{
+  ConcurrentSkipListMap<int, std::string> map;
+  std::string value;
+
+  REQUIRE(map.begin() == map.end());
+  REQUIRE_FALSE(map.find(1, &value));
+
+  for (int i = 0; i < 1000; i += 2)
+    REQUIRE(map.insert(i, std::to_string(i)));
+  REQUIRE_FALSE(map.insert(10, "ten"));
+  REQUIRE(map.find(10, &value));
+  REQUIRE(value == "10");
+  REQUIRE_FALSE(map.contains(11));
+
+  auto it = map.lower_bound(11);
+  REQUIRE(it != map.end());
+  REQUIRE(it.key() == 12);
+  REQUIRE(it.value() == "12");
+  REQUIRE(map.lower_bound(12).key() == 12);
+  REQUIRE(map.lower_bound(999) == map.end());
+
+  REQUIRE(map.erase(12));
+  REQUIRE_FALSE(map.erase(12));
+  REQUIRE_FALSE(map.contains(12));
+  // Erased under the iterator
+  REQUIRE(it.key() == 12);
+  ++it;
+  REQUIRE(it.key() == 14);
+
+  int expected = 0;
+  for (auto i = map.begin(); i != map.end(); ++i, expected += 2)
+  {
+    if (expected == 12)
+      expected += 2;
+    REQUIRE(i.key() == expected);
+  }
+  REQUIRE(expected == 1000);
+
+  REQUIRE(map.insert(12, "twelve"));
+  REQUIRE(map.find(12, &value));
+  REQUIRE(value == "twelve");
+}
+
+TEST_CASE("ConcurrentSkipListMap-Concurrent")
+{
+  const int THREADS = 4;
+  const int KEYS = 4000;
+  ConcurrentSkipListMap<int, int> map;
+  std::atomic<int> inserted(0);
+  std::atomic<int> erased(0);
+  std::atomic<bool> failed(false);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           int value;
+                           for (int round = 0; round < 5; ++round)
+                           {
+                             for (int i = 0; i < KEYS; ++i)
+                             {
+                               int key = (i * 7 + t) % KEYS;
+                               if (map.insert(key, key))
+                                 ++inserted;
+                               if (map.find(key, &value) && value != key)
+                                 failed = true;
+                               if ((key + round) % 3 == 0 && map.erase(key))
+                                 ++erased;
+                             }
+                           }
+                         });
+  }
+  // Iterations run concurrently with the updates
+  threads.emplace_back([&]
+                       {
+                         for (int round = 0; round < 20; ++round)
+                         {
+                           int last = -1;
+                           for (auto it = map.begin(); it != map.end(); ++it)
+                           {
+                             if (it.key() <= last || it.value() != it.key())
+                               failed = true;
+                             last = it.key();
+                           }
+                         }
+                       });
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE_FALSE(failed);
+  int count = 0;
+  int last = -1;
+  for (auto it = map.begin(); it != map.end(); ++it, ++count)
+  {
+    REQUIRE(it.key() > last);
+    last = it.key();
+  }
+  REQUIRE(count == inserted - erased);
+}
+
+TEST_CASE("ConcurrentSkipListMap-HeapNodeAllocator")
+{
+  ConcurrentSkipListMap<int, int, std::greater<int>, HeapNodeAllocator> map;
+  for (int i = 0; i < 100; ++i)
+    REQUIRE(map.insert(i, i));
+  for (int i = 0; i < 100; i += 2)
+    REQUIRE(map.erase(i));
+
+  int expected = 99;
+  for (auto it = map.begin(); it != map.end(); ++it, expected -= 2)
+    REQUIRE(it.key() == expected);
+  REQUIRE(expected == -1);
+}
@@ -0,0 +1,104 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/flat_combining.hh>
+
+using namespace ni;
+
+TEST_CASE("FlatCombining-Sequential")
+{
+  using Heap = FlatCombining<std::priority_queue<int>>;
+  Heap heap(1);
+  Heap::RecordPtr record;
+
+  for (int i : { 3, 1, 4, 1, 5 })
+    heap.apply(record, [i](std::priority_queue<int>& q) { q.push(i); });
+  REQUIRE(record);
+
+  size_t size =
+    heap.apply(record, [](std::priority_queue<int>& q) { return q.size(); });
+  REQUIRE(size == 5);
+
+  int top = heap.apply(record, [](std::priority_queue<int>& q)
+                       {
+                         int value = q.top();
+                         q.pop();
+                         return value;
+                       });
+  REQUIRE(top == 5);
+
+  REQUIRE_THROWS_AS(heap.apply(record,
+                               [](std::priority_queue<int>&) -> int
+                               {
+                                 throw std::runtime_error("failed");
+                               }),
+                    std::runtime_error);
+
+  heap.deregister_thread(record);
+  REQUIRE_FALSE(record);
+}
+
+TEST_CASE("FlatCombining-Concurrent")
+{
+  const size_t THREADS = 4;
+  const size_t OPS = 20000;
+
+  // One record less than threads, so a thread has to bypass combining
+  FlatCombining<std::vector<size_t>> log(THREADS - 1);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           FlatCombining<std::vector<size_t>>::RecordPtr record;
+                           for (size_t i = 0; i < OPS; ++i)
+                           {
+                             log.apply(record, [&](std::vector<size_t>& v)
+                                       {
+                                         v.push_back(t * OPS + i);
+                                       });
+                           }
+                           log.deregister_thread(record);
+                         });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  FlatCombining<std::vector<size_t>>::RecordPtr record;
+  std::vector<size_t> values =
+    log.apply(record, [](std::vector<size_t>& v) { return v; });
+  REQUIRE(values.size() == THREADS * OPS);
+
+  // Operations of every thread are applied in program order
+  std::vector<size_t> next(THREADS);
+  for (size_t value : values)
+  {
+    size_t t = value / OPS;
+    REQUIRE(value % OPS == next[t]);
+    ++next[t];
+  }
+}
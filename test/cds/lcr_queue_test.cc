@@ -0,0 +1,189 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/distributed/dynamic.hh>
+#include <ni/cds/lcr_queue.hh>
+
+using namespace ni;
+
+TEST_CASE("LCRQueue-FIFO")
+{
+  // Small segments so that they are closed and appended frequently
+  LCRQueue<int, 8> queue;
+  REQUIRE(queue.empty());
+
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         for (int i = 0; i < 10000; ++i)
+                         {
+                           queue.push(i);
+                         }
+                       });
+
+  threads.emplace_back([&]
+                       {
+                         for (int i = 0; i < 10000; ++i)
+                         {
+                           int value;
+                           while (!queue.pop(&value))
+                             std::this_thread::yield();
+                           REQUIRE(value == i);
+                         }
+                       });
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("LCRQueue-State")
+{
+  LCRQueue<int> queue;
+  int value;
+  LCRQueue<int>::State state;
+
+  REQUIRE_FALSE(queue.pop(&value, &state));
+  REQUIRE(queue.tail_state() == state);
+  REQUIRE_FALSE(queue.pop(&value, &state));
+  REQUIRE(queue.tail_state() == state);
+
+  queue.push(1);
+  REQUIRE(queue.tail_state() != state);
+  REQUIRE(queue.pop(&value));
+  REQUIRE(value == 1);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("LCRQueue-SizeApprox")
+{
+  LCRQueue<int, 8> queue;
+  REQUIRE(queue.size_approx() == 0);
+
+  for (int i = 0; i < 5; ++i)
+    queue.push(i);
+  REQUIRE(queue.size_approx() == 5);
+
+  // Only the first segment is accounted for once the ring is full
+  for (int i = 5; i < 12; ++i)
+    queue.push(i);
+  REQUIRE(queue.size_approx() == 8);
+
+  // The first segment is dropped by the next pop
+  int value;
+  for (int i = 0; i < 9; ++i)
+    REQUIRE(queue.pop(&value));
+  REQUIRE(queue.size_approx() == 3);
+  for (int i = 9; i < 12; ++i)
+    REQUIRE(queue.pop(&value));
+  REQUIRE(queue.size_approx() == 0);
+  REQUIRE_FALSE(queue.pop(&value));
+  REQUIRE(queue.size_approx() == 0);
+}
+
+TEST_CASE("LCRQueue-MPMC")
+{
+  const int PRODUCERS = 3;
+  const int ITEMS = 20000;
+  LCRQueue<int, 64> queue;
+
+  std::atomic<int> in(0);
+  std::atomic<long> sum(0);
+  std::atomic<int> popped(0);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < ITEMS; ++i)
+        {
+          queue.push(in.fetch_add(1, std::memory_order_relaxed));
+        }
+      });
+  }
+
+  for (int c = 0; c < 3; ++c)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        int value;
+        while (popped.load(std::memory_order_relaxed) < PRODUCERS * ITEMS)
+        {
+          if (queue.pop(&value))
+          {
+            sum.fetch_add(value, std::memory_order_relaxed);
+            popped.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  const long total = PRODUCERS * ITEMS;
+  REQUIRE(sum == (0 + total - 1) * total / 2);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("LLDynamicDistributedLCRQueue-FIFO")
+{
+  using Queue = LLDynamicDistributed<LCRQueue<int>>;
+  Queue queue(64);
+
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         Queue::BackendPtr local_backend;
+                         for (int i = 0; i < 1000; ++i)
+                         {
+                           queue.put(local_backend, i);
+                         }
+                         queue.deregister_thread(local_backend);
+                       });
+
+  threads.emplace_back(
+    [&]
+    {
+      Queue::BackendPtr local_backend;
+      for (int i = 0; i < 1000; ++i)
+      {
+        int value;
+        while (!queue.get(local_backend, &value))
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REQUIRE(value == i);
+      }
+      queue.deregister_thread(local_backend);
+    });
+
+  for (auto& t : threads)
+    t.join();
+}
@@ -17,7 +17,11 @@
 // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include <catch.hpp>
 
@@ -60,3 +64,593 @@ TEST_CASE("LLDynamicDistributedMSQueue-FIFO")
   for (auto& t : threads)
     t.join();
 }
+
+TEST_CASE("LLDynamicDistributedMSQueue-Bulk")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  Queue queue(64);
+
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         Queue::BackendPtr local_backend;
+                         int batch[10];
+                         for (int i = 0; i < 100; ++i)
+                         {
+                           for (int j = 0; j < 10; ++j)
+                             batch[j] = i * 10 + j;
+                           queue.put_bulk(local_backend, batch, batch + 10);
+                         }
+                         queue.deregister_thread(local_backend);
+                       });
+
+  threads.emplace_back(
+    [&]
+    {
+      Queue::BackendPtr local_backend;
+      int values[16];
+      int expected = 0;
+      while (expected < 1000)
+      {
+        size_t count = queue.get_bulk(local_backend, values, 16);
+        if (!count)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (size_t i = 0; i < count; ++i)
+          REQUIRE(values[i] == expected++);
+      }
+      queue.deregister_thread(local_backend);
+    });
+
+  for (auto& t : threads)
+    t.join();
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-WideTaggedPtr")
+{
+  using Queue =
+    LLDynamicDistributed<MSQueue<int, NodePool, WideTaggedPtrTraits>>;
+  Queue queue(64);
+
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         Queue::BackendPtr local_backend;
+                         for (int i = 0; i < 1000; ++i)
+                         {
+                           queue.put(local_backend, i);
+                         }
+                         queue.deregister_thread(local_backend);
+                       });
+
+  threads.emplace_back(
+    [&]
+    {
+      Queue::BackendPtr local_backend;
+      for (int i = 0; i < 1000; ++i)
+      {
+        int value;
+        while (!queue.get(local_backend, &value))
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REQUIRE(value == i);
+      }
+      queue.deregister_thread(local_backend);
+    });
+
+  for (auto& t : threads)
+    t.join();
+}
+
+namespace
+{
+// Every element put by the producers is got exactly once by the consumers,
+// whatever backend they steal from
+template <typename Queue>
+void test_victim_policy()
+{
+  constexpr int PRODUCERS = 4;
+  constexpr int CONSUMERS = 4;
+  constexpr int ELEMENTS = 10000;
+
+  Queue queue(64);
+  std::atomic<int> received(0);
+  std::vector<std::atomic<int>> counts(PRODUCERS * ELEMENTS);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back([&, p]
+                         {
+                           typename Queue::BackendPtr local_backend;
+                           for (int i = 0; i < ELEMENTS; ++i)
+                             queue.put(local_backend, p * ELEMENTS + i);
+                           queue.deregister_thread(local_backend);
+                         });
+  }
+
+  for (int c = 0; c < CONSUMERS; ++c)
+  {
+    threads.emplace_back([&]
+                         {
+                           typename Queue::BackendPtr local_backend;
+                           int value;
+                           while (received.load() < PRODUCERS * ELEMENTS)
+                           {
+                             if (!queue.get(local_backend, &value))
+                               continue;
+                             counts[value].fetch_add(1);
+                             received.fetch_add(1);
+                           }
+                           queue.deregister_thread(local_backend);
+                         });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  for (auto& count : counts)
+    REQUIRE(count.load() == 1);
+}
+
+} // namespace
+
+TEST_CASE("LLDynamicDistributedMSQueue-RandomVictim")
+{
+  test_victim_policy<LLDynamicDistributed<MSQueue<int>>>();
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-TwoChoicesVictim")
+{
+  test_victim_policy<LLDynamicDistributed<MSQueue<int>, TwoChoicesVictim>>();
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-NearestVictim")
+{
+  test_victim_policy<LLDynamicDistributed<MSQueue<int>, NearestVictim>>();
+}
+
+TEST_CASE("LLDynamicDistributed-VictimPolicies")
+{
+  // Backend sizes and localities as seen by the policies
+  struct Victims
+  {
+    std::vector<size_t> sizes;
+    std::vector<Locality> localities;
+    size_t local_index;
+
+    size_t size() const { return sizes.size(); }
+    size_t size_approx(size_t index) const { return sizes[index]; }
+    Locality locality(size_t index) const { return localities[index]; }
+    bool local(size_t index) const { return index == local_index; }
+  };
+
+  pcg32 rng;
+  const Locality here = Locality::current();
+  const Locality far{-1, -1};
+
+  SECTION("random")
+  {
+    Victims victims{{0, 0, 0, 0}, {far, far, far, far}, 0};
+    for (int i = 0; i < 100; ++i)
+      REQUIRE(RandomVictim::select(victims, rng) < 4);
+  }
+
+  SECTION("two choices")
+  {
+    // Of any two backends the fuller one is picked, so never the emptiest
+    Victims victims{{1, 5, 5, 5}, {far, far, far, far}, 0};
+    std::vector<size_t> picked(4);
+    for (int i = 0; i < 1000; ++i)
+      ++picked[TwoChoicesVictim::select(victims, rng)];
+    REQUIRE(picked[0] < picked[1]);
+    REQUIRE(picked[0] < picked[2]);
+    REQUIRE(picked[0] < picked[3]);
+  }
+
+  SECTION("nearest")
+  {
+    // The own backend is skipped even though it is the nearest
+    Victims victims{{0, 0, 0, 0}, {here, far, here, far}, 0};
+    for (int i = 0; i < 100; ++i)
+      REQUIRE(NearestVictim::select(victims, rng) == 2);
+  }
+}
+
+TEST_CASE("Locality-Current")
+{
+  // Served from the per-thread cache while the thread stays on its CPU
+  const Locality here = Locality::current();
+  REQUIRE(here.cpu >= 0);
+  REQUIRE(here.node >= 0);
+  for (int i = 0; i < 100; ++i)
+  {
+    Locality again = Locality::current();
+    if (again.cpu == here.cpu)
+      REQUIRE(again.node == here.node);
+  }
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-Grow")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  constexpr int THREADS = 16;
+  Queue queue(2);
+
+  // More threads registered at the same time than the initial capacity
+  std::atomic<int> registered(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           Queue::BackendPtr local_backend;
+                           REQUIRE(queue.put(local_backend, t));
+                           registered.fetch_add(1);
+                           while (registered.load() < THREADS)
+                             std::this_thread::yield();
+                           queue.deregister_thread(local_backend);
+                         });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  Queue::BackendPtr local_backend;
+  std::vector<int> values;
+  int value;
+  while (queue.get(local_backend, &value))
+    values.push_back(value);
+  std::sort(values.begin(), values.end());
+  REQUIRE(values.size() == THREADS);
+  for (int t = 0; t < THREADS; ++t)
+    REQUIRE(values[t] == t);
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-ThreadChurn")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  constexpr int WAVES = 16;
+  constexpr int PRODUCERS = 4;
+  constexpr int ELEMENTS = 1000;
+  constexpr int TOTAL = WAVES * PRODUCERS * ELEMENTS;
+  Queue queue(2);
+
+  // Short-lived producers register and deregister while the consumer steals
+  // from their backends
+  std::thread consumer([&]
+                       {
+                         Queue::BackendPtr local_backend;
+                         std::vector<int> counts(TOTAL);
+                         int received = 0;
+                         int value;
+                         while (received < TOTAL)
+                         {
+                           if (!queue.get(local_backend, &value))
+                             continue;
+                           ++counts[value];
+                           ++received;
+                         }
+                         for (int count : counts)
+                           REQUIRE(count == 1);
+                         queue.deregister_thread(local_backend);
+                       });
+
+  for (int wave = 0; wave < WAVES; ++wave)
+  {
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+      producers.emplace_back(
+        [&, wave, p]
+        {
+          Queue::BackendPtr local_backend;
+          int first = (wave * PRODUCERS + p) * ELEMENTS;
+          for (int i = 0; i < ELEMENTS; ++i)
+            REQUIRE(queue.put(local_backend, first + i));
+          queue.deregister_thread(local_backend);
+        });
+    }
+    for (auto& t : producers)
+      t.join();
+  }
+  consumer.join();
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-ThreadLocal")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  Queue queue(2);
+
+  // The backends are bound to the threads and deregistered when they exit
+  std::thread producer([&]
+                       {
+                         for (int i = 0; i < 1000; ++i)
+                           queue.put(i);
+                       });
+  std::thread consumer([&]
+                       {
+                         for (int i = 0; i < 1000; ++i)
+                         {
+                           int value;
+                           while (!queue.get(&value))
+                             std::this_thread::yield();
+                           REQUIRE(value == i);
+                         }
+                       });
+  producer.join();
+  consumer.join();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 32; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           int batch[2] = {2 * t, 2 * t + 1};
+                           queue.put_bulk(batch, batch + 2);
+                         });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  std::vector<int> values(64);
+  size_t count = 0;
+  while (count < values.size())
+  {
+    size_t got = queue.get_bulk(&values[count], values.size() - count);
+    REQUIRE(got);
+    count += got;
+  }
+  std::sort(values.begin(), values.end());
+  for (int i = 0; i < 64; ++i)
+    REQUIRE(values[i] == i);
+
+  int value;
+  REQUIRE(queue.put(1));
+  queue.deregister_thread();
+  REQUIRE(queue.get(&value));
+  REQUIRE(value == 1);
+  REQUIRE_FALSE(queue.get(&value));
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-ThreadLocalOutlivesQueue")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  std::unique_ptr<Queue> queue(new Queue(2));
+  std::atomic<bool> put(false);
+  std::atomic<bool> exit(false);
+
+  // A thread exiting after the queue has been destroyed leaves it alone
+  std::thread thread([&]
+                     {
+                       queue->put(1);
+                       put.store(true);
+                       while (!exit.load())
+                         std::this_thread::yield();
+                     });
+  while (!put.load())
+    std::this_thread::yield();
+  queue.reset();
+  exit.store(true);
+  thread.join();
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-StealBatch")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  Queue queue(4);
+  queue.set_steal_batch(8);
+
+  Queue::BackendPtr producer;
+  for (int i = 0; i < 20; ++i)
+    queue.put(producer, i);
+
+  // The first get steals a batch, the next ones are served by the local
+  // backend in the same order
+  Queue::BackendPtr consumer;
+  int value;
+  for (int i = 0; i < 20; ++i)
+  {
+    REQUIRE(queue.get(consumer, &value));
+    REQUIRE(value == i);
+  }
+  REQUIRE_FALSE(queue.get(consumer, &value));
+  REQUIRE(consumer);
+
+  queue.deregister_thread(producer);
+  queue.deregister_thread(consumer);
+}
+
+namespace
+{
+// Hides the size estimation of the backend
+class UnsizedMSQueue : public MSQueue<int>
+{
+public:
+  size_t size_approx() const = delete;
+};
+} // namespace
+
+TEST_CASE("LLDynamicDistributedMSQueue-StealHalf")
+{
+  // The consumer steals half of the 6 elements of the producer, the other
+  // ones are left to it
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  Queue queue(4);
+  queue.set_steal_batch(8);
+
+  Queue::BackendPtr producer;
+  for (int i = 0; i < 6; ++i)
+    queue.put(producer, i);
+
+  Queue::BackendPtr consumer;
+  int value;
+  REQUIRE(queue.get(consumer, &value));
+  REQUIRE(value == 0);
+  REQUIRE(queue.get(producer, &value));
+  REQUIRE(value == 3);
+
+  queue.deregister_thread(producer);
+  queue.deregister_thread(consumer);
+
+  // Without an estimation only 2 elements are stolen
+  using Unsized = LLDynamicDistributed<UnsizedMSQueue>;
+  Unsized unsized(4);
+  unsized.set_steal_batch(8);
+
+  Unsized::BackendPtr unsized_producer;
+  for (int i = 0; i < 6; ++i)
+    unsized.put(unsized_producer, i);
+
+  Unsized::BackendPtr unsized_consumer;
+  REQUIRE(unsized.get(unsized_consumer, &value));
+  REQUIRE(value == 0);
+  REQUIRE(unsized.get(unsized_producer, &value));
+  REQUIRE(value == 2);
+
+  unsized.deregister_thread(unsized_producer);
+  unsized.deregister_thread(unsized_consumer);
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-StealBatchConcurrent")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  constexpr int PRODUCERS = 2;
+  constexpr int CONSUMERS = 4;
+  constexpr int ELEMENTS = 20000;
+
+  Queue queue(4);
+  queue.set_steal_batch(16);
+  std::atomic<int> received(0);
+  std::vector<std::atomic<int>> counts(PRODUCERS * ELEMENTS);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back([&, p]
+                         {
+                           for (int i = 0; i < ELEMENTS; ++i)
+                             queue.put(p * ELEMENTS + i);
+                         });
+  }
+
+  // Consumers get through the thread-local API, their backends hold the
+  // batches they stole
+  for (int c = 0; c < CONSUMERS; ++c)
+  {
+    threads.emplace_back([&]
+                         {
+                           int value;
+                           while (received.load() < PRODUCERS * ELEMENTS)
+                           {
+                             if (!queue.get(&value))
+                               continue;
+                             counts[value].fetch_add(1);
+                             received.fetch_add(1);
+                           }
+                         });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  for (auto& count : counts)
+    REQUIRE(count.load() == 1);
+}
+
+namespace
+{
+std::atomic<int> tail_state_calls(0);
+
+// Counts the validations of the scan for emptiness
+class TailCountingMSQueue : public MSQueue<int>
+{
+public:
+  State tail_state()
+  {
+    tail_state_calls.fetch_add(1);
+    return MSQueue<int>::tail_state();
+  }
+};
+
+} // namespace
+
+TEST_CASE("LLDynamicDistributedMSQueue-EmptyFastPath")
+{
+  using Queue = LLDynamicDistributed<TailCountingMSQueue>;
+  Queue queue(4);
+
+  Queue::BackendPtr producer;
+  Queue::BackendPtr consumer;
+  int value;
+
+  // Nothing was ever put
+  REQUIRE_FALSE(queue.get(consumer, &value));
+  REQUIRE(tail_state_calls.load() == 0);
+
+  for (int i = 0; i < 3; ++i)
+    queue.put(producer, i);
+  for (int i = 0; i < 3; ++i)
+  {
+    REQUIRE(queue.get(consumer, &value));
+    REQUIRE(value == i);
+  }
+
+  // The scan finding the backends empty clears the indicator, later gets
+  // return without scanning
+  REQUIRE_FALSE(queue.get(consumer, &value));
+  tail_state_calls.store(0);
+  for (int i = 0; i < 10; ++i)
+    REQUIRE_FALSE(queue.get(consumer, &value));
+  REQUIRE(tail_state_calls.load() == 0);
+
+  // Elements left in a deregistered backend are still found
+  queue.put(producer, 42);
+  queue.deregister_thread(producer);
+  REQUIRE(queue.get(consumer, &value));
+  REQUIRE(value == 42);
+  REQUIRE_FALSE(queue.get(consumer, &value));
+  tail_state_calls.store(0);
+  REQUIRE_FALSE(queue.get(consumer, &value));
+  REQUIRE(tail_state_calls.load() == 0);
+
+  queue.deregister_thread(consumer);
+}
+
+TEST_CASE("LLDynamicDistributedMSQueue-EmptyPingPong")
+{
+  using Queue = LLDynamicDistributed<MSQueue<int>>;
+  constexpr int ROUNDS = 20000;
+  constexpr int CONSUMERS = 3;
+
+  // Every element is put into an empty structure, a non-empty backend
+  // missed by the indicator would make the consumers spin forever
+  Queue queue(4);
+  std::atomic<int> received(0);
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         for (int i = 0; i < ROUNDS; ++i)
+                         {
+                           queue.put(i);
+                           while (received.load() <= i)
+                             std::this_thread::yield();
+                         }
+                       });
+  for (int c = 0; c < CONSUMERS; ++c)
+  {
+    threads.emplace_back([&]
+                         {
+                           int value;
+                           while (received.load() < ROUNDS)
+                           {
+                             if (queue.get(&value))
+                               received.fetch_add(1);
+                           }
+                         });
+  }
+
+  for (auto& t : threads)
+    t.join();
+  REQUIRE(received.load() == ROUNDS);
+}
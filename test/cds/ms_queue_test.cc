@@ -99,3 +99,208 @@ TEST_CASE("MSQueue-ABACounter")
 
   REQUIRE(queue.empty());
 }
+
+TEST_CASE("MSQueue-NodePool")
+{
+  using Queue = MSQueue<int, NodePool>;
+  Queue queue;
+  REQUIRE(queue.empty());
+
+  std::atomic<int> in(0);
+  std::atomic<int> sum(0);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 2; ++i)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < 5000; ++i)
+        {
+          queue.push(in.fetch_add(1, std::memory_order_relaxed));
+        }
+      });
+  }
+
+  for (int i = 0; i < 2; ++i)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < 5000; ++i)
+        {
+          int value;
+          while (!queue.pop(&value))
+            std::this_thread::yield();
+          sum.fetch_add(value, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(sum == (0 + 9999) * 10000 / 2);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("MSQueue-MultiConsumer")
+{
+  MSQueue<int, NodePool> queue;
+
+  std::atomic<int> sum(0);
+  std::atomic<int> popped(0);
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         for (int i = 0; i < 20000; ++i)
+                         {
+                           queue.push(i);
+                         }
+                       });
+
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        int value;
+        while (popped.load(std::memory_order_relaxed) < 20000)
+        {
+          if (queue.pop(&value))
+          {
+            sum.fetch_add(value, std::memory_order_relaxed);
+            popped.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(sum == (0 + 19999) * 20000 / 2);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("MSQueue-Bulk")
+{
+  MSQueue<int, NodePool> queue;
+
+  int values[10];
+  REQUIRE(queue.pop_bulk(values, 10) == 0);
+  REQUIRE(queue.size_approx() == 0);
+
+  std::vector<int> input{0, 1, 2, 3, 4, 5, 6};
+  REQUIRE(queue.put_bulk(input.begin(), input.end()) == 7);
+  REQUIRE(queue.put_bulk(input.begin(), input.begin()) == 0);
+  REQUIRE(queue.size_approx() == 7);
+  REQUIRE(queue.get_bulk(values, 3) == 3);
+  REQUIRE(queue.size_approx() == 4);
+  REQUIRE(queue.get_bulk(values + 3, 10) == 4);
+  for (int i = 0; i < 7; ++i)
+    REQUIRE(values[i] == i);
+  REQUIRE(queue.empty());
+  REQUIRE(queue.size_approx() == 0);
+
+  // Each producer pushes increasing values, which have to be popped in order
+  const int PRODUCERS = 2;
+  const int BATCHES = 500;
+  const int BATCH_SIZE = 16;
+  std::atomic<int> popped(0);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back(
+      [&, p]
+      {
+        int batch[BATCH_SIZE];
+        for (int i = 0; i < BATCHES; ++i)
+        {
+          for (int j = 0; j < BATCH_SIZE; ++j)
+            batch[j] = (i * BATCH_SIZE + j) * PRODUCERS + p;
+          queue.push_bulk(batch, batch + BATCH_SIZE);
+        }
+      });
+  }
+
+  for (int c = 0; c < 2; ++c)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        int last[PRODUCERS] = {-1, -1};
+        int batch[8];
+        while (popped.load(std::memory_order_relaxed) <
+               PRODUCERS * BATCHES * BATCH_SIZE)
+        {
+          size_t count = queue.pop_bulk(batch, 8);
+          for (size_t i = 0; i < count; ++i)
+          {
+            int producer = batch[i] % PRODUCERS;
+            REQUIRE(batch[i] > last[producer]);
+            last[producer] = batch[i];
+          }
+          popped.fetch_add(count, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(popped == PRODUCERS * BATCHES * BATCH_SIZE);
+  REQUIRE(queue.empty());
+  REQUIRE(queue.size_approx() == 0);
+}
+
+TEST_CASE("MSQueue-WideTaggedPtr")
+{
+  using Queue = MSQueue<int, NodePool, WideTaggedPtrTraits>;
+  Queue queue;
+  REQUIRE(queue.empty());
+
+  std::atomic<int> in(0);
+  std::atomic<int> sum(0);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 2; ++i)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < 5000; ++i)
+        {
+          queue.push(in.fetch_add(1, std::memory_order_relaxed));
+        }
+      });
+  }
+
+  for (int i = 0; i < 2; ++i)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        for (int i = 0; i < 5000; ++i)
+        {
+          int value;
+          while (!queue.pop(&value))
+            std::this_thread::yield();
+          sum.fetch_add(value, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(sum == (0 + 9999) * 10000 / 2);
+  REQUIRE(queue.empty());
+
+  Queue::State state;
+  int value;
+  REQUIRE_FALSE(queue.pop(&value, &state));
+  REQUIRE(state == queue.tail_state());
+}
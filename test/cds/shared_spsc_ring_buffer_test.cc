@@ -0,0 +1,130 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <ni/cds/shared_spsc_ring_buffer.hh>
+#include <ni/memory/shared_memory.hh>
+
+using namespace ni;
+
+namespace
+{
+using Ring = SharedSPSCRingBuffer<uint64_t>;
+constexpr size_t SIZE = 64;
+
+} // namespace
+
+TEST_CASE("SharedSPSCRingBuffer")
+{
+  SharedMemory memory = SharedMemory::create(Ring::memory_size(SIZE));
+  REQUIRE(Ring::attach(memory.data()) == nullptr);
+  Ring* ring = Ring::create(memory.data(), SIZE);
+  REQUIRE(ring->empty());
+  REQUIRE(ring->size() == SIZE);
+
+  // Another mapping of the same memory, at another address
+  SharedMemory other = SharedMemory::open(memory.fd());
+  REQUIRE(other.data() != memory.data());
+  Ring* other_ring = Ring::attach(other.data());
+  REQUIRE(other_ring != nullptr);
+
+  for (uint64_t i = 1; i <= SIZE; ++i)
+    REQUIRE(ring->push(i));
+  REQUIRE_FALSE(ring->push(SIZE + 1));
+  REQUIRE(other_ring->len() == SIZE);
+
+  uint64_t elements[SIZE];
+  REQUIRE(other_ring->pop_n(elements, SIZE) == SIZE);
+  for (uint64_t i = 0; i < SIZE; ++i)
+    REQUIRE(elements[i] == i + 1);
+  REQUIRE(other_ring->pop() == 0);
+  REQUIRE(ring->empty());
+}
+
+TEST_CASE("SharedSPSCRingBuffer named")
+{
+  std::string name = "/ni_test_" + std::to_string(getpid());
+  SharedMemory memory = SharedMemory::create(name.c_str(),
+                                             Ring::memory_size(SIZE));
+  REQUIRE_THROWS(SharedMemory::create(name.c_str(), Ring::memory_size(SIZE)));
+  Ring* ring = Ring::create(memory.data(), SIZE);
+
+  SharedMemory other = SharedMemory::open(name.c_str());
+  SharedMemory::unlink(name.c_str());
+  REQUIRE(other.size() == memory.size());
+  Ring* other_ring = Ring::attach(other.data());
+  REQUIRE(other_ring != nullptr);
+
+  REQUIRE(ring->push(42));
+  REQUIRE(other_ring->wait_pop() == 42);
+  REQUIRE_THROWS(SharedMemory::open(name.c_str()));
+}
+
+TEST_CASE("SharedSPSCRingBuffer across processes")
+{
+  constexpr uint64_t COUNT = 1000000;
+  SharedMemory memory = SharedMemory::create(Ring::memory_size(SIZE));
+  Ring::create(memory.data(), SIZE);
+
+  pid_t pid = fork();
+  REQUIRE(pid >= 0);
+  if (pid == 0)
+  {
+    // The producer maps the memory on its own
+    SharedMemory child_memory = SharedMemory::open(memory.fd());
+    Ring* ring = Ring::attach(child_memory.data());
+    if (!ring)
+      _exit(1);
+    for (uint64_t i = 1; i <= COUNT;)
+    {
+      uint64_t batch[8];
+      size_t n = std::min<uint64_t>(8, COUNT - i + 1);
+      for (size_t k = 0; k < n; ++k)
+        batch[k] = i + k;
+      size_t pushed = ring->push_n(batch, n);
+      if (!pushed)
+        std::this_thread::yield();
+      i += pushed;
+    }
+    _exit(0);
+  }
+
+  Ring* ring = Ring::attach(memory.data());
+  for (uint64_t i = 1; i <= COUNT; ++i)
+  {
+    uint64_t element = ring->wait_pop();
+    if (element != i)
+      REQUIRE(element == i);
+  }
+
+  int status;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+  REQUIRE(ring->empty());
+}
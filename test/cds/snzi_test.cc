@@ -0,0 +1,114 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/distributed/snzi.hh>
+
+using namespace ni;
+
+TEST_CASE("SNZI-Sequential")
+{
+  REQUIRE(SNZI(0).leaves() == 1);
+  REQUIRE(SNZI(5).leaves() == 8);
+
+  SNZI single(1);
+  REQUIRE_FALSE(single.query());
+  single.arrive(0);
+  single.arrive(0);
+  REQUIRE(single.query());
+  single.depart(0);
+  REQUIRE(single.query());
+  single.depart(0);
+  REQUIRE_FALSE(single.query());
+
+  SNZI indicator(8);
+  REQUIRE_FALSE(indicator.query());
+  indicator.arrive(0);
+  indicator.arrive(7);
+  indicator.arrive(7);
+  REQUIRE(indicator.query());
+  indicator.depart(0);
+  REQUIRE(indicator.query());
+  indicator.depart(7);
+  REQUIRE(indicator.query());
+  indicator.depart(7);
+  REQUIRE_FALSE(indicator.query());
+
+  // Transitions again after going back to zero
+  indicator.arrive(3);
+  REQUIRE(indicator.query());
+  indicator.depart(3);
+  REQUIRE_FALSE(indicator.query());
+}
+
+TEST_CASE("SNZI-Concurrent")
+{
+  const int THREADS = 8;
+  const int ROUNDS = 20000;
+  SNZI indicator(4);
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> threads;
+
+  // Never zero while one arrival is held
+  indicator.arrive(0);
+  for (int t = 0; t < THREADS; ++t)
+    threads.emplace_back([&, t]
+                         {
+                           size_t leaf = t % indicator.leaves();
+                           for (int i = 0; i < ROUNDS; ++i)
+                           {
+                             indicator.arrive(leaf);
+                             if (!indicator.query())
+                               failed = true;
+                             indicator.depart(leaf);
+                             if (!indicator.query())
+                               failed = true;
+                           }
+                         });
+  for (auto& thread : threads)
+    thread.join();
+  REQUIRE_FALSE(failed);
+  indicator.depart(0);
+  REQUIRE_FALSE(indicator.query());
+
+  // Every arrival of a thread is seen by itself, and the indicator drops
+  // back once they all departed
+  threads.clear();
+  for (int t = 0; t < THREADS; ++t)
+    threads.emplace_back([&, t]
+                         {
+                           size_t leaf = t % indicator.leaves();
+                           for (int i = 0; i < ROUNDS; ++i)
+                           {
+                             indicator.arrive(leaf);
+                             if (!indicator.query())
+                               failed = true;
+                             indicator.depart(leaf);
+                           }
+                         });
+  for (auto& thread : threads)
+    thread.join();
+  REQUIRE_FALSE(failed);
+  REQUIRE_FALSE(indicator.query());
+}
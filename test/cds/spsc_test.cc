@@ -17,11 +17,19 @@
 // LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
 #include <thread>
 
 #include <catch.hpp>
 
 #include <ni/cds/spsc_buffer_list.hh>
+#include <ni/cds/spsc_byte_ring.hh>
+#include <ni/cds/spsc_intrusive_list.hh>
+#include <ni/cds/spsc_queue.hh>
 
 using namespace ni;
 
@@ -55,3 +63,382 @@ TEST_CASE("SPSCRingBuffer")
   t1.join();
   t2.join();
 }
+
+TEST_CASE("SPSCRingBuffer push_n/pop_n")
+{
+  SPSCRingBuffer<int, -1> ringbuf(8);
+  int in[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+  int out[16];
+
+  REQUIRE(ringbuf.push_n(in, 3) == 3);
+  REQUIRE(ringbuf.len() == 3);
+  REQUIRE(ringbuf.pop_n(out, 2) == 2);
+  REQUIRE(out[0] == 0);
+  REQUIRE(out[1] == 1);
+
+  // 7 free slots, the run is halved until it fits
+  REQUIRE(ringbuf.push_n(in + 3, 13) == 4);
+  REQUIRE(ringbuf.push_n(in + 7, 3) == 3);
+  REQUIRE(ringbuf.push_n(in + 10, 1) == 0);
+  REQUIRE(ringbuf.len() == 8);
+
+  REQUIRE(ringbuf.pop_n(out, 16) == 8);
+  for (int i = 0; i < 8; ++i)
+    REQUIRE(out[i] == i + 2);
+  REQUIRE(ringbuf.empty());
+  REQUIRE(ringbuf.pop_n(out, 16) == 0);
+}
+
+TEST_CASE("SPSCRingBuffer bulk concurrent")
+{
+  constexpr int COUNT = 100000;
+  SPSCRingBuffer<int, -1> ringbuf(64);
+
+  std::thread t1([&]
+                 {
+                   int batch[16];
+                   for (int i = 0; i < COUNT;)
+                   {
+                     int n = std::min(COUNT - i, 1 + i % 16);
+                     for (int k = 0; k < n; ++k)
+                       batch[k] = i + k;
+                     size_t pushed = ringbuf.push_n(batch, n);
+                     if (!pushed)
+                       std::this_thread::yield();
+                     i += pushed;
+                   }
+                 });
+
+  std::thread t2([&]
+                 {
+                   int batch[16];
+                   for (int i = 0; i < COUNT;)
+                   {
+                     size_t popped = ringbuf.pop_n(batch, 1 + i % 16);
+                     if (!popped)
+                       std::this_thread::yield();
+                     for (size_t k = 0; k < popped; ++k, ++i)
+                       REQUIRE(batch[k] == i);
+                   }
+                 });
+
+  t1.join();
+  t2.join();
+  REQUIRE(ringbuf.empty());
+}
+
+TEST_CASE("SPSCLinkedList")
+{
+  SPSCLinkedList<int, -1> list(4, true);
+  REQUIRE(list.empty());
+
+  // Nodes go back and forth through the cache
+  for (int round = 0; round < 10; ++round)
+  {
+    for (int i = 0; i < 8; ++i)
+      list.push(round * 8 + i);
+    for (int i = 0; i < 8; ++i)
+      REQUIRE(list.pop() == round * 8 + i);
+    REQUIRE(list.pop() == -1);
+    REQUIRE(list.empty());
+  }
+}
+
+namespace
+{
+struct Message : SPSCIntrusiveListHook<>
+{
+  int value;
+};
+
+} // namespace
+
+TEST_CASE("SPSCIntrusiveList")
+{
+  SPSCIntrusiveList<Message> list;
+  Message messages[4];
+  REQUIRE(list.empty());
+  REQUIRE(list.pop() == nullptr);
+
+  for (int round = 0; round < 3; ++round)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      messages[i].value = round * 4 + i;
+      list.push(&messages[i]);
+    }
+    REQUIRE_FALSE(list.empty());
+
+    // Popped elements may be pushed again right away
+    REQUIRE(list.pop() == &messages[0]);
+    messages[0].value = -1;
+    list.push(&messages[0]);
+    for (int i = 1; i < 4; ++i)
+      REQUIRE(list.pop()->value == round * 4 + i);
+    REQUIRE(list.pop()->value == -1);
+    REQUIRE(list.pop() == nullptr);
+    REQUIRE(list.empty());
+  }
+}
+
+TEST_CASE("SPSCIntrusiveList concurrent")
+{
+  constexpr int COUNT = 1000000;
+  constexpr int POOL_SIZE = 64;
+  SPSCIntrusiveList<Message> list;
+  // Popped messages go back to the producer through a second list
+  SPSCIntrusiveList<Message> free_list;
+  Message messages[POOL_SIZE];
+  for (Message& message : messages)
+    free_list.push(&message);
+
+  std::thread t1([&]
+                 {
+                   for (int i = 0; i < COUNT; ++i)
+                   {
+                     Message* message;
+                     while (!(message = free_list.pop()))
+                       std::this_thread::yield();
+                     message->value = i;
+                     list.push(message);
+                   }
+                 });
+
+  std::thread t2([&]
+                 {
+                   for (int i = 0; i < COUNT; ++i)
+                   {
+                     Message* message;
+                     while (!(message = list.pop()))
+                       std::this_thread::yield();
+                     if (message->value != i)
+                       REQUIRE(message->value == i);
+                     free_list.push(message);
+                   }
+                 });
+
+  t1.join();
+  t2.join();
+  REQUIRE(list.empty());
+}
+
+TEST_CASE("SPSCBufferList")
+{
+  SPSCBufferList<int, -1> list(4, 4);
+  list.set_max_buffer_size(64);
+  list.set_idle_period(std::chrono::milliseconds(1));
+  REQUIRE(list.empty());
+  REQUIRE(list.pop() == -1);
+
+  // The consumer lags behind, segments grow: 4 + 8 + 16 + 32 + 64 * 15,
+  // instead of 250 segments of 4 elements
+  size_t initial_usage = list.memory_usage();
+  for (int i = 0; i < 1000; ++i)
+    list.push(i);
+  REQUIRE(list.memory_usage() > 4 * initial_usage);
+  REQUIRE(list.memory_usage() < 250 * initial_usage / 4);
+
+  for (int i = 0; i < 1000; ++i)
+    REQUIRE(list.pop() == i);
+  REQUIRE(list.empty());
+  size_t peak_usage = list.memory_usage();
+
+  // The first period starts over after the burst, the cache is trimmed at
+  // the end of the next one
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  list.trim();
+  REQUIRE(list.memory_usage() == peak_usage);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  list.trim();
+  REQUIRE(list.memory_usage() < peak_usage);
+
+  list.emplace(1);
+  int value = 2;
+  list.push(std::move(value));
+  REQUIRE(list.pop() == 1);
+  REQUIRE(list.pop() == 2);
+  REQUIRE(list.empty());
+}
+
+TEST_CASE("SPSCBufferList concurrent")
+{
+  constexpr int COUNT = 1000000;
+  SPSCBufferList<int, -1> list(16, 4);
+  list.set_max_buffer_size(1024);
+  list.set_idle_period(std::chrono::microseconds(100));
+
+  std::thread t1([&]
+                 {
+                   for (int i = 0; i < COUNT; ++i)
+                     list.push(i);
+                 });
+
+  std::thread t2([&]
+                 {
+                   for (int i = 0; i < COUNT; ++i)
+                   {
+                     int val;
+                     while ((val = list.pop()) == -1)
+                       std::this_thread::yield();
+                     if (val != i)
+                       REQUIRE(val == i);
+                   }
+                 });
+
+  t1.join();
+  t2.join();
+  REQUIRE(list.empty());
+}
+
+TEST_CASE("SPSCQueue")
+{
+  SPSCQueue<std::unique_ptr<std::string>> queue(4);
+  REQUIRE(queue.empty());
+  REQUIRE(queue.front() == nullptr);
+
+  REQUIRE(queue.emplace(new std::string("a")));
+  REQUIRE(queue.push(std::make_unique<std::string>("b")));
+  REQUIRE(queue.emplace(new std::string("c")));
+  REQUIRE(queue.emplace(new std::string("d")));
+  REQUIRE_FALSE(queue.push(std::make_unique<std::string>("e")));
+  REQUIRE(queue.len() == 4);
+
+  REQUIRE(**queue.front() == "a");
+  queue.pop();
+  std::unique_ptr<std::string> value;
+  REQUIRE(queue.pop(&value));
+  REQUIRE(*value == "b");
+  REQUIRE(queue.len() == 2);
+
+  // Wrap around, the remaining elements are destroyed with the queue
+  REQUIRE(queue.emplace(new std::string("f")));
+  REQUIRE(**queue.front() == "c");
+}
+
+TEST_CASE("SPSCQueue concurrent")
+{
+  struct Message
+  {
+    size_t sequence;
+    char payload[120];
+  };
+  constexpr size_t COUNT = 100000;
+  SPSCQueue<Message> queue(64);
+
+  std::thread t1([&]
+                 {
+                   for (size_t i = 0; i < COUNT; ++i)
+                   {
+                     Message message;
+                     message.sequence = i;
+                     std::fill(std::begin(message.payload),
+                               std::end(message.payload),
+                               static_cast<char>(i));
+                     while (!queue.push(message))
+                       std::this_thread::yield();
+                   }
+                 });
+
+  std::thread t2([&]
+                 {
+                   for (size_t i = 0; i < COUNT; ++i)
+                   {
+                     Message* message;
+                     while ((message = queue.front()) == nullptr)
+                       std::this_thread::yield();
+                     REQUIRE(message->sequence == i);
+                     REQUIRE(message->payload[119] == static_cast<char>(i));
+                     queue.pop();
+                   }
+                 });
+
+  t1.join();
+  t2.join();
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("SPSCByteRing")
+{
+  SPSCByteRing ring(DoubleMappedBuffer::page_size());
+  const size_t size = ring.size();
+  REQUIRE(ring.empty());
+  REQUIRE(ring.peek().data == nullptr);
+
+  SPSCByteRing::Span span = ring.reserve(size);
+  REQUIRE(span.data != nullptr);
+  REQUIRE(span.size == size);
+  ring.commit(size - 10);
+  REQUIRE(ring.len() == size - 10);
+  REQUIRE(ring.reserve(11).data == nullptr);
+  ring.consume(ring.peek().size);
+  REQUIRE(ring.empty());
+
+  // The record wraps around the end of the buffer but stays contiguous
+  std::string record(100, 'x');
+  for (size_t i = 0; i < record.size(); ++i)
+    record[i] = static_cast<char>(i);
+  span = ring.reserve(record.size());
+  REQUIRE(span.size == size);
+  memcpy(span.data, record.data(), record.size());
+  ring.commit(record.size());
+
+  span = ring.peek();
+  REQUIRE(span.size == record.size());
+  REQUIRE(std::string(span.data, span.size) == record);
+  ring.consume(span.size);
+  REQUIRE(ring.empty());
+}
+
+TEST_CASE("SPSCByteRing concurrent")
+{
+  constexpr uint32_t COUNT = 20000;
+  SPSCByteRing ring(DoubleMappedBuffer::page_size());
+
+  // Records are a length followed by as many copies of the sequence number
+  std::thread t1([&]
+                 {
+                   for (uint32_t i = 0; i < COUNT; ++i)
+                   {
+                     uint32_t words = 1 + i % 37;
+                     size_t bytes = (words + 1) * sizeof(uint32_t);
+                     SPSCByteRing::Span span;
+                     while (!(span = ring.reserve(bytes)).data)
+                       std::this_thread::yield();
+                     uint32_t* record = reinterpret_cast<uint32_t*>(span.data);
+                     record[0] = words;
+                     std::fill(record + 1, record + 1 + words, i);
+                     ring.commit(bytes);
+                   }
+                 });
+
+  std::thread t2([&]
+                 {
+                   for (uint32_t i = 0; i < COUNT;)
+                   {
+                     SPSCByteRing::Span span = ring.peek();
+                     if (!span.data)
+                     {
+                       std::this_thread::yield();
+                       continue;
+                     }
+                     // Consume every complete record of the span at once
+                     size_t offset = 0;
+                     while (offset < span.size)
+                     {
+                       const uint32_t* record =
+                         reinterpret_cast<uint32_t*>(span.data + offset);
+                       REQUIRE(record[0] == 1 + i % 37);
+                       for (uint32_t k = 1; k <= record[0]; ++k)
+                         REQUIRE(record[k] == i);
+                       offset += (record[0] + 1) * sizeof(uint32_t);
+                       ++i;
+                     }
+                     REQUIRE(offset == span.size);
+                     ring.consume(span.size);
+                   }
+                 });
+
+  t1.join();
+  t2.join();
+  REQUIRE(ring.empty());
+}
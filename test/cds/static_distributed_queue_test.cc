@@ -0,0 +1,181 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/bounded_mpmc_queue.hh>
+#include <ni/cds/distributed/static.hh>
+#include <ni/cds/ms_queue.hh>
+
+using namespace ni;
+
+namespace
+{
+// Every element put by the producers is got exactly once by the consumers
+template <typename Balancer>
+void test_balancer()
+{
+  constexpr int PRODUCERS = 4;
+  constexpr int CONSUMERS = 4;
+  constexpr int ELEMENTS = 10000;
+
+  DistributedInterface<MSQueue<int>, Balancer> queue(4);
+  std::atomic<int> received(0);
+  std::vector<std::atomic<int>> counts(PRODUCERS * ELEMENTS);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < PRODUCERS; ++p)
+  {
+    threads.emplace_back([&, p]
+                         {
+                           for (int i = 0; i < ELEMENTS; ++i)
+                             queue.put(p * ELEMENTS + i);
+                         });
+  }
+
+  for (int c = 0; c < CONSUMERS; ++c)
+  {
+    threads.emplace_back([&]
+                         {
+                           int value;
+                           while (received.load() < PRODUCERS * ELEMENTS)
+                           {
+                             if (!queue.get(&value))
+                               continue;
+                             counts[value].fetch_add(1);
+                             received.fetch_add(1);
+                           }
+                         });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  for (auto& count : counts)
+    REQUIRE(count.load() == 1);
+}
+
+// Partial queue sizes as seen by the balancers
+struct Partials
+{
+  std::vector<size_t> sizes;
+
+  size_t size() const { return sizes.size(); }
+  size_t size_approx(size_t index) const { return sizes[index]; }
+};
+
+} // namespace
+
+TEST_CASE("DistributedInterface-RoundRobinBalancer")
+{
+  test_balancer<RoundRobinBalancer>();
+}
+
+TEST_CASE("DistributedInterface-AffinityBalancer")
+{
+  test_balancer<AffinityBalancer>();
+}
+
+TEST_CASE("DistributedInterface-RandomBalancer")
+{
+  test_balancer<RandomBalancer>();
+}
+
+TEST_CASE("DistributedInterface-DRandomBalancer")
+{
+  test_balancer<DRandomBalancer<>>();
+}
+
+TEST_CASE("DistributedInterface-Sequential")
+{
+  DistributedInterface<MSQueue<int>, RoundRobinBalancer> queue(3);
+  REQUIRE(queue.partials() == 3);
+
+  // Round robin puts and gets visit the partial queues in the same order
+  for (int i = 0; i < 9; ++i)
+    REQUIRE(queue.put(i));
+  int value;
+  for (int i = 0; i < 9; ++i)
+  {
+    REQUIRE(queue.get(&value));
+    REQUIRE(value == i);
+  }
+  REQUIRE_FALSE(queue.get(&value));
+}
+
+TEST_CASE("DistributedInterface-BoundedBackend")
+{
+  using Queue = DistributedInterface<BoundedMPMCQueue<int>, RoundRobinBalancer>;
+  Queue queue(2, Queue::BalancerPtr(new RoundRobinBalancer()), 2);
+
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(queue.put(i));
+  REQUIRE_FALSE(queue.put(4));
+
+  int value;
+  size_t count = 0;
+  while (queue.get(&value))
+    ++count;
+  REQUIRE(count == 4);
+}
+
+TEST_CASE("DistributedInterface-Balancers")
+{
+  SECTION("round robin")
+  {
+    Partials partials{{0, 0, 0}};
+    RoundRobinBalancer balancer;
+    for (size_t i = 0; i < 6; ++i)
+    {
+      REQUIRE(balancer.put_index(partials) == i % 3);
+      REQUIRE(balancer.get_index(partials) == i % 3);
+    }
+  }
+
+  SECTION("affinity")
+  {
+    Partials partials{{0, 0, 0, 0}};
+    AffinityBalancer balancer;
+    size_t index = balancer.put_index(partials);
+    REQUIRE(index < 4);
+    REQUIRE(balancer.put_index(partials) == index);
+    REQUIRE(balancer.get_index(partials) == index);
+  }
+
+  SECTION("d-random")
+  {
+    // Of any two partial queues the emptier one is put into and the fuller
+    // one is got from
+    Partials partials{{1, 5, 5, 9}};
+    DRandomBalancer<2> balancer;
+    std::vector<size_t> put(4);
+    std::vector<size_t> got(4);
+    for (int i = 0; i < 1000; ++i)
+    {
+      ++put[balancer.put_index(partials)];
+      ++got[balancer.get_index(partials)];
+    }
+    REQUIRE(put[3] < put[0]);
+    REQUIRE(got[0] < got[3]);
+  }
+}
@@ -0,0 +1,135 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/distributed/dynamic.hh>
+#include <ni/cds/treiber_stack.hh>
+
+using namespace ni;
+
+TEST_CASE("TreiberStack-LIFO")
+{
+  TreiberStack<int> stack;
+  REQUIRE(stack.empty());
+
+  int value;
+  TreiberStack<int>::State state;
+  REQUIRE_FALSE(stack.pop(&value, &state));
+  REQUIRE(state == stack.tail_state());
+
+  for (int i = 0; i < 100; ++i)
+    stack.push(i);
+  REQUIRE(stack.tail_state() != state);
+
+  for (int i = 99; i >= 0; --i)
+  {
+    REQUIRE(stack.pop(&value));
+    REQUIRE(value == i);
+  }
+  REQUIRE(stack.empty());
+}
+
+TEST_CASE("TreiberStack-Elimination")
+{
+  const int THREADS = 4;
+  const int ITEMS = 20000;
+  TreiberStack<int, NodePool> stack(4);
+
+  std::atomic<int> in(0);
+  std::atomic<long> sum(0);
+  std::vector<std::thread> threads;
+
+  // Every thread pushes and pops, so that pairs can be eliminated
+  for (int t = 0; t < THREADS; ++t)
+  {
+    threads.emplace_back(
+      [&]
+      {
+        int value;
+        for (int i = 0; i < ITEMS; ++i)
+        {
+          stack.push(in.fetch_add(1, std::memory_order_relaxed));
+          if (i % 2 && stack.pop(&value))
+            sum.fetch_add(value, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  int value;
+  while (stack.pop(&value))
+    sum += value;
+
+  const long total = THREADS * ITEMS;
+  REQUIRE(sum == (0 + total - 1) * total / 2);
+  REQUIRE(stack.empty());
+}
+
+TEST_CASE("LLDynamicDistributedTreiberStack")
+{
+  using Pool = LLDynamicDistributed<TreiberStack<int>>;
+  Pool pool(64);
+
+  std::atomic<long> sum(0);
+  std::atomic<int> done(0);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 2; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           Pool::BackendPtr local_backend;
+                           for (int i = 0; i < 1000; ++i)
+                           {
+                             pool.put(local_backend, t * 1000 + i);
+                           }
+                           ++done;
+                           pool.deregister_thread(local_backend);
+                         });
+  }
+
+  threads.emplace_back(
+    [&]
+    {
+      Pool::BackendPtr local_backend;
+      int got = 0;
+      while (got < 2000)
+      {
+        int value;
+        if (pool.get(local_backend, &value))
+        {
+          sum += value;
+          ++got;
+        }
+      }
+      pool.deregister_thread(local_backend);
+    });
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(sum == (0 + 1999) * 2000 / 2);
+}
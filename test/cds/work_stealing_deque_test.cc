@@ -0,0 +1,143 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <ni/cds/work_stealing_deque.hh>
+
+using namespace ni;
+
+TEST_CASE("WorkStealingDeque-Sequential")
+{
+  WorkStealingDeque<int> deque(2);
+  REQUIRE(deque.empty());
+
+  int value;
+  REQUIRE_FALSE(deque.pop(&value));
+  REQUIRE_FALSE(deque.steal(&value));
+
+  // Grows several times
+  for (int i = 0; i < 100; ++i)
+    deque.push(i);
+  REQUIRE(deque.size_approx() == 100);
+
+  // Owner pops LIFO, thieves steal FIFO
+  REQUIRE(deque.pop(&value));
+  REQUIRE(value == 99);
+  REQUIRE(deque.steal(&value));
+  REQUIRE(value == 0);
+
+  int stolen[64];
+  REQUIRE(deque.steal_half(stolen, 64) == 49);
+  for (int i = 0; i < 49; ++i)
+    REQUIRE(stolen[i] == i + 1);
+  REQUIRE(deque.steal_half(stolen, 4) == 4);
+  REQUIRE(stolen[0] == 50);
+
+  for (int i = 98; i >= 54; --i)
+  {
+    REQUIRE(deque.pop(&value));
+    REQUIRE(value == i);
+  }
+  REQUIRE(deque.empty());
+  REQUIRE(deque.steal_half(stolen, 64) == 0);
+}
+
+TEST_CASE("WorkStealingDeque-OutOfHazardSlots")
+{
+  WorkStealingDeque<int> deque(4);
+  for (int i = 0; i < 4; ++i)
+    deque.push(i);
+
+  int value;
+  int stolen[4];
+  {
+    // A thief already holding every hazard slot of its thread
+    std::vector<std::unique_ptr<HazardPointers::Guard>> guards;
+    for (size_t i = 0; i < HazardPointers::SLOTS_PER_THREAD; ++i)
+      guards.emplace_back(new HazardPointers::Guard());
+
+    REQUIRE_THROWS_AS(deque.steal(&value), std::length_error);
+    REQUIRE_THROWS_AS(deque.steal_half(stolen, 4), std::length_error);
+  }
+
+  // Nothing was stolen
+  REQUIRE(deque.size_approx() == 4);
+  REQUIRE(deque.steal_half(stolen, 4) == 2);
+  REQUIRE(stolen[0] == 0);
+  REQUIRE(stolen[1] == 1);
+}
+
+TEST_CASE("WorkStealingDeque-Concurrent")
+{
+  const int ITEMS = 100000;
+  WorkStealingDeque<int> deque(4);
+  std::vector<std::atomic<int>> seen(ITEMS);
+  std::atomic<int> taken(0);
+  std::vector<std::thread> threads;
+
+  threads.emplace_back([&]
+                       {
+                         int value;
+                         for (int i = 0; i < ITEMS; ++i)
+                         {
+                           deque.push(i);
+                           if (i % 3 == 0 && deque.pop(&value))
+                           {
+                             ++seen[value];
+                             ++taken;
+                           }
+                         }
+                         while (deque.pop(&value))
+                         {
+                           ++seen[value];
+                           ++taken;
+                         }
+                       });
+
+  for (int t = 0; t < 3; ++t)
+  {
+    threads.emplace_back([&, t]
+                         {
+                           int values[16];
+                           while (taken.load() < ITEMS)
+                           {
+                             size_t count = t % 2
+                                              ? deque.steal_half(values, 16)
+                                              : deque.steal(values);
+                             for (size_t i = 0; i < count; ++i)
+                               ++seen[values[i]];
+                             taken += count;
+                           }
+                         });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(taken == ITEMS);
+  for (int i = 0; i < ITEMS; ++i)
+    REQUIRE(seen[i] == 1);
+}
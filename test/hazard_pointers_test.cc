@@ -0,0 +1,106 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <ni/hazard_pointers.hh>
+
+using namespace ni;
+
+namespace
+{
+struct Tracked
+{
+  static int alive;
+
+  Tracked()
+  {
+    ++alive;
+  }
+
+  ~Tracked()
+  {
+    --alive;
+  }
+};
+
+int Tracked::alive = 0;
+
+// Uses hazard pointers from its destructor, after the thread's record has
+// been released when it was constructed before the first use
+struct LateUser
+{
+  ~LateUser()
+  {
+    HazardPointers::Guard guard;
+    Tracked* ptr = new Tracked();
+    guard.set(ptr);
+    HazardPointers::retire(ptr);
+  }
+};
+
+} // namespace
+
+TEST_CASE("HazardPointers")
+{
+  std::atomic<Tracked*> shared(new Tracked());
+  REQUIRE(Tracked::alive == 1);
+
+  {
+    HazardPointers::Guard guard;
+    Tracked* ptr = guard.protect(shared);
+    REQUIRE(ptr == shared.load());
+
+    shared.store(nullptr);
+    HazardPointers::retire(ptr);
+    HazardPointers::scan();
+    REQUIRE(Tracked::alive == 1);
+  }
+
+  HazardPointers::scan();
+  REQUIRE(Tracked::alive == 0);
+}
+
+TEST_CASE("HazardPointers-AmortizedScan")
+{
+  for (size_t i = 0; i < HazardPointers::MIN_SCAN_THRESHOLD * 4; ++i)
+    HazardPointers::retire(new Tracked());
+
+  REQUIRE(Tracked::alive < static_cast<int>(HazardPointers::MIN_SCAN_THRESHOLD));
+  HazardPointers::scan();
+  REQUIRE(Tracked::alive == 0);
+}
+
+TEST_CASE("HazardPointers-AfterThreadExit")
+{
+  std::thread thread([]
+                     {
+                       static thread_local LateUser late_user;
+                       (void)late_user;
+                       HazardPointers::Guard guard;
+                     });
+  thread.join();
+
+  // The record used by the destructor is released with the guard, which
+  // reclaims the object
+  REQUIRE(Tracked::alive == 0);
+}
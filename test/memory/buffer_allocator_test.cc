@@ -0,0 +1,135 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <ni/cds/spsc_buffer_list.hh>
+#include <ni/cds/spsc_queue.hh>
+#include <ni/memory/buffer_allocator.hh>
+
+using namespace ni;
+
+namespace
+{
+template <typename Allocator>
+void check_allocator(const Allocator& allocator, size_t bytes)
+{
+  char* ptr = static_cast<char*>(allocator.allocate(bytes, 64));
+  REQUIRE(ptr != nullptr);
+  REQUIRE(reinterpret_cast<uintptr_t>(ptr) % 64 == 0);
+  memset(ptr, 0x5a, bytes);
+  REQUIRE(ptr[bytes - 1] == 0x5a);
+  allocator.deallocate(ptr, bytes);
+}
+
+} // namespace
+
+TEST_CASE("HeapBufferAllocator")
+{
+  check_allocator(HeapBufferAllocator(), 1000);
+}
+
+TEST_CASE("Reserved size")
+{
+  REQUIRE(HeapBufferAllocator().reserved_size(1000) == 1000);
+  REQUIRE(MappedBufferAllocator().reserved_size(1000) ==
+          MappedBufferAllocator::HUGE_PAGE_SIZE);
+  REQUIRE(MappedBufferAllocator().reserved_size(
+            MappedBufferAllocator::HUGE_PAGE_SIZE + 1) ==
+          2 * MappedBufferAllocator::HUGE_PAGE_SIZE);
+  REQUIRE(MappedBufferAllocator(0).reserved_size(1000) ==
+          static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+}
+
+TEST_CASE("MappedBufferAllocator")
+{
+  SECTION("Regular pages")
+  {
+    check_allocator(MappedBufferAllocator(0), 1000);
+    check_allocator(MappedBufferAllocator(0), 1 << 20);
+  }
+
+  SECTION("Huge pages, prefaulted and locked")
+  {
+    // Falls back to regular pages if there is no huge page reserved
+    MappedBufferAllocator allocator(MappedBufferAllocator::HUGE_PAGES |
+                                    MappedBufferAllocator::PREFAULT |
+                                    MappedBufferAllocator::LOCK);
+    check_allocator(allocator, 1000);
+    check_allocator(allocator, 3 * MappedBufferAllocator::HUGE_PAGE_SIZE + 1);
+  }
+
+  SECTION("NUMA node")
+  {
+    check_allocator(MappedBufferAllocator(MappedBufferAllocator::PREFAULT, 0),
+                    1 << 20);
+  }
+}
+
+TEST_CASE("Containers on mapped memory")
+{
+  constexpr int COUNT = 100000;
+  MappedBufferAllocator allocator(MappedBufferAllocator::HUGE_PAGES |
+                                  MappedBufferAllocator::PREFAULT);
+
+  SPSCRingBuffer<int, -1, int, MappedBufferAllocator> ringbuf(1 << 16,
+                                                              allocator);
+  SPSCQueue<uint64_t, MappedBufferAllocator> queue(1 << 16, allocator);
+
+  std::thread producer([&]
+                       {
+                         for (int i = 0; i < COUNT; ++i)
+                         {
+                           while (!ringbuf.push(i))
+                             std::this_thread::yield();
+                           while (!queue.push(i))
+                             std::this_thread::yield();
+                         }
+                       });
+
+  for (int i = 0; i < COUNT; ++i)
+  {
+    int value;
+    while ((value = ringbuf.pop()) == -1)
+      std::this_thread::yield();
+    REQUIRE(value == i);
+
+    uint64_t element;
+    while (!queue.pop(&element))
+      std::this_thread::yield();
+    REQUIRE(element == static_cast<uint64_t>(i));
+  }
+  producer.join();
+
+  // Every segment reserves at least a whole huge page
+  SPSCBufferList<int, -1, int, MappedBufferAllocator> list(1024, 4, true,
+                                                           allocator);
+  REQUIRE(list.memory_usage() >= 4 * MappedBufferAllocator::HUGE_PAGE_SIZE);
+  for (int i = 0; i < 1000; ++i)
+    list.push(i);
+  for (int i = 0; i < 1000; ++i)
+    REQUIRE(list.pop() == i);
+  REQUIRE(list.empty());
+}
@@ -21,6 +21,7 @@
 
 #include <ni/mpl/unit.hh>
 #include <ni/tagged_ptr.hh>
+#include <ni/wide_tagged_ptr.hh>
 
 using namespace ni;
 
@@ -62,3 +63,40 @@ TEST_CASE("AtomicTaggedValue<TaggedPtr>")
   ap.store(Ptr(nullptr, 42), std::memory_order_relaxed);
   REQUIRE(ap == Ptr(nullptr, 42));
 }
+
+TEST_CASE("WideTaggedPtr")
+{
+  // Does not fit into 48 bits
+  Unit* ptr = reinterpret_cast<Unit*>(0x01ff000000001000ULL);
+  uint64_t tag = 0x123456789abcdefULL;
+
+  REQUIRE(WideTaggedPtr<Unit>(ptr, tag).value() == ptr);
+  REQUIRE(WideTaggedPtr<Unit>(ptr, tag).tag() == tag);
+
+  WideTaggedPtr<Unit> p(ptr);
+  p.set_tag(tag);
+  REQUIRE(p == WideTaggedPtr<Unit>(ptr, tag));
+  p.clear_tag();
+  REQUIRE(p.tag() == 0);
+}
+
+TEST_CASE("AtomicWideTaggedPtr")
+{
+  using Ptr = WideTaggedPtr<Unit>;
+  using AtomicPtr = AtomicWideTaggedPtr<Ptr>;
+
+  Unit obj;
+  Ptr p(&obj, 7);
+  AtomicPtr ap(p);
+
+  REQUIRE(ap.load(std::memory_order_relaxed) == p);
+  ap.store(Ptr(nullptr, 42), std::memory_order_relaxed);
+  REQUIRE(ap == Ptr(nullptr, 42));
+
+  Ptr expected(&obj, 42);
+  REQUIRE_FALSE(ap.compare_exchange_strong(expected, p));
+  REQUIRE(expected == Ptr(nullptr, 42));
+  REQUIRE(ap.compare_exchange_strong(expected, p));
+  REQUIRE(ap.exchange(Ptr(&obj, ~0ULL)) == p);
+  REQUIRE(ap.load().tag() == ~0ULL);
+}
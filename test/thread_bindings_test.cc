@@ -0,0 +1,108 @@
+// Copyright (C) 2016 Zhe Wang <0x1998@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <atomic>
+#include <thread>
+
+#include <catch.hpp>
+
+#include <ni/thread_bindings.hh>
+
+using namespace ni;
+
+namespace
+{
+std::atomic<int> cleanups(0);
+
+void count_cleanup(void* owner, void* value)
+{
+  REQUIRE(owner == &cleanups);
+  cleanups.fetch_add(*static_cast<int*>(value));
+}
+
+} // namespace
+
+TEST_CASE("ThreadBindings")
+{
+  ThreadBindings::Key key = ThreadBindings::create_key();
+  ThreadBindings::Key other = ThreadBindings::create_key();
+  REQUIRE(ThreadBindings::get(key) == nullptr);
+
+  int one = 1;
+  int two = 2;
+  ThreadBindings::set(key, &one, &count_cleanup, &cleanups);
+  ThreadBindings::set(other, &two, &count_cleanup, &cleanups);
+  REQUIRE(ThreadBindings::get(key) == &one);
+  REQUIRE(ThreadBindings::get(other) == &two);
+
+  // Every thread has its own slots
+  std::thread([&]
+              {
+                REQUIRE(ThreadBindings::get(key) == nullptr);
+              }).join();
+
+  ThreadBindings::reset(other);
+  REQUIRE(ThreadBindings::get(other) == nullptr);
+  REQUIRE(ThreadBindings::get(key) == &one);
+
+  // A new key reusing the index of a deleted one starts unbound
+  ThreadBindings::delete_key(key);
+  ThreadBindings::Key reused = ThreadBindings::create_key();
+  REQUIRE(reused.index == key.index);
+  REQUIRE(ThreadBindings::get(reused) == nullptr);
+
+  ThreadBindings::delete_key(reused);
+  ThreadBindings::delete_key(other);
+}
+
+TEST_CASE("ThreadBindings-Cleanup")
+{
+  ThreadBindings::Key key = ThreadBindings::create_key();
+  ThreadBindings::Key deleted = ThreadBindings::create_key();
+  cleanups.store(0);
+
+  int one = 1;
+  int ten = 10;
+  std::atomic<bool> bound(false);
+  std::atomic<bool> exit(false);
+  std::thread thread([&]
+                     {
+                       ThreadBindings::set(key, &one, &count_cleanup,
+                                           &cleanups);
+                       ThreadBindings::set(deleted, &ten, &count_cleanup,
+                                           &cleanups);
+                       bound.store(true);
+                       while (!exit.load())
+                         std::this_thread::yield();
+                     });
+
+  while (!bound.load())
+    std::this_thread::yield();
+  // The cleanup of a deleted key does not run
+  ThreadBindings::delete_key(deleted);
+  exit.store(true);
+  thread.join();
+  REQUIRE(cleanups.load() == 1);
+
+  // Threads which never bound anything have nothing to clean up
+  std::thread([] {}).join();
+  REQUIRE(cleanups.load() == 1);
+
+  ThreadBindings::delete_key(key);
+}